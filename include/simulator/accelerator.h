@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef _ACCELERATOR_H_
+#define _ACCELERATOR_H_
+
+#include <cstdint>
+#include <string>
+
+/* Forward definition to avoid circular inclusion problem */
+class Statistics;
+
+struct FetchAcceleratorConfig
+{
+    /* Buffers for the lines fetched in sequence and for branch targets */
+    uint32_t lineBuffers{ 0 };
+    uint32_t targetBuffers{ 0 };
+    /* Read the line after each fetched one before it is requested */
+    bool prefetch{ true };
+};
+
+/*
+ * Line buffers between fetch and a slow memory such as flash, in the style of
+ * the accelerators of microcontrollers. Each buffer holds one line of the
+ * memory access width. Lines reached by a branch go in the target buffers,
+ * so that loops find their first lines there after the sequential buffers
+ * moved on. The accelerator reads one line at a time, so a demand miss waits
+ * for the prefetch in progress
+ */
+class FetchAccelerator
+{
+public:
+    FetchAccelerator(const FetchAcceleratorConfig &configIn,
+                     uint32_t lineBytesIn,
+                     Statistics *statsIn);
+    ~FetchAccelerator();
+
+    bool access(uint32_t lineByteAddr,
+                uint64_t cycle,
+                uint32_t readCycles,
+                uint32_t nextReadCycles,
+                uint32_t &waitCycles);
+
+    static int parseConfig(const char *str, FetchAcceleratorConfig &config);
+    static std::string configToStr(const FetchAcceleratorConfig &config);
+
+private:
+    uint32_t findBuffer(uint32_t lineByteAddr);
+    void fillBuffer(uint32_t buffer,
+                    uint32_t lineByteAddr,
+                    uint64_t readyCycle,
+                    bool prefetched);
+
+    FetchAcceleratorConfig config;
+    uint32_t lineBytes;
+    uint32_t buffers;
+
+    uint32_t *lineByteAddrs;
+    bool *valid;
+    /* Prefetched lines that were not requested yet */
+    bool *prefetched;
+    /* Cycle at which the read of each line finishes */
+    uint64_t *readyCycles;
+
+    /* Next buffer to replace, in order, of each kind */
+    uint32_t nextLineBuffer{ 0 };
+    uint32_t nextTargetBuffer{ 0 };
+
+    uint32_t lastLineByteAddr{ UINT32_MAX };
+    /* The memory is busy reading a line until this cycle */
+    uint64_t busyUntilCycle{ 0 };
+
+    Statistics *stats;
+};
+
+#endif /* _ACCELERATOR_H_ */
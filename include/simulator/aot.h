@@ -0,0 +1,496 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef _AOT_H_
+#define _AOT_H_
+
+#include "simulator/decode.h"
+#include "simulator/memory.h"
+#include "simulator/regfile.h"
+#include "simulator/stats.h"
+#include "simulator/utils.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Cycles charged to each class of instruction by programs translated ahead
+ * of time. The values are those of the Cortex-M0 documentation that the
+ * pipeline model follows, multiple transfers add one cycle per register.
+ * The pipeline and the memory system are not modelled, so the cycle counts
+ * are approximate and do not match those reported by the simulator
+ */
+#define AOT_CYCLES_DATA_PROCESSING 1
+#define AOT_CYCLES_LOAD_STORE 2
+#define AOT_CYCLES_MULTIPLE 1
+#define AOT_CYCLES_POP_PC 4
+#define AOT_CYCLES_BRANCH_TAKEN 3
+#define AOT_CYCLES_BRANCH_NOT_TAKEN 1
+#define AOT_CYCLES_BL 4
+
+/*
+ * Architectural state of a program translated ahead of time. Each translated
+ * basic block updates it directly and returns the address of the next block
+ */
+struct AotState
+{
+    uint32_t regs[REGFILE_CORE_REGS_COUNT]{ 0 };
+    uint32_t xpsr{ 0 };
+
+    uint64_t cycles{ 0 };
+    uint64_t branchesTaken{ 0 };
+    uint64_t branchesNotTaken{ 0 };
+    std::array<uint64_t, static_cast<std::size_t>(Instruction::COUNT)>
+        instCount{};
+    std::array<uint64_t, static_cast<std::size_t>(DecodedOperation::COUNT)>
+        decodedOpCount{};
+
+    Memory *mem{ nullptr };
+    Statistics *stats{ nullptr };
+};
+
+/* Generated by the translator, runs the block that starts at the pc */
+uint32_t aotRunBlock(AotState &s, uint32_t pc);
+
+/* Generated by the translator, end of the code that was translated */
+extern const uint32_t aotCodeEndAddr;
+
+/* Shared by the translator and the runtime to charge the same cycles */
+bool aotEndsBlock(DecodedInst &inst);
+Instruction aotGetInstruction(DecodedInst &inst);
+uint32_t aotGetCycles(DecodedInst &inst);
+uint32_t aotGetBranchCycles(DecodedInst &inst, bool taken);
+
+/*
+ * Provided by the runtime for a pc that has no translated block. It runs the
+ * instruction at the pc in the functional model and returns the next pc
+ */
+uint32_t aotMissingBlock(AotState &s, uint32_t pc);
+
+/* Provided by the runtime for the instructions that end the program */
+uint32_t aotBkpt(AotState &s, uint32_t im);
+uint32_t aotSvc(AotState &s, uint32_t im);
+void aotCps(AotState &s, uint32_t data);
+void aotFail(const char *msg);
+
+static inline void aotCountInst(AotState &s, Instruction inst, uint64_t count)
+{
+    s.instCount[static_cast<std::size_t>(inst)] += count;
+}
+
+static inline void aotCountOp(AotState &s,
+                              DecodedOperation op,
+                              uint64_t count)
+{
+    s.decodedOpCount[static_cast<std::size_t>(op)] += count;
+}
+
+static inline uint32_t aotSetBit(uint32_t xpsr, uint32_t index, uint32_t flag)
+{
+    return (xpsr & ~(0x1U << index)) | ((flag & 0x1) << index);
+}
+
+static inline void aotSetC(AotState &s, uint32_t flag)
+{
+    s.xpsr = aotSetBit(s.xpsr, XPSR_CBIT_INDEX, flag);
+}
+
+static inline uint32_t aotGetC(AotState &s)
+{
+    return GET_BIT_AT_POS(s.xpsr, XPSR_CBIT_INDEX);
+}
+
+static inline uint32_t aotNZ(AotState &s, uint32_t res)
+{
+    s.xpsr = aotSetBit(s.xpsr, XPSR_ZBIT_INDEX, (res == 0) ? 0x1 : 0x0);
+    s.xpsr = aotSetBit(s.xpsr, XPSR_NBIT_INDEX, res >> (BITS_PER_WORD - 1));
+
+    return res;
+}
+
+/*
+ * Flags of the addition op0 + op1 + carry, subtractions are passed in as an
+ * addition of the inverted operand. Same arithmetic as the register file
+ */
+static inline uint32_t aotAddWithCarry(AotState &s,
+                                       uint32_t op0,
+                                       uint32_t op1,
+                                       uint32_t carry,
+                                       bool setV)
+{
+    uint32_t msb = BITS_PER_WORD - 1;
+    uint32_t maskMsb = ~(0x1U << msb);
+    uint32_t res = op0 + op1 + carry;
+    uint32_t tmp0, tmp1;
+
+    aotNZ(s, res);
+
+    tmp0 = ((op0 & maskMsb) + (op1 & maskMsb) + carry) >> msb;
+    tmp1 = (tmp0 + (op0 >> msb) + (op1 >> msb)) >> 1;
+    aotSetC(s, tmp1);
+
+    if (setV)
+    {
+        s.xpsr = aotSetBit(s.xpsr, XPSR_VBIT_INDEX, tmp0 ^ tmp1);
+        s.xpsr = aotSetBit(s.xpsr, XPSR_QBIT_INDEX, 0x0);
+    }
+
+    return res;
+}
+
+static inline uint32_t aotAdd(AotState &s,
+                              uint32_t op0,
+                              uint32_t op1,
+                              uint32_t carry)
+{
+    return aotAddWithCarry(s, op0, op1, carry, true);
+}
+
+static inline uint32_t aotSub(AotState &s, uint32_t op0, uint32_t op1)
+{
+    aotAddWithCarry(s, op0, ~op1, 1, true);
+
+    return op0 - op1;
+}
+
+/* SBC does not update the overflow flag in the simulator */
+static inline uint32_t aotSbc(AotState &s, uint32_t op0, uint32_t op1)
+{
+    uint32_t borrow = (aotGetC(s) == 0x0) ? 0x1 : 0x0;
+
+    aotAddWithCarry(s, op0, ~op1, borrow, false);
+
+    return op0 - op1 - borrow;
+}
+
+static inline uint32_t aotLslImm(AotState &s, uint32_t data, uint32_t im)
+{
+    if (im == 0)
+    {
+        return aotNZ(s, data);
+    }
+
+    aotSetC(s, (data >> (BITS_PER_WORD - im)) & 0x1);
+
+    return aotNZ(s, data << im);
+}
+
+static inline uint32_t aotLslReg(AotState &s, uint32_t data, uint32_t amount)
+{
+    if (amount == 0)
+    {
+        return aotNZ(s, data);
+    }
+    else if (amount == BITS_PER_WORD)
+    {
+        aotSetC(s, data & 0x1);
+        return aotNZ(s, 0);
+    }
+    else if (amount > BITS_PER_WORD)
+    {
+        aotSetC(s, 0);
+        return aotNZ(s, 0);
+    }
+
+    aotSetC(s, (data >> (BITS_PER_WORD - amount)) & 0x1);
+
+    return aotNZ(s, data << amount);
+}
+
+static inline uint32_t aotLsrImm(AotState &s, uint32_t data, uint32_t im)
+{
+    if (im == 0)
+    {
+        return aotNZ(s, data);
+    }
+
+    aotSetC(s, GET_BIT_AT_POS(data, im - 1));
+
+    return aotNZ(s, data >> im);
+}
+
+static inline uint32_t aotLsrReg(AotState &s, uint32_t data, uint32_t amount)
+{
+    if (amount == 0)
+    {
+        return aotNZ(s, data);
+    }
+    else if (amount == BITS_PER_WORD)
+    {
+        aotSetC(s, GET_BIT_AT_POS(data, BITS_PER_WORD - 1));
+        return aotNZ(s, 0);
+    }
+    else if (amount > BITS_PER_WORD)
+    {
+        aotSetC(s, 0);
+        return aotNZ(s, 0);
+    }
+
+    aotSetC(s, GET_BIT_AT_POS(data, amount - 1));
+
+    return aotNZ(s, data >> amount);
+}
+
+static inline uint32_t aotAsr(AotState &s, uint32_t data, uint32_t amount)
+{
+    uint32_t res;
+
+    if (amount == 0)
+    {
+        return aotNZ(s, data);
+    }
+    else if (amount >= BITS_PER_WORD)
+    {
+        /* Shift by 32 */
+        res = (GET_BIT_AT_POS(data, BITS_PER_WORD - 1) == 0x1) ? ~0U : 0;
+        aotSetC(s, res);
+        return aotNZ(s, res);
+    }
+
+    aotSetC(s, (data >> (amount - 1)) & 0x1);
+
+    res = data >> amount;
+    if (GET_BIT_AT_POS(data, BITS_PER_WORD - 1) == 0x1)
+    {
+        res = res | (~0U << (BITS_PER_WORD - amount));
+    }
+
+    return aotNZ(s, res);
+}
+
+static inline uint32_t aotRor(AotState &s, uint32_t data, uint32_t amount)
+{
+    if (amount == 0)
+    {
+        return aotNZ(s, data);
+    }
+
+    amount = amount % BITS_PER_WORD;
+    if (amount == 0)
+    {
+        aotSetC(s, 0x1);
+        return aotNZ(s, data);
+    }
+
+    aotSetC(s, data & (1 << (amount - 1)));
+
+    return aotNZ(s, (data << (BITS_PER_WORD - amount)) | (data >> amount));
+}
+
+static inline uint32_t aotRev(uint32_t data)
+{
+    return (((data >> 0) & 0xFF) << 24) | (((data >> 8) & 0xFF) << 16) |
+        (((data >> 16) & 0xFF) << 8) | (((data >> 24) & 0xFF) << 0);
+}
+
+static inline uint32_t aotRev16(uint32_t data)
+{
+    return (((data >> 0) & 0xFF) << 8) | (((data >> 8) & 0xFF) << 0) |
+        (((data >> 16) & 0xFF) << 24) | (((data >> 24) & 0xFF) << 16);
+}
+
+static inline uint32_t aotRevsh(uint32_t data)
+{
+    uint32_t res = (((data >> 0) & 0xFF) << 8) | (((data >> 8) & 0xFF) << 0);
+
+    return (GET_BIT_AT_POS(res, 15) == 0x1) ? res | 0xFFFF0000 :
+                                              res | 0x0000FFFF;
+}
+
+static inline uint32_t aotSignExtend(uint32_t data, uint32_t bits)
+{
+    return (GET_BIT_AT_POS(data, bits - 1) != 0) ? data | (~0U << bits) : data;
+}
+
+static inline uint32_t aotLoadWord(AotState &s, uint32_t byteAddr)
+{
+    uint32_t data;
+
+    s.mem->loadWord(byteAddr, data);
+
+    return data;
+}
+
+static inline uint32_t aotLoadByte(AotState &s, uint32_t byteAddr)
+{
+    return (aotLoadWord(s, byteAddr) >>
+            (GET_BYTE_INDEX(byteAddr) * BITS_PER_BYTE)) &
+        0xFF;
+}
+
+static inline uint32_t aotLoadHalfword(AotState &s, uint32_t byteAddr)
+{
+    return (aotLoadWord(s, byteAddr) >>
+            ((GET_BYTE_INDEX(byteAddr) & ~0x1) * BITS_PER_BYTE)) &
+        0xFFFF;
+}
+
+/*
+ * The translated code cannot follow changes to the instructions, so stop the
+ * program rather than carry on with stale code
+ */
+static inline void aotStoreWord(AotState &s, uint32_t byteAddr, uint32_t data)
+{
+    if (byteAddr < aotCodeEndAddr && aotLoadWord(s, byteAddr) != data)
+    {
+        aotFail("Self-modifying code is not supported ahead of time");
+    }
+
+    s.mem->storeWord(byteAddr, data);
+}
+
+static inline void aotStorePart(AotState &s,
+                                uint32_t byteAddr,
+                                uint32_t data,
+                                uint32_t mask,
+                                uint32_t shift)
+{
+    uint32_t prevData = aotLoadWord(s, byteAddr) & ~(mask << shift);
+
+    aotStoreWord(s, byteAddr, prevData | ((data & mask) << shift));
+}
+
+static inline void aotStoreByte(AotState &s, uint32_t byteAddr, uint32_t data)
+{
+    aotStorePart(
+        s, byteAddr, data, 0xFF, GET_BYTE_INDEX(byteAddr) * BITS_PER_BYTE);
+}
+
+static inline void aotStoreHalfword(AotState &s,
+                                    uint32_t byteAddr,
+                                    uint32_t data)
+{
+    aotStorePart(s,
+                 byteAddr,
+                 data,
+                 0xFFFF,
+                 (GET_BYTE_INDEX(byteAddr) & ~0x1) * BITS_PER_BYTE);
+}
+
+static inline bool aotCheckCondition(AotState &s, DecodedCondition cond)
+{
+    uint32_t n = GET_BIT_AT_POS(s.xpsr, XPSR_NBIT_INDEX);
+    uint32_t z = GET_BIT_AT_POS(s.xpsr, XPSR_ZBIT_INDEX);
+    uint32_t c = GET_BIT_AT_POS(s.xpsr, XPSR_CBIT_INDEX);
+    uint32_t v = GET_BIT_AT_POS(s.xpsr, XPSR_VBIT_INDEX);
+
+    switch (cond)
+    {
+        case DecodedCondition::EQ:
+            return z == 0x1;
+        case DecodedCondition::NE:
+            return z == 0x0;
+        case DecodedCondition::CS:
+            return c == 0x1;
+        case DecodedCondition::CC:
+            return c == 0x0;
+        case DecodedCondition::MI:
+            return n == 0x1;
+        case DecodedCondition::PL:
+            return n == 0x0;
+        case DecodedCondition::VS:
+            return v == 0x1;
+        case DecodedCondition::VC:
+            return v == 0x0;
+        case DecodedCondition::HI:
+            return c == 0x1 && z == 0x0;
+        case DecodedCondition::LS:
+            return c == 0x0 || z == 0x1;
+        case DecodedCondition::GE:
+            return n == v;
+        case DecodedCondition::LT:
+            return n != v;
+        case DecodedCondition::GT:
+            return z == 0x0 && n == v;
+        case DecodedCondition::LE:
+            return z == 0x1 || n != v;
+        default:
+            aotFail("Invalid condition");
+            return false;
+    }
+}
+
+static inline uint32_t aotBranch(AotState &s, uint32_t target)
+{
+    s.branchesTaken++;
+    s.cycles += AOT_CYCLES_BRANCH_TAKEN;
+
+    return target;
+}
+
+static inline uint32_t aotBranchCond(AotState &s,
+                                     DecodedCondition cond,
+                                     uint32_t target,
+                                     uint32_t nextAddr)
+{
+    if (aotCheckCondition(s, cond))
+    {
+        return aotBranch(s, target);
+    }
+
+    s.branchesNotTaken++;
+    s.cycles += AOT_CYCLES_BRANCH_NOT_TAKEN;
+
+    return nextAddr;
+}
+
+/* Branch to a register, which must hold a Thumb address */
+static inline uint32_t aotBranchExchange(AotState &s, uint32_t target)
+{
+    if ((target & 0x1) != 0x1)
+    {
+        aotFail("BX cannot branch to ARM mode");
+    }
+
+    return aotBranch(s, target & ~0x1);
+}
+
+static inline uint32_t aotBranchLink(AotState &s, uint32_t target)
+{
+    s.branchesTaken++;
+    s.cycles += AOT_CYCLES_BL;
+
+    return target;
+}
+
+/* POP into the pc, the cycles are charged with the rest of the pop */
+static inline uint32_t aotBranchReturn(AotState &s, uint32_t target)
+{
+    s.branchesTaken++;
+
+    return target;
+}
+
+/* ADD to the pc, the sum is not allowed to be a Thumb address */
+static inline uint32_t aotBranchAligned(AotState &s, uint32_t target)
+{
+    if ((target & 0x1) != 0x0)
+    {
+        aotFail("ADD4 branching to unaligned address");
+    }
+
+    return aotBranch(s, target);
+}
+
+#endif /* _AOT_H_ */
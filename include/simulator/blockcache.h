@@ -0,0 +1,79 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef _BLOCKCACHE_H_
+#define _BLOCKCACHE_H_
+
+#include "simulator/config.h"
+#include "simulator/decode.h"
+
+#include <cstdint>
+
+/* Longest run of instructions predecoded into a single block */
+#define PREDECODED_BLOCK_MAX_INSTS 32
+
+/*
+ * Basic block of the program for the functional model. The instructions are
+ * kept predecoded together with their address and the address that follows
+ * them, so that a block can run without going back to memory
+ */
+struct PredecodedBlock
+{
+    bool valid{ false };
+    uint32_t startAddr{ 0 };
+    uint32_t endAddr{ 0 };
+    uint32_t hits{ 0 };
+    uint32_t instCount{ 0 };
+    uint32_t instAddr[PREDECODED_BLOCK_MAX_INSTS];
+    uint32_t nextAddr[PREDECODED_BLOCK_MAX_INSTS];
+    DecodedInst insts[PREDECODED_BLOCK_MAX_INSTS];
+
+    /* Handler of each instruction, set once the block runs threaded */
+    bool threaded{ false };
+    void *handlers[PREDECODED_BLOCK_MAX_INSTS];
+};
+
+/*
+ * Direct-mapped cache of predecoded blocks indexed by the address of the
+ * first instruction. Branch targets are counted and a block is only
+ * predecoded once its target becomes hot. The blocks are still run by the
+ * handlers of the execute stage, nothing is compiled to host code, and they
+ * carry no timing as the functional model is not timed
+ */
+class BlockCache
+{
+public:
+    BlockCache();
+    ~BlockCache();
+
+    PredecodedBlock *lookup(uint32_t startAddr);
+    PredecodedBlock *recordBranchTarget(uint32_t startAddr);
+    void invalidate();
+
+    static bool endsBlock(DecodedOperation op);
+
+private:
+    PredecodedBlock *blocks;
+};
+
+#endif /* _BLOCKCACHE_H_ */
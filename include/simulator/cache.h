@@ -0,0 +1,105 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <cstdint>
+#include <string>
+
+enum class CacheReplacement
+{
+    LRU,
+    FIFO,
+    RANDOM,
+};
+
+/* Outcome of an access, misses also tell what happened to the line replaced */
+enum class CacheAccessResult
+{
+    HIT,
+    MISS,
+    /* The miss replaced a clean line */
+    EVICTION,
+    /* The miss replaced a dirty line, which has to be written back first */
+    WRITE_BACK,
+};
+
+struct CacheConfig
+{
+    uint32_t sizeBytes{ 0 };
+    uint32_t lineBytes{ 0 };
+    uint32_t ways{ 0 };
+    CacheReplacement replacement{ CacheReplacement::LRU };
+    /* Stores only reach the memory when their line is evicted */
+    bool writeBack{ true };
+};
+
+/*
+ * Set-associative cache that only models timing, the data always lives in
+ * the memory. The tags and the state of the lines are kept in separate
+ * arrays indexed by set * ways + way, so a lookup only walks the tags of one
+ * set
+ */
+class Cache
+{
+public:
+    Cache(const CacheConfig &configIn);
+    ~Cache();
+
+    CacheAccessResult access(uint32_t byteAddr,
+                             bool write,
+                             uint32_t &evictedByteAddr);
+
+    uint32_t getLineBaseByteAddr(uint32_t byteAddr)
+    {
+        return byteAddr & ~(config.lineBytes - 1);
+    }
+
+    const CacheConfig &getConfig()
+    {
+        return config;
+    }
+
+    static int parseConfig(const char *str, CacheConfig &config);
+    static std::string configToStr(const CacheConfig &config);
+
+private:
+    uint32_t chooseVictim(uint32_t firstLine);
+
+    CacheConfig config;
+    uint32_t setMask;
+    uint32_t lineShift;
+
+    /* Address of the line divided by the line size */
+    uint32_t *tags;
+    bool *valid;
+    bool *dirty;
+    /* Time of the last access for LRU or of the fill for FIFO */
+    uint64_t *stamps;
+    uint64_t clock{ 0 };
+    /* State of the generator for random replacement */
+    uint32_t randomState{ 0x12345678 };
+};
+
+#endif /* _CACHE_H_ */
@@ -33,8 +33,64 @@
 #define MEM_ACCESS_WIDTH_WORDS 1
 #endif /* MEM_ACCESS_WIDTH_WORDS */
 
-#if !defined(MEM_PIPELINE_SIZE)
-#define MEM_PIPELINE_SIZE 2
-#endif /* MEM_PIPELINE_SIZE */
+#if !defined(MEM_LATENCY_CYCLES)
+/* Cycles from placing a request until its response can be retrieved */
+#define MEM_LATENCY_CYCLES 1
+#endif /* MEM_LATENCY_CYCLES */
+
+#if !defined(MEM_MAX_OUTSTANDING)
+/* Requests that can be in flight at the same time */
+#define MEM_MAX_OUTSTANDING 1
+#endif /* MEM_MAX_OUTSTANDING */
+
+#if !defined(FETCH_QUEUE_DEPTH)
+/* Lines that fetch requests ahead of the next instruction */
+#define FETCH_QUEUE_DEPTH 1
+#endif /* FETCH_QUEUE_DEPTH */
+
+#if !defined(BRANCH_TARGET_BUFFER_ENTRIES)
+/* Branches whose target the front end remembers (power of 2) */
+#define BRANCH_TARGET_BUFFER_ENTRIES 16
+#endif /* BRANCH_TARGET_BUFFER_ENTRIES */
+
+#if !defined(BRANCH_PREDICTOR_COUNTERS)
+/* Counters of the bimodal and gshare predictors (power of 2) */
+#define BRANCH_PREDICTOR_COUNTERS 256
+#endif /* BRANCH_PREDICTOR_COUNTERS */
+
+#if !defined(LOOP_BUFFER_ENTRIES)
+/* Halfwords of the longest loop that the loop buffer holds */
+#define LOOP_BUFFER_ENTRIES 16
+#endif /* LOOP_BUFFER_ENTRIES */
+
+#if !defined(WRITE_BUFFER_ENTRIES)
+/* Stores that the write buffer holds until the memory takes them */
+#define WRITE_BUFFER_ENTRIES 4
+#endif /* WRITE_BUFFER_ENTRIES */
+
+#if !defined(CACHE_HIT_CYCLES)
+/* Cycles from placing a request that hits in a cache until its response */
+#define CACHE_HIT_CYCLES 1
+#endif /* CACHE_HIT_CYCLES */
+
+#if !defined(DECODE_CACHE_ENTRIES)
+/* Number of entries in the predecoded instruction cache (power of 2) */
+#define DECODE_CACHE_ENTRIES 0x2000
+#endif /* DECODE_CACHE_ENTRIES */
+
+#if !defined(BLOCK_CACHE_ENTRIES)
+/* Number of blocks predecoded by the functional model (power of 2) */
+#define BLOCK_CACHE_ENTRIES 0x400
+#endif /* BLOCK_CACHE_ENTRIES */
+
+#if !defined(BLOCK_CACHE_HOT_THRESHOLD)
+/* Times a branch target is reached before its block is predecoded */
+#define BLOCK_CACHE_HOT_THRESHOLD 16
+#endif /* BLOCK_CACHE_HOT_THRESHOLD */
+
+#if !defined(TIMING_MEMO_ENTRIES)
+/* Number of blocks whose timing is memoized (power of 2) */
+#define TIMING_MEMO_ENTRIES 0x400
+#endif /* TIMING_MEMO_ENTRIES */
 
 #endif /* _CONFIG_H_ */
@@ -24,14 +24,25 @@
 #ifndef _DECODE_H_
 #define _DECODE_H_
 
+#include "simulator/config.h"
 #include "simulator/fetch.h"
 #include "simulator/regfile.h"
 
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <string>
 
-enum class DecodedOperation
+/* Forward definition to avoid circular inclusion problem */
+class Statistics;
+
+/* One entry for every possible 16-bit encoding */
+#define DECODE_TABLE_ENTRIES 0x10000
+
+/* The decode and execute stages hold at most one instruction each */
+#define DECODED_INST_POOL_SIZE 2
+
+enum class DecodedOperation : uint8_t
 {
     NOP,
     ADC,
@@ -105,6 +116,7 @@ enum class DecodedOperation
     TST,
     UXTB,
     UXTH,
+    COUNT,
 };
 
 enum class DecodedInstRegIndex
@@ -139,6 +151,59 @@ enum class DecodedCondition
     COUNT = 0x10,
 };
 
+/*
+ * Recipe used to extract the operands of a 16-bit encoding once its operation
+ * is known. The names list the fields in encoding order, HI fields are 4-bit
+ * register numbers and the LD/ST variants differ in whether rt is read
+ */
+enum class DecodedInstFormat : uint8_t
+{
+    NONE,
+    PLACEHOLDER,
+    UNSUPPORTED,
+    IM8,
+    IM11,
+    R0,
+    BL_PREFIX,
+    COND_IM8,
+    RDN_RM,
+    RDN_RM_XPSR,
+    RDN_RN,
+    RN_RM,
+    RD_RM,
+    RD_RN,
+    RD_RN_IM3,
+    RD_RN_RM,
+    RD_RM_IM5,
+    RDN_IM8,
+    RN_IM8,
+    RD_IM8,
+    RD_PC_IM8,
+    RD_SP_IM8,
+    SP_SP_IM7,
+    SPN_IM7,
+    RDN_RM_HI,
+    RD_RM_HI,
+    RN_RM_HI,
+    PC_RM_HI,
+    RN_LIST,
+    SP_LIST_LR,
+    SP_LIST_PC,
+    LD_RT_RN_IM5,
+    ST_RT_RN_IM5,
+    LD_RT_RN_RM,
+    ST_RT_RN_RM,
+    LD_RT_PC_IM8,
+    LD_RT_SP_IM8,
+    ST_RT_SP_IM8,
+};
+
+struct DecodeTableEntry
+{
+    DecodedOperation op;
+    DecodedInstFormat format;
+};
+
 class DecodedInst
 {
 public:
@@ -152,45 +217,124 @@ public:
     void setRegister(DecodedInstRegIndex index, Reg reg, uint32_t data);
     uint32_t getRegisterData(DecodedInstRegIndex index);
     Reg getRegisterNumber(DecodedInstRegIndex index);
+    uint32_t getUsedRegisters();
     void setRegisterList(uint32_t regListIn);
     uint32_t getRegisterList();
     void setCondition(uint32_t cond);
+    void setCondition(DecodedCondition condIn);
     DecodedCondition getCondition();
+    void setPrediction(uint32_t fallThroughAddrIn,
+                       uint32_t predictedAddrIn,
+                       uint64_t predictedCycleIn);
+    uint32_t getFallThroughAddr();
+    uint32_t getPredictedAddr();
+    uint64_t getPredictedCycle();
     void printDisassembly();
+    bool isEqual(DecodedInst &other);
 
     static std::string getConditionString(DecodedCondition cond);
+    static std::string getOperationString(DecodedOperation op);
 
 private:
     bool pending{ false };
     DecodedOperation op{ DecodedOperation::NOP };
     Reg regsNumber[REGFILE_LOW_REGS_COUNT]{ Reg::RNONE };
     uint32_t regsData[REGFILE_LOW_REGS_COUNT];
+    /* Bitmask of the register slots set by the decoder */
+    uint32_t regsUsed{ 0 };
     uint32_t im;
     uint32_t regList;
     DecodedCondition cond;
+    /*
+     * Address of the next instruction in sequence and the one that fetch
+     * continued from, which differ if fetch predicted a taken branch
+     */
+    uint32_t fallThroughAddr;
+    uint32_t predictedAddr;
+    uint64_t predictedCycle;
+};
+
+/*
+ * Fixed set of decoded instructions that move through the pipeline, so that
+ * the steady state does not allocate memory. The heap is only used if the
+ * pool runs out of free slots, which is recorded in the statistics
+ */
+class DecodedInstPool
+{
+public:
+    DecodedInstPool(Statistics *statsIn);
+    DecodedInst *allocate();
+    void release(DecodedInst *inst);
+
+private:
+    DecodedInst slots[DECODED_INST_POOL_SIZE];
+    bool slotUsed[DECODED_INST_POOL_SIZE]{ false };
+
+    Statistics *stats;
+};
+
+/*
+ * Entry of the predecoded instruction cache. It keeps the fields of the
+ * decoded instruction and the registers in the slots that it uses, whose data
+ * is reloaded from the register file on every hit
+ */
+struct DecodeCacheEntry
+{
+    bool valid{ false };
+    bool halfInst{ false };
+    uint16_t inst{ 0 };
+    uint32_t addr{ 0 };
+    DecodedOperation op{ DecodedOperation::NOP };
+    DecodedCondition cond{ DecodedCondition::EQ };
+    uint32_t im{ 0 };
+    uint32_t regList{ 0 };
+    uint32_t regCount{ 0 };
+    DecodedInstRegIndex
+        regIndexes[static_cast<size_t>(DecodedInstRegIndex::RCOUNT)];
+    Reg regs[static_cast<size_t>(DecodedInstRegIndex::RCOUNT)];
 };
 
 class Decode
 {
 public:
-    Decode(Fetch *fetchInit, RegFile *regFileInit);
+    Decode(Fetch *fetchInit, RegFile *regFileInit, Statistics *statsInit);
+    ~Decode();
     DecodedInst *getNextInst();
     int run();
     void flush();
+    int checkDecodeTable();
+    void releaseInst(DecodedInst *inst);
+    DecodedInst *decodeFunctional(uint16_t inst, uint32_t instAddr);
+    DecodedInst *loadPredecodedInst(DecodedInst &inst, uint32_t pc);
 
 private:
     void issuePlaceholderInst();
-    uint32_t getCorrectedFetchAddress();
     void updateDecodedInstReg(DecodedInstRegIndex regIndex);
     void updateDecodedInstRegs();
+    void reloadInstOperand(DecodedInst *inst,
+                           DecodedInstRegIndex regIndex,
+                           Reg reg,
+                           uint32_t pc);
+    void reloadInstOperands(DecodedInst *inst, uint32_t pc);
+    void buildDecodeTable();
+    int decodeHalfword(uint16_t inst, uint32_t pc);
+    int decodeInst(uint16_t inst, uint32_t pc, Reg activeSp);
+    int decodeInstChain(uint16_t inst, uint32_t pc, Reg activeSp);
+    bool lookupDecodeCache(uint16_t inst, uint32_t instAddr, uint32_t pc);
+    void fillDecodeCache(uint16_t inst, uint32_t instAddr);
 
     bool decodedHalfInst{ false };
     bool flushPending{ false };
 
     DecodedInst *decodedInst{ nullptr };
 
+    DecodedInstPool instPool;
+    DecodeTableEntry *decodeTable;
+    DecodeCacheEntry *decodeCache;
+
     Fetch *fetch;
     RegFile *regFile;
+    Statistics *stats;
 };
 
 #endif /* _DECODE_H_ */
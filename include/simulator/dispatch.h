@@ -0,0 +1,120 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef _DISPATCH_H_
+#define _DISPATCH_H_
+
+/*
+ * Operands of the instruction being executed. Handlers only read the ones
+ * they need from the decoded instruction
+ */
+#define RNUM(index) decodedInst->getRegisterNumber(DecodedInstRegIndex::index)
+#define RDATA(index) decodedInst->getRegisterData(DecodedInstRegIndex::index)
+#define IMM decodedInst->getImmediate()
+#define RLIST decodedInst->getRegisterList()
+#define COND decodedInst->getCondition()
+#define CFLAG RegFile::getXpsrC(RDATA(XPSR))
+
+/*
+ * Handler of each decoded operation. Both the switch and the jump table of
+ * the Execute stage are generated from this list with a macro that takes the
+ * operation and the call that executes it
+ */
+#define EXECUTE_HANDLERS(HANDLER)                                            \
+    HANDLER(NOP, nop())                                                      \
+    HANDLER(ADC, adc(RNUM(RDN), RDATA(RDN), RDATA(RM), CFLAG))               \
+    HANDLER(ADD1, add1(RNUM(RD), RDATA(RN), IMM))                            \
+    HANDLER(ADD2, add2(RNUM(RDN), RDATA(RDN), IMM))                          \
+    HANDLER(ADD3, add3(RNUM(RD), RDATA(RN), RDATA(RM)))                      \
+    HANDLER(ADD4, add4(RNUM(RDN), RDATA(RDN), RDATA(RM)))                    \
+    HANDLER(ADD5, add5(RNUM(RD), RDATA(RM), IMM))                            \
+    HANDLER(ADD6, add6Add7(RNUM(RD), RDATA(RM), IMM))                        \
+    HANDLER(ADD7, add6Add7(RNUM(RD), RDATA(RM), IMM))                        \
+    HANDLER(AND, and0(RNUM(RDN), RDATA(RDN), RDATA(RM)))                     \
+    HANDLER(ASR1, asr1(RNUM(RD), RDATA(RM), IMM))                            \
+    HANDLER(ASR2, asr2(RNUM(RDN), RDATA(RDN), RDATA(RM)))                    \
+    HANDLER(B1, b1(RNUM(RM), RDATA(RM), IMM, RDATA(XPSR), COND))             \
+    HANDLER(B2, b2(RNUM(RM), RDATA(RM), IMM))                                \
+    HANDLER(BIC, bic(RNUM(RDN), RDATA(RDN), RDATA(RM)))                      \
+    HANDLER(BKPT, bkpt(IMM))                                                 \
+    HANDLER(BL, bl(RNUM(RDN), RDATA(RDN), IMM))                              \
+    HANDLER(BLX, blx(RNUM(RDN), RDATA(RDN), RDATA(RM)))                      \
+    HANDLER(BX, bx(RNUM(RDN), RDATA(RM)))                                    \
+    HANDLER(CMN, cmn(RDATA(RN), RDATA(RM)))                                  \
+    HANDLER(CMP1, cmp1(RDATA(RN), IMM))                                      \
+    HANDLER(CMP2, cmp2Cmp3(RDATA(RN), RDATA(RM)))                            \
+    HANDLER(CMP3, cmp2Cmp3(RDATA(RN), RDATA(RM)))                            \
+    HANDLER(CPS, cps(RDATA(RM)))                                             \
+    HANDLER(CPY, cpy(RNUM(RD), RDATA(RM)))                                   \
+    HANDLER(EOR, eor(RNUM(RDN), RDATA(RDN), RDATA(RM)))                      \
+    HANDLER(LDMIA, popLdmia(RNUM(RN), RDATA(RN), RLIST))                     \
+    HANDLER(LDR1, ldr1Ldr4(RNUM(RT), RDATA(RN), IMM))                        \
+    HANDLER(LDR2, ldr2(RNUM(RT), RDATA(RN), RDATA(RM)))                      \
+    HANDLER(LDR3, ldr3(RNUM(RT), RDATA(RN), IMM))                            \
+    HANDLER(LDR4, ldr1Ldr4(RNUM(RT), RDATA(RN), IMM))                        \
+    HANDLER(LDRB1, ldrb1(RNUM(RT), RDATA(RN), IMM))                          \
+    HANDLER(LDRB2, ldrb2(RNUM(RT), RDATA(RN), RDATA(RM)))                    \
+    HANDLER(LDRH1, ldrh1(RNUM(RT), RDATA(RN), IMM))                          \
+    HANDLER(LDRH2, ldrh2(RNUM(RT), RDATA(RN), RDATA(RM)))                    \
+    HANDLER(LDRSB, ldrsb(RNUM(RT), RDATA(RN), RDATA(RM)))                    \
+    HANDLER(LDRSH, ldrsh(RNUM(RT), RDATA(RN), RDATA(RM)))                    \
+    HANDLER(LSL1, lsl1(RNUM(RD), RDATA(RM), IMM))                            \
+    HANDLER(LSL2, lsl2(RNUM(RDN), RDATA(RDN), RDATA(RM)))                    \
+    HANDLER(LSR1, lsr1(RNUM(RD), RDATA(RM), IMM))                            \
+    HANDLER(LSR2, lsr2(RNUM(RDN), RDATA(RDN), RDATA(RM)))                    \
+    HANDLER(MOV1, mov1(RNUM(RD), IMM))                                       \
+    HANDLER(MOV2, mov2(RNUM(RD), RDATA(RM)))                                 \
+    HANDLER(MUL, mul(RNUM(RDN), RDATA(RDN), RDATA(RN)))                      \
+    HANDLER(MVN, mvn(RNUM(RD), RDATA(RM)))                                   \
+    HANDLER(NEG, neg(RNUM(RD), RDATA(RN), IMM))                              \
+    HANDLER(ORR, orr(RNUM(RDN), RDATA(RDN), RDATA(RM)))                      \
+    HANDLER(POP, popLdmia(RNUM(RN), RDATA(RN), RLIST))                       \
+    HANDLER(PUSH, push(RNUM(RN), RDATA(RN), RLIST))                          \
+    HANDLER(REV, rev(RNUM(RD), RDATA(RM)))                                   \
+    HANDLER(REV16, rev16(RNUM(RD), RDATA(RM)))                               \
+    HANDLER(REVSH, revsh(RNUM(RD), RDATA(RM)))                               \
+    HANDLER(ROR, ror(RNUM(RDN), RDATA(RDN), RDATA(RM)))                      \
+    HANDLER(SBC, sbc(RNUM(RDN), RDATA(RDN), RDATA(RM), CFLAG))               \
+    HANDLER(STMIA, stmia(RNUM(RN), RDATA(RN), RLIST))                        \
+    HANDLER(STR1, str1Str3(RNUM(RT), RDATA(RT), RNUM(RN), RDATA(RN), IMM))   \
+    HANDLER(STR2,                                                            \
+            str2(RNUM(RT), RDATA(RT), RNUM(RN), RDATA(RN), RDATA(RM)))       \
+    HANDLER(STR3, str1Str3(RNUM(RT), RDATA(RT), RNUM(RN), RDATA(RN), IMM))   \
+    HANDLER(STRB1, strb1(RNUM(RT), RDATA(RT), RNUM(RN), RDATA(RN), IMM))     \
+    HANDLER(STRB2,                                                           \
+            strb2(RNUM(RT), RDATA(RT), RNUM(RN), RDATA(RN), RDATA(RM)))      \
+    HANDLER(STRH1, strh1(RNUM(RT), RDATA(RT), RNUM(RN), RDATA(RN), IMM))     \
+    HANDLER(STRH2,                                                           \
+            strh2(RNUM(RT), RDATA(RT), RNUM(RN), RDATA(RN), RDATA(RM)))      \
+    HANDLER(SUB1, sub1(RNUM(RD), RDATA(RN), IMM))                            \
+    HANDLER(SUB2, sub2(RNUM(RDN), RDATA(RDN), IMM))                          \
+    HANDLER(SUB3, sub3(RNUM(RD), RDATA(RM), RDATA(RN)))                      \
+    HANDLER(SUB4, sub4(RNUM(RDN), RDATA(RDN), IMM))                          \
+    HANDLER(SVC, svc(IMM))                                                   \
+    HANDLER(SXTB, sxtb(RNUM(RD), RDATA(RM)))                                 \
+    HANDLER(SXTH, sxth(RNUM(RD), RDATA(RM)))                                 \
+    HANDLER(TST, tst(RDATA(RM), RDATA(RN)))                                  \
+    HANDLER(UXTB, uxtb(RNUM(RD), RDATA(RM)))                                 \
+    HANDLER(UXTH, uxth(RNUM(RD), RDATA(RM)))
+
+#endif /* _DISPATCH_H_ */
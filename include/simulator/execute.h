@@ -24,14 +24,16 @@
 #ifndef _EXECUTE_H_
 #define _EXECUTE_H_
 
+#include "simulator/blockcache.h"
 #include "simulator/decode.h"
 #include "simulator/fetch.h"
+#include "simulator/loopbuffer.h"
 #include "simulator/memory.h"
+#include "simulator/predictor.h"
 #include "simulator/regfile.h"
 #include "simulator/stats.h"
 #include "simulator/utils.h"
-
-#include <list>
+#include "simulator/writebuffer.h"
 
 enum class ExecuteState
 {
@@ -66,21 +68,39 @@ public:
             Statistics *statsIn);
     void flushPipeline();
     int run();
+    int executeFunctional(DecodedInst *inst);
+    uint32_t runThreadedBlock(PredecodedBlock *block, bool &modifiedCode);
+    void setBurstTransfers(bool burstTransfersIn);
+    void setBranchPredictor(BranchPredictor *predictorIn);
+    void setLoopBuffer(LoopBuffer *loopBufferIn);
+    void setWriteBuffer(WriteBuffer *writeBufferIn);
 
     bool isStalled();
 
+    /*
+     * A pop that loads the pc moves it one cycle before flushing the pipeline,
+     * so the instructions at the new pc must not be taken in the meantime
+     */
+    bool isFlushPending()
+    {
+        return execState == ExecuteState::FLUSH_PIPELINE;
+    }
+
     static std::string execStateToStr(ExecuteState state);
 
 private:
     /* Execution state machine functions */
     /* Execute next decoded instruction */
     int executeNextInst();
+    int executeDecodedInst();
     /* Single memory load */
     int executeLoadMemReq();
     int executeLoadMemResp();
+    int executeLoadWriteBack();
     /* Single memory store */
     int executeStoreMemReq();
     int executeStoreMemResp();
+    int executeStoreWriteBuffer();
     /* Multiple memory load */
     int executeMultipleLoadFirstMemReq();
     int executeMultipleLoadMemReq();
@@ -89,6 +109,11 @@ private:
     int executeMultipleStoreMemReq();
     /* Convenient function to flush the pipeline with 1 cycle delay */
     int executeFlushPipeline();
+    /* Memory accesses of the functional model, completed immediately */
+    int executeLoadFunctional();
+    int executeStoreFunctional();
+    int executeMultipleLoadFunctional();
+    int executeMultipleStoreFunctional();
 
     /* Multiple memory access instructions */
     int popLdmia(Reg rn, uint32_t drn, uint32_t rl);
@@ -122,6 +147,16 @@ private:
     int bl(Reg rdn, uint32_t drdn, uint32_t im);
     int blx(Reg rdn, uint32_t drdn, uint32_t drm);
     int bx(Reg rdn, uint32_t drm);
+    void takeBranch(Reg pcReg, uint32_t target);
+    void skipBranch();
+    void resolveBranch(bool taken, uint32_t nextAddr);
+    void recordLoop(uint32_t target);
+
+    /* Fetch may have continued from the target before a branch executes */
+    bool isFetchPredicting()
+    {
+        return (predictor != nullptr || loopBuffer != nullptr) && !functional;
+    }
 
     /* Arithmetic and logic instructions */
     int adc(Reg rdn, uint32_t drdn, uint32_t drm, uint32_t cflag);
@@ -173,19 +208,15 @@ private:
 
     /* Conditional flags handling */
     bool checkCondition(DecodedCondition cond, uint32_t xpsr);
-    void calculateXpsrZ(uint32_t res);
-    void calculateXpsrN(uint32_t res, uint32_t bits);
-    void calculateXpsrQ();
+    void calculateXpsrNZ(uint32_t res);
+    void calculateXpsrNZC(uint32_t res,
+                          uint32_t op0,
+                          uint32_t op1,
+                          uint32_t cflag);
     void calculateXpsrFlags(uint32_t res,
                             uint32_t op0,
                             uint32_t op1,
-                            uint32_t cflag,
-                            uint32_t bits);
-    void calculateXpsrC(uint32_t res,
-                        uint32_t op0,
-                        uint32_t op1,
-                        uint32_t cflag,
-                        uint32_t bits);
+                            uint32_t cflag);
 
     /* Helper functions */
     int ldr(Reg rt, uint32_t drn, uint32_t offset, MemoryInstructionType type);
@@ -195,17 +226,21 @@ private:
             uint32_t drn,
             uint32_t offset,
             MemoryInstructionType type);
-    void populateRegisterList(std::list<Reg> &regList, uint32_t rl);
+    void populateRegisterList(uint32_t &regList, uint32_t rl);
+    Reg popRegisterList(uint32_t &regList);
     int requestNextStore();
+    int requestNextLoad();
+    uint32_t getBurstWords(uint32_t byteAddr, uint32_t words);
 
     /* Helper load and store formatting functions */
     void formatDataForMemLoad(MemoryInstructionType type,
                               uint32_t &data,
                               uint32_t offset);
     void formatDataForMemStore(MemoryInstructionType type,
-                               uint32_t data,
                                uint32_t &drt,
+                               uint32_t &byteEnable,
                                uint32_t offset);
+    uint32_t getLoadByteEnable(MemoryInstructionType type, uint32_t offset);
 
     /* Calculate stats */
     void calculateExecCycles();
@@ -236,6 +271,7 @@ private:
         MemoryInstructionType type;
         uint32_t memToken;
         uint32_t data;
+        uint32_t byteEnable;
         Reg dataReg;
         Reg addrReg;
     } storeTmps;
@@ -243,31 +279,70 @@ private:
     {
         uint32_t ptr;
         uint32_t byteOffset;
-        std::list<Reg> regList;
-        uint32_t memToken;
+        /* Registers left to transfer, one bit per register number */
+        uint32_t regList{ 0 };
+        /* Words that were not requested yet */
+        uint32_t reqWords;
+        /*
+         * Requests in the order they were placed with the words that each
+         * transfers. The ones from respIndex to reqIndex are in flight
+         */
+        uint32_t memTokens[REGFILE_CORE_REGS_COUNT];
+        uint32_t burstWords[REGFILE_CORE_REGS_COUNT];
+        uint32_t reqIndex;
+        uint32_t respIndex;
         uint32_t data;
+        uint32_t burstData[REGFILE_CORE_REGS_COUNT];
         Reg destReg;
         Reg baseReg;
     } mloadTmps;
     struct MultipleStoreTemporaries
     {
         uint32_t ptr;
-        std::list<Reg> regList;
+        uint32_t regList{ 0 };
         uint32_t byteOffset;
         uint32_t data;
-        uint32_t memToken;
+        uint32_t burstData[REGFILE_CORE_REGS_COUNT];
+        /*
+         * Requests in order with the registers that each transfers. The ones
+         * from respIndex to reqIndex are in flight
+         */
+        uint32_t memTokens[REGFILE_CORE_REGS_COUNT];
+        uint32_t reqRegLists[REGFILE_CORE_REGS_COUNT];
+        uint32_t reqIndex;
+        uint32_t respIndex;
         Reg baseReg;
         Reg srcReg;
         DecodedOperation op;
     } mstoreTmps;
+    /* Where fetch went after the instruction, kept once it is released */
+    struct PredictionTemporaries
+    {
+        uint32_t fallThroughAddr;
+        uint32_t predictedAddr;
+        uint64_t predictedCycle;
+        /* The instruction was a branch and the predictor checked it */
+        bool resolved;
+    } predictionTmps;
 
     DecodedInst *decodedInst{ nullptr };
 
+    /* Set while running an instruction for the functional model */
+    bool functional{ false };
+    /*
+     * Transfer the registers of a multiple load or store that fall in the
+     * same memory access width line with a single request
+     */
+    bool burstTransfers{ false };
+
     RegFile *regFile{ nullptr };
     Decode *decode{ nullptr };
     Fetch *fetch{ nullptr };
     Memory *mem{ nullptr };
     Statistics *stats{ nullptr };
+    BranchPredictor *predictor{ nullptr };
+    LoopBuffer *loopBuffer{ nullptr };
+    WriteBuffer *writeBuffer{ nullptr };
 };
 
 #endif /* _EXECUTE_H_ */
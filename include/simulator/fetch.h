@@ -24,40 +24,127 @@
 #ifndef _FETCH_H_
 #define _FETCH_H_
 
+#include "simulator/config.h"
+#include "simulator/loopbuffer.h"
 #include "simulator/memory.h"
+#include "simulator/predictor.h"
 #include "simulator/regfile.h"
-#include "simulator/stats.h"
+
+#include <cstdint>
 
 /* Forward definition to avoid circular inclusion problem */
 class Execute;
+class Statistics;
+
+/* Line of the memory access width requested by fetch */
+struct FetchQueueEntry
+{
+    uint32_t baseAddr;
+    uint32_t memToken;
+    /* Placed in the memory and waiting for the response */
+    bool issued;
+    /* Lost the arbitration, so it has to be placed again */
+    bool rejected;
+    /* The response arrived and insts holds the line */
+    bool valid;
+    /* Decode took at least one instruction from the line */
+    bool fetched;
+    /*
+     * A branch in the line from the pc onwards is predicted taken, so the
+     * next entry holds the line of its target instead of the following one
+     */
+    bool redirect;
+    uint32_t branchAddr;
+    uint32_t target;
+    /* Cycle in which the line was first requested */
+    uint64_t requestCycle;
+    uint16_t *insts;
+};
+
+/* Instruction handed to decode and the address that fetch continued from */
+struct FetchedInst
+{
+    uint16_t inst;
+    uint32_t addr;
+    uint32_t nextAddr;
+    /* Cycle since which fetch follows nextAddr if it is a branch target */
+    uint64_t redirectCycle;
+};
 
+/*
+ * Fetch keeps a queue of lines, starting with the one that holds the pc, and
+ * requests up to queueDepth lines ahead of the next instruction. The lines
+ * are sequential unless a branch predictor is set, in which case the line
+ * after a branch predicted taken is the one of its target. While the pc is in
+ * the loop held by the loop buffer, if any, the instructions come from the
+ * buffer and the queue stays empty
+ */
 class Fetch
 {
 public:
-    Fetch(Memory *memIn, RegFile *regFileIn, Statistics *statsIn);
+    Fetch(Memory *memIn,
+          RegFile *regFileIn,
+          Statistics *statsIn,
+          uint32_t queueDepthIn = FETCH_QUEUE_DEPTH);
     ~Fetch();
 
     void flush();
-    int getNextInst(uint16_t &inst);
+    bool isFlushPending();
+    bool hasIssuedMemAccess();
+    int getNextInst(FetchedInst &fetched);
+    void snoopStore(uint32_t byteAddr);
 
     int run();
 
     void setExecute(Execute *executeIn);
+    void setBranchPredictor(BranchPredictor *predictorIn);
+    void setLoopBuffer(LoopBuffer *loopBufferIn);
+
+    uint64_t getCycle()
+    {
+        return cycle;
+    }
+
+    uint32_t getQueueDepth()
+    {
+        return queueDepth;
+    }
 
     void print();
 
 private:
+    FetchQueueEntry *getQueueEntry(uint32_t index)
+    {
+        return &queue[(queueHead + index) % queueSize];
+    }
+
+    void flushQueue();
+    void discardQueueEntries(uint32_t first);
+    void retrieveQueueEntries();
+    void predictQueueEntries(uint32_t pc);
+    void requestQueueEntries(uint32_t pc, bool redirected);
+    void replayLoopInst(uint32_t pc, uint16_t inst, FetchedInst &fetched);
+    void timeLoopIteration(uint32_t pc, bool replayed);
+
     Memory *mem;
     RegFile *regFile;
     Execute *execute;
     Statistics *stats;
+    BranchPredictor *predictor{ nullptr };
+    LoopBuffer *loopBuffer{ nullptr };
 
-    uint32_t memToken{ 0xFFFFFFFF };
-    bool issuedMemAccess{ false };
-    uint16_t *instBuffer{ nullptr };
-    uint32_t instBufferBaseAddr{ 0 };
-    bool instBufferValid{ false };
+    FetchQueueEntry *queue{ nullptr };
+    uint32_t queueDepth;
+    /* The line of the pc stays until decode moves on, so one extra entry */
+    uint32_t queueSize;
+    uint32_t queueHead{ 0 };
+    uint32_t queueCount{ 0 };
+    uint32_t lineBytes;
+    /* A line arrived since the last flush */
+    bool filled{ false };
     bool flushPending{ false };
+    /* Cycles run so far, used to time the predicted branches */
+    uint64_t cycle{ 0 };
 };
 
 #endif /* _FETCH_H_ */
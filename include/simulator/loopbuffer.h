@@ -0,0 +1,100 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef _LOOPBUFFER_H_
+#define _LOOPBUFFER_H_
+
+#include "simulator/config.h"
+
+#include <cstdint>
+
+/*
+ * Holds the halfwords of the last short backward loop, from the target of
+ * the branch to the branch itself. Execute records the loop when the branch
+ * is taken and fetch captures the halfwords as it hands them to decode.
+ * Once every halfword was captured fetch replays the loop from the buffer,
+ * assuming that the branch is taken, so it does not access the memory until
+ * the loop exits
+ */
+class LoopBuffer
+{
+public:
+    LoopBuffer(uint32_t entriesIn);
+    ~LoopBuffer();
+
+    void recordLoop(uint32_t branchAddr, uint32_t target);
+    void capture(uint32_t addr, uint16_t inst);
+    bool lookup(uint32_t addr, uint16_t &inst);
+    void invalidate(uint32_t baseByteAddr, uint32_t endByteAddr);
+    bool startIteration(uint64_t cycle,
+                        bool replayed,
+                        uint64_t &iterationCycles,
+                        uint64_t &fetchedCycles);
+
+    uint32_t getEntries()
+    {
+        return entries;
+    }
+
+    uint32_t getStartAddr()
+    {
+        return startAddr;
+    }
+
+    uint32_t getEndAddr()
+    {
+        return endAddr;
+    }
+
+private:
+    bool contains(uint32_t addr)
+    {
+        return valid && addr >= startAddr && addr <= endAddr;
+    }
+
+    uint32_t getIndex(uint32_t addr)
+    {
+        return (addr - startAddr) >> 1;
+    }
+
+    uint32_t entries;
+    uint16_t *insts;
+    bool *captured;
+    uint32_t capturedCount{ 0 };
+
+    /* The loop runs from startAddr to the branch at endAddr */
+    bool valid{ false };
+    uint32_t startAddr{ 0 };
+    uint32_t endAddr{ 0 };
+
+    /*
+     * The iterations are timed from one visit of startAddr to the next, so
+     * the ones replayed can be compared to the last one fetched from memory
+     */
+    bool iterationStarted{ false };
+    bool iterationReplayed{ false };
+    uint64_t iterationStart{ 0 };
+    uint64_t fetchedIterationCycles{ 0 };
+};
+
+#endif /* _LOOPBUFFER_H_ */
@@ -0,0 +1,79 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef _MEMO_H_
+#define _MEMO_H_
+
+#include "simulator/blockcache.h"
+#include "simulator/config.h"
+#include "simulator/stats.h"
+
+#include <cstdint>
+
+/*
+ * Block of straight-line code that runs between two pipeline flushes. The
+ * pipeline restarts from an empty state after every taken branch, so the
+ * cycles spent on a block without memory accesses only depend on its start
+ * address, which also fixes where the instruction buffer is refilled from
+ */
+struct MemoizedBlock
+{
+    bool valid{ false };
+    /* The block has no memory accesses and ends with a branch */
+    bool memoizable{ false };
+    /* The counters were recorded by a full simulation of the block */
+    bool timed{ false };
+    uint32_t startAddr{ 0 };
+    uint32_t visits{ 0 };
+    PipelineCounters counters;
+    PredecodedBlock block;
+};
+
+/*
+ * Direct-mapped cache of the timing of blocks indexed by their start
+ * address. One in every verifyInterval visits to a timed block is simulated
+ * in full again to check the memoized counters
+ */
+class TimingMemo
+{
+public:
+    TimingMemo(uint32_t verifyIntervalIn);
+    ~TimingMemo();
+
+    MemoizedBlock *lookup(uint32_t startAddr);
+    MemoizedBlock *allocate(uint32_t startAddr);
+    bool replayVisit(MemoizedBlock *entry);
+    bool record(MemoizedBlock *entry,
+                PipelineCounters &start,
+                PipelineCounters &end);
+    void invalidate();
+
+    static bool isMemoizable(PredecodedBlock &block);
+    static void charge(MemoizedBlock *entry, PipelineCounters &counters);
+
+private:
+    MemoizedBlock *entries;
+    uint32_t verifyInterval;
+};
+
+#endif /* _MEMO_H_ */
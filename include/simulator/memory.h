@@ -24,10 +24,38 @@
 #ifndef _MEMORY_H_
 #define _MEMORY_H_
 
+#include "simulator/accelerator.h"
+#include "simulator/cache.h"
 #include "simulator/config.h"
 #include "simulator/utils.h"
 
+#include <cstdint>
 #include <string>
+#include <vector>
+
+/* Forward definition to avoid circular inclusion problem */
+class Statistics;
+
+/*
+ * The 32-bit address space is split in 4MB chunks that are mapped on first
+ * touch. The mappings are anonymous, so the host kernel zeroes and allocates
+ * their pages lazily as they are accessed
+ */
+#define MEM_CHUNK_WORDS_SHIFT 20
+#define MEM_CHUNK_WORDS (1U << MEM_CHUNK_WORDS_SHIFT)
+#define MEM_CHUNK_COUNT (1U << (32 - 2 - MEM_CHUNK_WORDS_SHIFT))
+#define MEM_MAX_SIZE_WORDS 0x40000000
+
+/* Byte lanes written by a store, with one bit for each byte of a word */
+#define MEM_BYTE_ENABLE_WORD 0xF
+
+/*
+ * Fetches have a port of their own when the ports are separate, otherwise
+ * every request goes through the data port
+ */
+#define MEM_DATA_PORT 0
+#define MEM_FETCH_PORT 1
+#define MEM_PORT_COUNT 2
 
 enum class Component
 {
@@ -45,6 +73,14 @@ enum class MemoryAccessType
     NONE,
 };
 
+/* Which request the arbiter grants when several arrive in the same cycle */
+enum class MemoryArbitration
+{
+    EXECUTE_FIRST,
+    FETCH_FIRST,
+    ROUND_ROBIN,
+};
+
 class MemoryRequest
 {
 public:
@@ -52,39 +88,109 @@ public:
     MemoryAccessType type;
     uint32_t token;
     uint32_t byteAddr;
+    uint32_t waitCycles;
+    /* Cycles left until the response is ready, not counting wait states */
+    uint32_t latencyCycles;
+    /* Won the arbitration, requests that did not are still bidding */
+    bool granted;
+    /* Served and waiting for the issuer to retrieve the response */
+    bool completed;
+    /* The issuer no longer wants the response */
+    bool discarded;
     uint32_t *reqData;
-    bool *reqEnable;
+    /* Byte lanes to write of each word in reqData */
+    uint8_t *reqEnable;
     uint32_t *respData;
 };
 
+/* Requests that go through one port, which serves them in order */
+struct MemoryPort
+{
+    /* First of the entries of the request table that the port uses */
+    uint32_t requestsBase;
+    /* Indices in the request table of the ones in flight, oldest first */
+    uint32_t *inFlight;
+    uint32_t inFlightHead;
+    uint32_t inFlightCount;
+    Component lastGranted;
+    /* Requests placed in this cycle, which go through the arbitration */
+    uint32_t bidCount;
+    /* The last request placed, granted without arbitration if it is alone */
+    MemoryRequest *lastBid;
+};
+
+/*
+ * Timing of a range of addresses. The latencies are the wait states added to
+ * each access and an access wider than the region takes one transfer for each
+ * accessWidthWords. Addresses outside every region have no wait states
+ */
+struct MemoryRegion
+{
+    uint32_t baseByteAddr;
+    uint64_t endByteAddr;
+    uint32_t readLatency;
+    uint32_t writeLatency;
+    uint32_t accessWidthWords;
+    bool readOnly;
+};
+
 class Memory
 {
 public:
     Memory(uint32_t memSizeWordsIn = MEM_SIZE_WORDS,
            uint32_t memAccessWidthWordsIn = MEM_ACCESS_WIDTH_WORDS,
-           uint32_t pipelineSizeIn = MEM_PIPELINE_SIZE);
+           uint32_t latencyCyclesIn = MEM_LATENCY_CYCLES,
+           uint32_t maxOutstandingIn = MEM_MAX_OUTSTANDING,
+           Statistics *statsIn = nullptr);
     ~Memory();
 
     /* Functions for booting */
     int loadProgram(char *programFile,
                     uint32_t &pc,
                     uint32_t &programByteSize);
+    int loadRegionMap(char *regionMapFile);
 
-    /* Convenience function for loading a word without interface */
+    /* Convenience functions for accessing a word without interface */
     void loadWord(uint32_t byteAddr, uint32_t &data);
+    void storeWord(uint32_t byteAddr,
+                   uint32_t data,
+                   uint32_t byteEnable = MEM_BYTE_ENABLE_WORD);
+
+    /* Detect stores that modify predecoded code */
+    void watchStores(uint32_t baseByteAddr, uint32_t endByteAddr);
+    void unwatchStores();
+    bool checkWatchedStore();
 
     /* Create a request in the memory access pipeline */
     int requestLoad(Component issuer, uint32_t byteAddr, uint32_t &token);
     int requestStore(Component issuer,
                      uint32_t byteAddr,
                      uint32_t data,
+                     uint32_t byteEnable,
                      uint32_t &token);
+    int requestBurstStore(Component issuer,
+                          uint32_t byteAddr,
+                          const uint32_t *data,
+                          uint32_t words,
+                          uint32_t &token);
 
     int retrieveLoad(uint32_t token, uint32_t &data);
     int retrieveStore(uint32_t token);
     int retrieveWideLoad(uint32_t token, uint32_t *data);
+    int retrieveBurstLoad(uint32_t token, uint32_t *data, uint32_t words);
 
-    bool isAvailable();
+    void discard(uint32_t token);
+    void setArbitration(MemoryArbitration arbitrationIn);
+    void setSeparatePorts(bool separatePortsIn);
+    void setInstCache(const CacheConfig &config);
+    void setDataCache(const CacheConfig &config);
+    void setFetchAccelerator(const FetchAcceleratorConfig &config);
+
+    bool isAvailable(Component issuer);
+    bool isPending(uint32_t token);
+    bool isRejected(uint32_t token);
+    bool isIdle();
+    bool hasNewRequest(Component issuer);
 
     int run();
 
@@ -115,21 +221,112 @@ public:
         return memSizeWords;
     }
 
+    uint32_t getLatencyCycles()
+    {
+        return latencyCycles;
+    }
+
+    uint32_t getMaxOutstanding()
+    {
+        return maxOutstanding;
+    }
+
     void print();
     void dump();
 
     static std::string componentToStr(Component component);
     static std::string memAccessTypeToStr(MemoryAccessType type);
+    static uint32_t mergeByteLanes(uint32_t prevData,
+                                   uint32_t data,
+                                   uint32_t byteEnable);
 
 private:
-    uint32_t *mem{ nullptr };
+    /* Return the word at wordIndex, mapping its chunk if needed */
+    uint32_t *getWordPtr(uint32_t wordIndex)
+    {
+        uint32_t chunkIndex = wordIndex >> MEM_CHUNK_WORDS_SHIFT;
+
+        if (chunkIndex != lastChunkIndex)
+        {
+            lastChunk = lookupChunk(chunkIndex);
+            lastChunkIndex = chunkIndex;
+        }
+
+        return lastChunk + (wordIndex & (MEM_CHUNK_WORDS - 1));
+    }
+
+    uint32_t *lookupChunk(uint32_t chunkIndex);
+    bool isPageTouched(int pagemapFd, uint32_t wordIndex);
+
+    MemoryRequest *allocateRequest(Component issuer,
+                                   MemoryAccessType type,
+                                   uint32_t byteAddr,
+                                   uint32_t waitCycles,
+                                   uint32_t &token);
+    MemoryRequest *findRequest(uint32_t token, bool completed);
+    MemoryPort *getPort(Component issuer);
+    void arbitrate(MemoryPort *port);
+    bool hasPriority(MemoryPort *port,
+                     MemoryRequest *req,
+                     MemoryRequest *other);
+    void rejectRequest(MemoryRequest *req);
+    Cache *createCache(const CacheConfig &config);
+    void accessCache(MemoryRequest *req);
+    void accessFetchAccelerator(MemoryRequest *req);
+    void runPort(MemoryPort *port);
+    void serveRequest(MemoryRequest *req);
+
+    MemoryRegion *findRegion(uint32_t byteAddr);
+    uint32_t getWaitCycles(uint32_t byteAddr,
+                           MemoryAccessType type,
+                           uint32_t words);
+    uint32_t getLineTransferCycles(uint32_t byteAddr,
+                                   MemoryAccessType type,
+                                   uint32_t lineBytes);
+    void checkWritable(uint32_t byteAddr);
+
+    uint32_t *chunks[MEM_CHUNK_COUNT]{ nullptr };
+    uint32_t *lastChunk{ nullptr };
+    uint32_t lastChunkIndex{ UINT32_MAX };
+    /* Bytes of memory mapped from the program binary */
+    uint32_t programMapBytes{ 0 };
     uint32_t memSizeWords;
     uint32_t memAccessWidthWords;
 
-    MemoryRequest *pipeline{ nullptr };
-    uint32_t pipelineSize;
-    uint32_t nextReqIndex;
+    /* Regions are searched in order, so earlier entries take precedence */
+    std::vector<MemoryRegion> regionMap;
+
+    uint32_t watchBaseByteAddr{ 0 };
+    uint32_t watchEndByteAddr{ 0 };
+    bool watchedStore{ false };
+
+    /*
+     * Requests in flight and responses that were not retrieved yet, split in
+     * equal parts between the ports
+     */
+    MemoryRequest *requests{ nullptr };
+    uint32_t requestsSize;
+    uint32_t portRequestsSize;
+    MemoryPort ports[MEM_PORT_COUNT];
+    bool separatePorts{ false };
+    uint32_t latencyCycles;
+    uint32_t maxOutstanding;
     uint32_t nextToken;
+
+    /* A single request is granted per port and cycle, the others rejected */
+    MemoryArbitration arbitration{ MemoryArbitration::EXECUTE_FIRST };
+    /* Requests rejected in the last cycle, so their issuers can retry */
+    std::vector<uint32_t> rejectedTokens;
+
+    /* Caches in front of the memory, fetches use instCache */
+    Cache *instCache{ nullptr };
+    Cache *dataCache{ nullptr };
+    /* Line buffers and prefetcher for fetches, replacing instCache */
+    FetchAccelerator *fetchAccelerator{ nullptr };
+    /* Cycles run with the accelerator, which it uses to time its reads */
+    uint64_t cycle{ 0 };
+
+    Statistics *stats;
 };
 
 #endif /* _MEMORY_H_ */
@@ -0,0 +1,93 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef _PREDICTOR_H_
+#define _PREDICTOR_H_
+
+#include "simulator/config.h"
+
+#include <cstdint>
+#include <string>
+
+enum class BranchPredictorType
+{
+    /* Backward taken, forward not taken */
+    STATIC,
+    /* Counters indexed by the branch address */
+    BIMODAL,
+    /* Counters indexed by the branch address xor the global history */
+    GSHARE,
+};
+
+struct BranchPredictorConfig
+{
+    BranchPredictorType type{ BranchPredictorType::STATIC };
+    uint32_t btbEntries{ BRANCH_TARGET_BUFFER_ENTRIES };
+    uint32_t counters{ BRANCH_PREDICTOR_COUNTERS };
+};
+
+/*
+ * Direction predictor with a direct-mapped branch target buffer (BTB). The
+ * BTB is indexed by the address of the last halfword of a branch, so fetch
+ * only redirects at branches that were taken before. Branches other than
+ * the conditional ones are always predicted taken to the target they had
+ * the last time. The counters are 2-bit and saturate, and both they and the
+ * history are only updated once a branch executes
+ */
+class BranchPredictor
+{
+public:
+    BranchPredictor(const BranchPredictorConfig &configIn);
+    ~BranchPredictor();
+
+    bool predict(uint32_t branchAddr, uint32_t &target);
+    void update(uint32_t branchAddr,
+                bool conditional,
+                bool taken,
+                uint32_t target);
+    void invalidate(uint32_t branchAddr);
+
+    static int parseConfig(const char *str, BranchPredictorConfig &config);
+    static std::string configToStr(const BranchPredictorConfig &config);
+
+private:
+    uint32_t getBtbIndex(uint32_t branchAddr)
+    {
+        return (branchAddr >> 1) & (config.btbEntries - 1);
+    }
+
+    uint32_t getCounterIndex(uint32_t branchAddr);
+
+    BranchPredictorConfig config;
+
+    uint32_t *tags;
+    uint32_t *targets;
+    bool *valid;
+    bool *conditional;
+
+    uint8_t *counters;
+    /* Outcome of the last conditional branches, the newest in bit 0 */
+    uint32_t history{ 0 };
+};
+
+#endif /* _PREDICTOR_H_ */
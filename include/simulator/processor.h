@@ -24,31 +24,80 @@
 #ifndef _PROCESSOR_H_
 #define _PROCESSOR_H_
 
+#include "simulator/blockcache.h"
 #include "simulator/decode.h"
 #include "simulator/execute.h"
 #include "simulator/fetch.h"
+#include "simulator/loopbuffer.h"
+#include "simulator/memo.h"
 #include "simulator/memory.h"
+#include "simulator/predictor.h"
 #include "simulator/regfile.h"
 #include "simulator/stats.h"
+#include "simulator/writebuffer.h"
 
 #include <cstdint>
 
+/* Stop address for fastForward() that never matches as the pc is aligned */
+#define FAST_FORWARD_NO_ADDR 0xFFFFFFFF
+
 class Processor
 {
 public:
-    Processor(uint32_t memSizeWordsIn, uint32_t memAccessWidthWordsIn);
+    Processor(uint32_t memSizeWordsIn,
+              uint32_t memAccessWidthWordsIn,
+              uint32_t memLatencyCyclesIn = MEM_LATENCY_CYCLES,
+              uint32_t memMaxOutstandingIn = MEM_MAX_OUTSTANDING,
+              uint32_t fetchQueueDepthIn = FETCH_QUEUE_DEPTH);
     ~Processor();
 
     int simulateCycle();
     int reset(char *programBinFile);
+    int loadRegionMap(char *regionMapFile);
+    int checkDecoder();
+    int fastForward(uint64_t maxInsts, uint32_t stopAddr);
+    void setThreadedDispatch(bool threadedDispatchIn);
+    void setBurstTransfers(bool burstTransfersIn);
+    void setMemArbitration(MemoryArbitration memArbitrationIn);
+    void setSeparateMemPorts(bool separateMemPortsIn);
+    void setInstCache(const CacheConfig &config);
+    void setDataCache(const CacheConfig &config);
+    void setFetchAccelerator(const FetchAcceleratorConfig &config);
+    void setBranchPredictor(const BranchPredictorConfig &config);
+    void setLoopBuffer(uint32_t entries);
+    void setWriteBuffer(uint32_t entries);
+    void setTimingMemo(uint32_t verifyInterval);
 
 private:
+    DecodedInst *decodeNextFunctional(uint32_t &instAddr);
+    void predecodeBlock(PredecodedBlock *block, uint32_t stopAddr);
+    uint64_t runPredecodedBlock(PredecodedBlock *block, BlockCache &blockCache);
+    void runMemoizedBlocks(bool memIdle);
+    bool replayMemoizedBlock(MemoizedBlock *entry);
+    void finishRecordedBlock(bool memIdle);
+
     Statistics *stats;
     RegFile *regFile;
     Memory *mem;
     Fetch *fetch;
     Decode *decode;
     Execute *execute;
+    BranchPredictor *predictor{ nullptr };
+    LoopBuffer *loopBuffer{ nullptr };
+    WriteBuffer *writeBuffer{ nullptr };
+
+    /* Run predecoded blocks with the direct-threaded interpreter */
+    bool threadedDispatch{ false };
+
+    /* Timing memoization, the block being timed and its initial state */
+    TimingMemo *timingMemo{ nullptr };
+    MemoizedBlock *recordedBlock{ nullptr };
+    PipelineCounters recordStart;
+    uint64_t recordBranchesNotTaken{ 0 };
+
+    /* State to roll back to when the branch of a replayed block fails */
+    RegFile regFileCheckpoint;
+    Statistics statsCheckpoint;
 };
 
 #endif /* _PROCESSOR_H_ */
@@ -70,6 +70,15 @@ enum class Reg
     RNONE,
 };
 
+/* Flags that are pending to be calculated from the last ALU operation */
+enum class XpsrFlagsOp
+{
+    NONE,
+    NZ,
+    NZC,
+    NZCV,
+};
+
 class RegFile
 {
 public:
@@ -79,6 +88,12 @@ public:
 
     void write(Reg reg, uint32_t data);
 
+    void setXpsrFlagsLazy(XpsrFlagsOp op,
+                          uint32_t res,
+                          uint32_t op0,
+                          uint32_t op1,
+                          uint32_t cflag);
+
     void setControlS(uint32_t flag);
     void setControlP(uint32_t flag);
 
@@ -110,7 +125,16 @@ public:
     static uint32_t setXpsrException(uint32_t xpsr, uint32_t exceptionNum);
 
 private:
+    void materializeXpsrFlags();
+
     uint32_t regs[REGFILE_SIZE]{ 0 };
+
+    /* Operation and operands that the pending xPSR flags are derived from */
+    XpsrFlagsOp xpsrFlagsOp{ XpsrFlagsOp::NONE };
+    uint32_t xpsrFlagsRes{ 0 };
+    uint32_t xpsrFlagsOp0{ 0 };
+    uint32_t xpsrFlagsOp1{ 0 };
+    uint32_t xpsrFlagsCarry{ 0 };
 };
 
 #endif /* _REGFILE_H_ */
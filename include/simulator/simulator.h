@@ -24,17 +24,49 @@
 #ifndef _SIMULATOR_H_
 #define _SIMULATOR_H_
 
+#include "simulator/config.h"
 #include "simulator/processor.h"
 
 #include <cstdint>
 
+/*
+ * Options of a simulation. The caches, accelerator and predictor are only
+ * added if their has flag is set, and the buffers if they have any entries
+ */
+struct SimulatorConfig
+{
+    uint32_t memSizeWords{ MEM_SIZE_WORDS };
+    uint32_t memAccessWidthWords{ MEM_ACCESS_WIDTH_WORDS };
+    uint64_t fastForwardInsts{ 0 };
+    uint32_t fastForwardAddr{ FAST_FORWARD_NO_ADDR };
+    bool threadedDispatch{ false };
+    bool timingMemo{ false };
+    uint32_t timingMemoVerify{ 0 };
+    char *regionMapFile{ nullptr };
+    bool burstTransfers{ false };
+    uint32_t memLatencyCycles{ MEM_LATENCY_CYCLES };
+    uint32_t memMaxOutstanding{ MEM_MAX_OUTSTANDING };
+    uint32_t fetchQueueDepth{ FETCH_QUEUE_DEPTH };
+    MemoryArbitration memArbitration{ MemoryArbitration::EXECUTE_FIRST };
+    bool separateMemPorts{ false };
+    CacheConfig instCache;
+    bool hasInstCache{ false };
+    CacheConfig dataCache;
+    bool hasDataCache{ false };
+    FetchAcceleratorConfig fetchAccel;
+    bool hasFetchAccel{ false };
+    BranchPredictorConfig predictor;
+    bool hasPredictor{ false };
+    uint32_t loopBufferEntries{ 0 };
+    uint32_t writeBufferEntries{ 0 };
+};
+
 class Simulator
 {
 public:
     int run(char *programBinFile);
-    int run(char *programBinFile,
-            uint32_t memSizeWordsIn,
-            uint32_t memAccessWidthWordsIn);
+    int run(char *programBinFile, const SimulatorConfig &config);
+    int checkDecoder();
 
 private:
     Processor *proc;
@@ -24,9 +24,12 @@
 #ifndef _STATISTICS_H_
 #define _STATISTICS_H_
 
+#include "simulator/cache.h"
+#include "simulator/decode.h"
+
+#include <array>
 #include <cstdint>
 #include <string>
-#include <unordered_map>
 
 enum class Instruction
 {
@@ -72,15 +75,31 @@ enum class Instruction
     TST,
     UXTB,
     UXTH,
+    COUNT,
+};
+
+/* Counters that only change with the state of the pipeline */
+struct PipelineCounters
+{
+    uint64_t cycles{ 0 };
+    uint64_t fetchMemCycles{ 0 };
+    uint64_t executeMemCycles{ 0 };
+    uint64_t stalledForDecodeCycles{ 0 };
+    uint64_t fetchStalledForMemCycles{ 0 };
+    uint64_t executeStalledForMemCycles{ 0 };
+    uint64_t memWaitCycles{ 0 };
+    uint64_t fetchQueueEntries{ 0 };
+    uint64_t fetchQueueFlushedEntries{ 0 };
 };
 
-struct EnumInstructionHash
+/* Outcome of the accesses to one of the caches */
+struct CacheCounters
 {
-    template<typename T>
-    std::size_t operator()(T t) const
-    {
-        return static_cast<std::size_t>(t);
-    }
+    uint64_t hits{ 0 };
+    uint64_t misses{ 0 };
+    /* Valid lines replaced by misses, dirty or not */
+    uint64_t evictions{ 0 };
+    uint64_t writeBacks{ 0 };
 };
 
 class Statistics
@@ -91,21 +110,88 @@ public:
     void addExecuteCycle();
 
     void addStallForDecodeCycle();
+    void addFetchStallForMemCycle();
+    void addExecuteStallForMemCycle();
+    void addMemWaitCycle();
+    void addFetchQueueFlushedEntry();
+    void addFetchArbitrationLoss();
+    void addExecuteArbitrationLoss();
+
+    void addMultipleMemRequest();
+
+    void addInstCacheAccess(CacheAccessResult result);
+    void addDataCacheAccess(CacheAccessResult result);
+    void addFetchAccelHit(bool branchTarget);
+    void addFetchAccelMiss();
+    void addFetchAccelPrefetch();
+    void addFetchAccelWastedPrefetch();
 
     void addBranchTaken();
     void addBranchNotTaken();
+    void addBranchPrediction(bool correct);
+    void addLoopBufferSavedRequest();
+    void addLoopBufferIteration(uint64_t cycles, uint64_t fetchedCycles);
+
+    void addWriteBufferStore();
+    void addWriteBufferFullStall();
+    void addWriteBufferForward();
+    void addWriteBufferDrainStall();
+
+    void addDecodeCacheHit();
+    void addDecodeCacheMiss();
+
+    void addDecodedInstAllocation();
+
+    void addFastForwardedInst();
+
+    void addMemoizedBlock();
+    void addMemoizedBlockMismatch();
+
+    /* Bulk updates for programs that count events themselves */
+    void addCycles(uint64_t count);
+    void addBranchesTaken(uint64_t count);
+    void addBranchesNotTaken(uint64_t count);
+    void addBranchPredictorSavedCycles(uint64_t count);
+    void addMultipleMemWords(uint64_t count);
+    void addFetchQueueEntries(uint64_t count);
+    void addFastForwardedInsts(uint64_t count);
+    void addInstructions(Instruction inst, uint64_t count);
+    void addDecodedOperations(DecodedOperation op, uint64_t count);
 
     void setProgramSizeBytes(uint32_t size);
     void setMemSizeWords(uint32_t size);
     void setMemAccessWidthWords(uint32_t size);
+    void setMemLatencyCycles(uint32_t cycles);
+    void setMemMaxOutstanding(uint32_t count);
+    void setMemSeparatePorts(bool separate);
+    void setFetchQueueDepth(uint32_t depth);
+    void setInstCacheConfig(std::string config);
+    void setDataCacheConfig(std::string config);
+    void setFetchAccelConfig(std::string config);
+    void setBranchPredictorConfig(std::string config);
+    void setLoopBufferEntries(uint32_t entries);
+    void setWriteBufferEntries(uint32_t entries);
+
+    void resetExecution();
+
+    void getPipelineCounters(PipelineCounters &counters);
+    void setPipelineCounters(PipelineCounters &counters);
+    uint64_t getBranchesNotTaken();
 
     void addInstruction(Instruction inst);
+    void addDecodedOperation(DecodedOperation op);
 
     static std::string getInstructionStr(Instruction inst);
 
     void print();
 
 private:
+    static void addCacheAccess(CacheCounters &counters,
+                               CacheAccessResult result);
+    static void printCacheCounters(std::string &prefix,
+                                   const char *name,
+                                   CacheCounters &counters);
+
     /* Total cycles */
     uint64_t cycles{ 0 };
     /* Cycles spent placing memory requests */
@@ -115,6 +201,34 @@ private:
 
     /* Cycles stalled due to unavailable decoded instruction */
     uint64_t stalledForDecodeCycles{ 0 };
+    /* Cycles a stage could not place a request as its port was busy */
+    uint64_t fetchStalledForMemCycles{ 0 };
+    uint64_t executeStalledForMemCycles{ 0 };
+    /* Cycles the memory held a request in its wait states */
+    uint64_t memWaitCycles{ 0 };
+    /* Lines in the fetch queue added over every cycle */
+    uint64_t fetchQueueEntries{ 0 };
+    /* Lines in the fetch queue that a flush discarded before their use */
+    uint64_t fetchQueueFlushedEntries{ 0 };
+    /* Requests that lost the memory arbitration and had to be retried */
+    uint64_t fetchArbitrationLosses{ 0 };
+    uint64_t executeArbitrationLosses{ 0 };
+
+    /* Memory requests of multiple transfers and the words they moved */
+    uint64_t multipleMemRequests{ 0 };
+    uint64_t multipleMemWords{ 0 };
+
+    /* Accesses to the instruction and data caches */
+    CacheCounters instCacheCounters;
+    CacheCounters dataCacheCounters;
+
+    /* Fetches served by the accelerator, with those from branch targets */
+    uint64_t fetchAccelHits{ 0 };
+    uint64_t fetchAccelTargetHits{ 0 };
+    uint64_t fetchAccelMisses{ 0 };
+    /* Lines prefetched and those replaced before being fetched */
+    uint64_t fetchAccelPrefetches{ 0 };
+    uint64_t fetchAccelWastedPrefetches{ 0 };
 
     /* Program size not including header */
     uint32_t programSizeBytes{ 0 };
@@ -123,14 +237,72 @@ private:
     uint32_t memSizeWords{ 0 };
     /* Memory access width */
     uint32_t memAccessWidthWords{ 0 };
+    /* Memory latency and requests in flight at the same time */
+    uint32_t memLatencyCycles{ 0 };
+    uint32_t memMaxOutstanding{ 0 };
+    /* Fetches and data accesses go through different memory ports */
+    bool memSeparatePorts{ false };
+    /* Lines that fetch requests ahead */
+    uint32_t fetchQueueDepth{ 0 };
+    /* Configuration of the caches in front of the memory */
+    std::string instCacheConfig{ "none" };
+    std::string dataCacheConfig{ "none" };
+    std::string fetchAccelConfig{ "none" };
+    std::string branchPredictorConfig{ "none" };
+    /* Halfwords of the loop buffer, 0 if there is none */
+    uint32_t loopBufferEntries{ 0 };
+    /* Stores that the write buffer holds, 0 if there is none */
+    uint32_t writeBufferEntries{ 0 };
 
     /* Branches taken (including unconditional branches) */
     uint64_t branchTaken{ 0 };
     /* Branches not taken */
     uint64_t branchNotTaken{ 0 };
+    /* Branches checked by the predictor and those where fetch went right */
+    uint64_t branchPredictions{ 0 };
+    uint64_t branchPredictionsCorrect{ 0 };
+    /* Cycles that fetch followed correctly predicted branches early */
+    uint64_t branchPredictorSavedCycles{ 0 };
+
+    /* Line requests that fetch did not place as the loop buffer held them */
+    uint64_t loopBufferSavedRequests{ 0 };
+    /*
+     * Iterations replayed from the loop buffer, their cycles and the cycles
+     * that the last iteration fetched from memory took for each of them
+     */
+    uint64_t loopBufferIterations{ 0 };
+    uint64_t loopBufferCycles{ 0 };
+    uint64_t loopBufferFetchedCycles{ 0 };
+
+    /* Stores retired into the write buffer */
+    uint64_t writeBufferStores{ 0 };
+    /* Cycles that a store waited for a free entry in the write buffer */
+    uint64_t writeBufferFullStalls{ 0 };
+    /* Loads served with the data of buffered stores */
+    uint64_t writeBufferForwards{ 0 };
+    /* Cycles that a load or store waited for buffered stores to drain */
+    uint64_t writeBufferDrainStalls{ 0 };
+
+    /* Lookups in the predecoded instruction cache */
+    uint64_t decodeCacheHits{ 0 };
+    uint64_t decodeCacheMisses{ 0 };
+
+    /* Decoded instructions allocated in the heap instead of the pool */
+    uint64_t decodedInstAllocations{ 0 };
+
+    /* Instructions run in the functional model before timing started */
+    uint64_t fastForwardedInsts{ 0 };
+
+    /* Blocks charged with memoized cycles and memoized cycles found wrong */
+    uint64_t memoizedBlocks{ 0 };
+    uint64_t memoizedBlockMismatches{ 0 };
 
     /* Information about executed instructions */
-    std::unordered_map<Instruction, uint64_t, EnumInstructionHash> instCount;
+    std::array<uint64_t, static_cast<std::size_t>(Instruction::COUNT)>
+        instCount{};
+    /* Information about executed instructions by encoding */
+    std::array<uint64_t, static_cast<std::size_t>(DecodedOperation::COUNT)>
+        decodedOpCount{};
 };
 
 #endif /* _STATISTICS_H_ */
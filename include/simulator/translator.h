@@ -0,0 +1,81 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef _TRANSLATOR_H_
+#define _TRANSLATOR_H_
+
+#include "simulator/decode.h"
+#include "simulator/memory.h"
+#include "simulator/regfile.h"
+#include "simulator/stats.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+/*
+ * Ahead-of-time translator from a program binary to C++. The control-flow
+ * graph is recovered from the entry point, the targets of direct branches
+ * and the return address of calls. Each basic block becomes a function that
+ * updates an AotState and returns the address of the next block. Code that
+ * is only reached through addresses computed at run time is left to the
+ * functional model of the runtime
+ */
+class Translator
+{
+public:
+    Translator(uint32_t memSizeWordsIn);
+    ~Translator();
+
+    int translate(char *programBinFile, char *outFile);
+
+private:
+    bool decodeNext(uint32_t &instAddr, DecodedInst &inst);
+    void addLeader(uint32_t addr);
+    void findBlocks();
+
+    std::string readReg(DecodedInst &inst, DecodedInstRegIndex index);
+    std::string writeReg(DecodedInst &inst, DecodedInstRegIndex index);
+
+    void emitBlock(FILE *out, uint32_t startAddr);
+    void emitInst(FILE *out, DecodedInst &inst, uint32_t nextAddr);
+    void emitMultipleLoad(FILE *out, DecodedInst &inst);
+    void emitMultipleStore(FILE *out, DecodedInst &inst);
+    void emitDispatcher(FILE *out);
+
+    uint32_t programByteSize{ 0 };
+    uint32_t entryAddr{ 0 };
+    uint32_t codeEndAddr{ 0 };
+
+    std::set<uint32_t> leaders;
+    std::vector<uint32_t> pendingLeaders;
+
+    Statistics *stats;
+    RegFile *regFile;
+    Memory *mem;
+    Decode *decode;
+};
+
+#endif /* _TRANSLATOR_H_ */
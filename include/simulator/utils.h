@@ -38,6 +38,10 @@
 #define GET_BIT_AT_POS(val, x) (((val) >> (x)) & 0x1)
 #define SET_BIT_AT_POS(val, x, y) (((val) & ~(0x1 << x)) | (((y)&0x1) << x))
 
+#define COUNT_SET_BITS(val) (__builtin_popcount(val))
+#define GET_LOWEST_SET_BIT_POS(val) (__builtin_ctz(val))
+#define CLEAR_LOWEST_SET_BIT(val) ((val) & ((val)-1))
+
 #define THUMB_INST_BYTES 2
 
 #define NEXT_THUMB_INST(addr) ((addr) + THUMB_INST_BYTES)
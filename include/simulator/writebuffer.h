@@ -0,0 +1,103 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#ifndef _WRITEBUFFER_H_
+#define _WRITEBUFFER_H_
+
+#include "simulator/config.h"
+#include "simulator/memory.h"
+
+#include <cstdint>
+
+/* Forward definition to avoid circular inclusion problem */
+class Statistics;
+
+/* Store waiting in the write buffer to be written to memory */
+struct WriteBufferEntry
+{
+    uint32_t byteAddr;
+    uint32_t data;
+    uint32_t byteEnable;
+    uint32_t memToken;
+    /* Placed in the memory and waiting for it to be served */
+    bool issued;
+};
+
+/* Whether the write buffer holds the bytes that a load reads */
+enum class WriteBufferLookup
+{
+    /* None of the bytes, so the load goes to memory */
+    MISS,
+    /* All of the bytes, so the data is forwarded to the load */
+    HIT,
+    /* Only some of the bytes, so the load waits for the stores to drain */
+    PARTIAL,
+};
+
+/*
+ * Stores that execute retired but the memory did not write yet, oldest
+ * first. The buffer places them in order, one per cycle and only when no
+ * other request was placed in the data port in that cycle. Fetches do not
+ * look up the buffer
+ */
+class WriteBuffer
+{
+public:
+    WriteBuffer(Memory *memIn, Statistics *statsIn, uint32_t entriesIn);
+    ~WriteBuffer();
+
+    void push(uint32_t byteAddr, uint32_t data, uint32_t byteEnable);
+    WriteBufferLookup lookup(uint32_t byteAddr,
+                             uint32_t byteEnable,
+                             uint32_t &data);
+    bool overlaps(uint32_t baseByteAddr, uint32_t endByteAddr);
+
+    void retire();
+    int run();
+
+    bool isFull()
+    {
+        return count == entries;
+    }
+
+    uint32_t getEntries()
+    {
+        return entries;
+    }
+
+private:
+    WriteBufferEntry *getEntry(uint32_t index)
+    {
+        return &buffer[(head + index) % entries];
+    }
+
+    Memory *mem;
+    Statistics *stats;
+
+    WriteBufferEntry *buffer;
+    uint32_t entries;
+    uint32_t head{ 0 };
+    uint32_t count{ 0 };
+};
+
+#endif /* _WRITEBUFFER_H_ */
@@ -0,0 +1,220 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "simulator/accelerator.h"
+
+#include "simulator/stats.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+FetchAccelerator::FetchAccelerator(const FetchAcceleratorConfig &configIn,
+                                   uint32_t lineBytesIn,
+                                   Statistics *statsIn) :
+    config(configIn),
+    lineBytes(lineBytesIn),
+    stats(statsIn)
+{
+    uint32_t i;
+
+    buffers = config.lineBuffers + config.targetBuffers;
+
+    lineByteAddrs = new uint32_t[buffers];
+    valid = new bool[buffers];
+    prefetched = new bool[buffers];
+    readyCycles = new uint64_t[buffers];
+
+    for (i = 0; i < buffers; i++)
+    {
+        lineByteAddrs[i] = 0;
+        valid[i] = false;
+        prefetched[i] = false;
+        readyCycles[i] = 0;
+    }
+}
+
+FetchAccelerator::~FetchAccelerator()
+{
+    delete[] lineByteAddrs;
+    delete[] valid;
+    delete[] prefetched;
+    delete[] readyCycles;
+}
+
+/* Return the buffer that holds the line or buffers if none does */
+uint32_t FetchAccelerator::findBuffer(uint32_t lineByteAddr)
+{
+    uint32_t i;
+
+    for (i = 0; i < buffers; i++)
+    {
+        if (valid[i] && lineByteAddrs[i] == lineByteAddr)
+        {
+            return i;
+        }
+    }
+
+    return buffers;
+}
+
+void FetchAccelerator::fillBuffer(uint32_t buffer,
+                                  uint32_t lineByteAddr,
+                                  uint64_t readyCycle,
+                                  bool prefetchedIn)
+{
+    if (stats != nullptr && valid[buffer] && prefetched[buffer])
+    {
+        /* The prefetched line is replaced without being used */
+        stats->addFetchAccelWastedPrefetch();
+    }
+
+    lineByteAddrs[buffer] = lineByteAddr;
+    valid[buffer] = true;
+    prefetched[buffer] = prefetchedIn;
+    readyCycles[buffer] = readyCycle;
+}
+
+/*
+ * Look up a fetch of the line at lineByteAddr placed in cycle, where reading
+ * the line and the next one from memory takes readCycles and nextReadCycles.
+ * Return whether the line was buffered and the cycles until it is ready. Once
+ * the line is available the read of the next line starts, if it is not
+ * buffered already
+ */
+bool FetchAccelerator::access(uint32_t lineByteAddr,
+                              uint64_t cycle,
+                              uint32_t readCycles,
+                              uint32_t nextReadCycles,
+                              uint32_t &waitCycles)
+{
+    uint32_t buffer = findBuffer(lineByteAddr);
+    bool sequential = lineByteAddr == lastLineByteAddr ||
+        lineByteAddr == lastLineByteAddr + lineBytes;
+    bool hit = buffer < buffers;
+    uint64_t readyCycle;
+    uint32_t nextLineByteAddr = lineByteAddr + lineBytes;
+
+    lastLineByteAddr = lineByteAddr;
+
+    if (hit)
+    {
+        readyCycle = std::max(cycle, readyCycles[buffer]);
+        prefetched[buffer] = false;
+
+        if (stats != nullptr)
+        {
+            stats->addFetchAccelHit(buffer >= config.lineBuffers);
+        }
+    }
+    else
+    {
+        readyCycle = std::max(cycle, busyUntilCycle) + readCycles;
+        busyUntilCycle = readyCycle;
+
+        if (!sequential && config.targetBuffers > 0)
+        {
+            fillBuffer(config.lineBuffers + nextTargetBuffer,
+                       lineByteAddr,
+                       readyCycle,
+                       false);
+            nextTargetBuffer = (nextTargetBuffer + 1) % config.targetBuffers;
+        }
+        else
+        {
+            fillBuffer(nextLineBuffer, lineByteAddr, readyCycle, false);
+            nextLineBuffer = (nextLineBuffer + 1) % config.lineBuffers;
+        }
+
+        if (stats != nullptr)
+        {
+            stats->addFetchAccelMiss();
+        }
+    }
+
+    waitCycles = static_cast<uint32_t>(readyCycle - cycle);
+
+    if (config.prefetch && nextLineByteAddr != 0 &&
+        findBuffer(nextLineByteAddr) == buffers)
+    {
+        busyUntilCycle = std::max(readyCycle, busyUntilCycle) +
+            nextReadCycles;
+        fillBuffer(nextLineBuffer, nextLineByteAddr, busyUntilCycle, true);
+        nextLineBuffer = (nextLineBuffer + 1) % config.lineBuffers;
+
+        if (stats != nullptr)
+        {
+            stats->addFetchAccelPrefetch();
+        }
+    }
+
+    return hit;
+}
+
+/*
+ * Parse a configuration written as <lines>,<targets>[,noprefetch] with the
+ * number of sequential line buffers, of which there must be at least one,
+ * and of branch target buffers
+ */
+int FetchAccelerator::parseConfig(const char *str,
+                                  FetchAcceleratorConfig &config)
+{
+    unsigned int lineBuffers;
+    unsigned int targetBuffers;
+    char prefetch[16];
+    int fields;
+
+    fields = sscanf(str,
+                    "%u,%u,%15s",
+                    &lineBuffers,
+                    &targetBuffers,
+                    prefetch);
+    if (fields < 2 || lineBuffers == 0 ||
+        (fields == 3 && strcmp(prefetch, "noprefetch") != 0))
+    {
+        return -1;
+    }
+
+    config.lineBuffers = lineBuffers;
+    config.targetBuffers = targetBuffers;
+    config.prefetch = fields == 2;
+
+    return 0;
+}
+
+std::string FetchAccelerator::configToStr(const FetchAcceleratorConfig &config)
+{
+    char str[128];
+
+    snprintf(str,
+             sizeof(str),
+             "%" PRIu32 " line buffers, %" PRIu32 " branch target buffers%s",
+             config.lineBuffers,
+             config.targetBuffers,
+             config.prefetch ? ", prefetch" : "");
+
+    return std::string(str);
+}
@@ -27,121 +27,30 @@
 #include "simulator/fetch.h"
 #include "simulator/regfile.h"
 
-void Execute::calculateXpsrZ(uint32_t res)
-{
-    uint32_t xpsr = regFile->readData(Reg::XPSR);
-
-    /* Calculate Z flag */
-    xpsr = (res == 0) ? RegFile::setXpsrZ(xpsr, 0x1) :
-                        RegFile::setXpsrZ(xpsr, 0x0);
-
-    regFile->write(Reg::XPSR, xpsr);
-}
-
-void Execute::calculateXpsrN(uint32_t res, uint32_t bits)
+/*
+ * The flags are not computed here. The register file keeps the result and
+ * operands of the last flag setting operation and only works out N, Z, C and
+ * V when xPSR is read, as most flags are overwritten before they are used
+ */
+void Execute::calculateXpsrNZ(uint32_t res)
 {
-    if (bits > 32 || bits < 1)
-    {
-        fprintf(stderr,
-                "Cannot calculate XPSR flags for specified bit "
-                "width\n");
-        return;
-    }
-
-    uint32_t xpsr = regFile->readData(Reg::XPSR);
-
-    /* Calculate N flag */
-    xpsr = ((res >> (bits - 1)) == 0) ? RegFile::setXpsrN(xpsr, 0x0) :
-                                        RegFile::setXpsrN(xpsr, 0x1);
-
-    regFile->write(Reg::XPSR, xpsr);
+    regFile->setXpsrFlagsLazy(XpsrFlagsOp::NZ, res, 0, 0, 0);
 }
 
-void Execute::calculateXpsrQ()
+void Execute::calculateXpsrNZC(uint32_t res,
+                               uint32_t op0,
+                               uint32_t op1,
+                               uint32_t cflag)
 {
-    uint32_t xpsr = regFile->readData(Reg::XPSR);
-
-    /* Calculate Q flag */
-    xpsr = RegFile::setXpsrQ(xpsr, 0x0);
-
-    regFile->write(Reg::XPSR, xpsr);
-}
-
-void Execute::calculateXpsrC(uint32_t res,
-                             uint32_t op0,
-                             uint32_t op1,
-                             uint32_t cflag,
-                             uint32_t bits)
-{
-    uint32_t msb = bits - 1;
-    uint32_t mask = (bits < 32) ? (0x1 << bits) - 1 : ~0;
-    uint32_t mask_msb = mask & ~(0x1 << msb);
-    uint32_t tmp0;
-
-    uint32_t xpsr = regFile->readData(Reg::XPSR);
-
-    op0 &= mask;
-    op1 &= mask;
-    res &= mask;
-
-    /* Calculate C flag */
-    // Compute the carry out of the first (bits-1) bits
-    tmp0 = (op0 & mask_msb) + (op1 & mask_msb) + cflag;
-    // Compute the carry out of the full addition
-    tmp0 = (op0 >> msb) + (op1 >> msb) + (tmp0 >> msb);
-    xpsr = ((tmp0 & 0x2) != 0) ? RegFile::setXpsrC(xpsr, 0x1) :
-                                 RegFile::setXpsrC(xpsr, 0x0);
-
-    regFile->write(Reg::XPSR, xpsr);
+    regFile->setXpsrFlagsLazy(XpsrFlagsOp::NZC, res, op0, op1, cflag);
 }
 
 void Execute::calculateXpsrFlags(uint32_t res,
                                  uint32_t op0,
                                  uint32_t op1,
-                                 uint32_t cflag,
-                                 uint32_t bits)
+                                 uint32_t cflag)
 {
-    if (bits > 32 || bits < 1)
-    {
-        fprintf(stderr,
-                "Cannot calculate XPSR flags for specified bit "
-                "width\n");
-        return;
-    }
-
-    uint32_t msb = bits - 1;
-    uint32_t mask = (bits < 32) ? (0x1 << bits) - 1 : ~0;
-    uint32_t mask_msb = mask & ~(0x1 << msb);
-    uint32_t tmp0, tmp1;
-    uint32_t xpsr;
-
-    calculateXpsrZ(res);
-    calculateXpsrN(res, bits);
-    calculateXpsrQ();
-
-    xpsr = regFile->readData(Reg::XPSR);
-
-    op0 &= mask;
-    op1 &= mask;
-    res &= mask;
-
-    /* Calculate C flag */
-    // Compute the carry out of the first (bits-1) bits
-    tmp0 = (op0 & mask_msb) + (op1 & mask_msb) + cflag;
-    // Compute the carry out of the full addition
-    tmp0 = (op0 >> msb) + (op1 >> msb) + (tmp0 >> msb);
-    xpsr = ((tmp0 & 0x2) != 0) ? RegFile::setXpsrC(xpsr, 0x1) :
-                                 RegFile::setXpsrC(xpsr, 0x0);
-
-    /* Calculate V flag */
-    // Compute the carry out of the first (bits-1) bits
-    tmp0 = ((op0 & mask_msb) + (op1 & mask_msb) + cflag) >> msb;
-    // Compute the carry out of the full addition
-    tmp1 = (tmp0 + (op0 >> msb) + (op1 >> msb)) >> 1;
-    xpsr = (((tmp0 ^ tmp1) & 1) != 0) ? RegFile::setXpsrV(xpsr, 0x1) :
-                                        RegFile::setXpsrV(xpsr, 0x0);
-
-    regFile->write(Reg::XPSR, xpsr);
+    regFile->setXpsrFlagsLazy(XpsrFlagsOp::NZCV, res, op0, op1, cflag);
 }
 
 int Execute::adc(Reg rdn, uint32_t drdn, uint32_t drm, uint32_t cflag)
@@ -149,7 +58,7 @@ int Execute::adc(Reg rdn, uint32_t drdn, uint32_t drm, uint32_t cflag)
     uint32_t dres;
 
     dres = drdn + drm + cflag;
-    calculateXpsrFlags(dres, drdn, drm, cflag, BITS_PER_WORD);
+    calculateXpsrFlags(dres, drdn, drm, cflag);
 
     regFile->write(rdn, dres);
 
@@ -165,7 +74,7 @@ int Execute::add1(Reg rd, uint32_t drn, uint32_t im)
     uint32_t dres;
 
     dres = drn + im;
-    calculateXpsrFlags(dres, drn, im, 0, BITS_PER_WORD);
+    calculateXpsrFlags(dres, drn, im, 0);
 
     regFile->write(rd, dres);
 
@@ -181,7 +90,7 @@ int Execute::add2(Reg rdn, uint32_t drdn, uint32_t im)
     uint32_t dres;
 
     dres = drdn + im;
-    calculateXpsrFlags(dres, drdn, im, 0, BITS_PER_WORD);
+    calculateXpsrFlags(dres, drdn, im, 0);
 
     regFile->write(rdn, dres);
 
@@ -197,7 +106,7 @@ int Execute::add3(Reg rd, uint32_t drn, uint32_t drm)
     uint32_t dres;
 
     dres = drn + drm;
-    calculateXpsrFlags(dres, drn, drm, 0, BITS_PER_WORD);
+    calculateXpsrFlags(dres, drn, drm, 0);
 
     regFile->write(rd, dres);
 
@@ -214,8 +123,6 @@ int Execute::add4(Reg rdn, uint32_t drdn, uint32_t drm)
 
     dres = drdn + drm;
 
-    regFile->write(rdn, dres);
-
     if (rdn == Reg::PC)
     {
         /*
@@ -228,8 +135,8 @@ int Execute::add4(Reg rdn, uint32_t drdn, uint32_t drm)
             exit(1);
         }
 
-        /* Flush the pipeline */
-        flushPipeline();
+        /* Write the pc and flush the pipeline */
+        takeBranch(rdn, dres);
 
         /* This is the equivalent of an "always taken" branch */
         stats->addBranchTaken();
@@ -237,6 +144,8 @@ int Execute::add4(Reg rdn, uint32_t drdn, uint32_t drm)
     }
     else
     {
+        regFile->write(rdn, dres);
+
         /* Record the instruction stats */
         stats->addInstruction(Instruction::ADD);
     }
@@ -271,8 +180,7 @@ int Execute::and0(Reg rdn, uint32_t drdn, uint32_t drm)
     uint32_t dres;
 
     dres = drdn & drm;
-    calculateXpsrZ(dres);
-    calculateXpsrN(dres, BITS_PER_WORD);
+    calculateXpsrNZ(dres);
 
     regFile->write(rdn, dres);
 
@@ -317,8 +225,7 @@ int Execute::asr1(Reg rd, uint32_t drm, uint32_t im)
         regFile->write(Reg::XPSR, dxpsr);
     }
 
-    calculateXpsrN(dres, BITS_PER_WORD);
-    calculateXpsrZ(dres);
+    calculateXpsrNZ(dres);
 
     regFile->write(rd, dres);
 
@@ -371,8 +278,7 @@ int Execute::asr2(Reg rdn, uint32_t drdn, uint32_t drm)
 
     regFile->write(Reg::XPSR, dxpsr);
 
-    calculateXpsrN(dres, BITS_PER_WORD);
-    calculateXpsrZ(dres);
+    calculateXpsrNZ(dres);
 
     regFile->write(rdn, dres);
 
@@ -388,8 +294,7 @@ int Execute::bic(Reg rdn, uint32_t drdn, uint32_t drm)
     uint32_t dres;
 
     dres = drdn & ~drm;
-    calculateXpsrN(dres, BITS_PER_WORD);
-    calculateXpsrZ(dres);
+    calculateXpsrNZ(dres);
 
     regFile->write(rdn, dres);
 
@@ -405,7 +310,7 @@ int Execute::cmn(uint32_t drn, uint32_t drm)
     uint32_t dres;
 
     dres = drn + drm;
-    calculateXpsrFlags(dres, drn, drm, 0, BITS_PER_WORD);
+    calculateXpsrFlags(dres, drn, drm, 0);
 
     /* Record the instruction stats */
     stats->addInstruction(Instruction::CMN);
@@ -420,7 +325,7 @@ int Execute::cmp1(uint32_t drn, uint32_t im)
 
     dres = drn - im;
 
-    calculateXpsrFlags(dres, drn, ~im, 1, BITS_PER_WORD);
+    calculateXpsrFlags(dres, drn, ~im, 1);
 
     /* Record the instruction stats */
     stats->addInstruction(Instruction::CMP);
@@ -435,7 +340,7 @@ int Execute::cmp2Cmp3(uint32_t drn, uint32_t drm)
 
     dres = drn - drm;
 
-    calculateXpsrFlags(dres, drn, ~drm, 1, BITS_PER_WORD);
+    calculateXpsrFlags(dres, drn, ~drm, 1);
 
     /* Record the instruction stats */
     stats->addInstruction(Instruction::CMP);
@@ -478,8 +383,7 @@ int Execute::eor(Reg rdn, uint32_t drdn, uint32_t drm)
     uint32_t dres;
 
     dres = drdn ^ drm;
-    calculateXpsrZ(dres);
-    calculateXpsrN(dres, BITS_PER_WORD);
+    calculateXpsrNZ(dres);
 
     regFile->write(rdn, dres);
 
@@ -517,8 +421,7 @@ int Execute::lsl1(Reg rd, uint32_t drm, uint32_t im)
         dres = (im < BITS_PER_WORD) ? drm << im : drm;
     }
 
-    calculateXpsrZ(dres);
-    calculateXpsrN(dres, BITS_PER_WORD);
+    calculateXpsrNZ(dres);
 
     regFile->write(rd, dres);
 
@@ -564,8 +467,7 @@ int Execute::lsl2(Reg rdn, uint32_t drdn, uint32_t drm)
         dres = drdn << drm;
     }
 
-    calculateXpsrZ(dres);
-    calculateXpsrN(dres, BITS_PER_WORD);
+    calculateXpsrNZ(dres);
 
     regFile->write(rdn, dres);
 
@@ -603,8 +505,7 @@ int Execute::lsr1(Reg rd, uint32_t drm, uint32_t im)
         dres = drm >> im;
     }
 
-    calculateXpsrZ(dres);
-    calculateXpsrN(dres, BITS_PER_WORD);
+    calculateXpsrNZ(dres);
 
     regFile->write(rd, dres);
 
@@ -650,8 +551,7 @@ int Execute::lsr2(Reg rdn, uint32_t drdn, uint32_t drm)
         dres = drdn >> drm;
     }
 
-    calculateXpsrZ(dres);
-    calculateXpsrN(dres, BITS_PER_WORD);
+    calculateXpsrNZ(dres);
 
     regFile->write(rdn, dres);
 
@@ -665,8 +565,7 @@ int Execute::lsr2(Reg rdn, uint32_t drdn, uint32_t drm)
 int Execute::mov1(Reg rd, uint32_t im)
 {
     regFile->write(rd, im);
-    calculateXpsrN(im, BITS_PER_WORD);
-    calculateXpsrZ(im);
+    calculateXpsrNZ(im);
 
     /* Record the instruction stats */
     stats->addInstruction(Instruction::MOV);
@@ -677,8 +576,7 @@ int Execute::mov1(Reg rd, uint32_t im)
 
 int Execute::mov2(Reg rd, uint32_t drm)
 {
-    calculateXpsrN(drm, BITS_PER_WORD);
-    calculateXpsrZ(drm);
+    calculateXpsrNZ(drm);
 
     regFile->write(rd, drm);
 
@@ -695,8 +593,7 @@ int Execute::mul(Reg rdn, uint32_t drdn, uint32_t drn)
 
     dres = drdn * drn;
 
-    calculateXpsrN(dres, BITS_PER_WORD);
-    calculateXpsrZ(dres);
+    calculateXpsrNZ(dres);
 
     regFile->write(rdn, dres);
 
@@ -713,8 +610,7 @@ int Execute::mvn(Reg rd, uint32_t drm)
 
     dres = ~drm;
 
-    calculateXpsrN(dres, BITS_PER_WORD);
-    calculateXpsrZ(dres);
+    calculateXpsrNZ(dres);
 
     regFile->write(rd, dres);
 
@@ -730,8 +626,7 @@ int Execute::neg(Reg rd, uint32_t drn, uint32_t im)
     uint32_t dres;
 
     dres = im - drn;
-    calculateXpsrN(dres, BITS_PER_WORD);
-    calculateXpsrZ(dres);
+    calculateXpsrNZ(dres);
 
     regFile->write(rd, dres);
 
@@ -747,8 +642,7 @@ int Execute::orr(Reg rdn, uint32_t drdn, uint32_t drm)
     uint32_t dres;
 
     dres = drm | drdn;
-    calculateXpsrN(dres, BITS_PER_WORD);
-    calculateXpsrZ(dres);
+    calculateXpsrNZ(dres);
 
     regFile->write(rdn, dres);
 
@@ -839,8 +733,7 @@ int Execute::ror(Reg rdn, uint32_t drdn, uint32_t drm)
         }
         regFile->write(Reg::XPSR, dxpsr);
     }
-    calculateXpsrZ(dres);
-    calculateXpsrN(dres, BITS_PER_WORD);
+    calculateXpsrNZ(dres);
 
     regFile->write(rdn, dres);
 
@@ -857,9 +750,7 @@ int Execute::sbc(Reg rdn, uint32_t drdn, uint32_t drm, uint32_t cflag)
 
     cflag = (cflag == 0x0) ? 0x1 : 0x0;
     dres = drdn - drm - cflag;
-    calculateXpsrZ(dres);
-    calculateXpsrN(dres, BITS_PER_WORD);
-    calculateXpsrC(dres, drdn, ~drm, cflag, BITS_PER_WORD);
+    calculateXpsrNZC(dres, drdn, ~drm, cflag);
 
     regFile->write(rdn, dres);
 
@@ -875,7 +766,7 @@ int Execute::sub1(Reg rd, uint32_t drn, uint32_t im)
     uint32_t dres;
 
     dres = drn - im;
-    calculateXpsrFlags(dres, drn, ~im, 1, BITS_PER_WORD);
+    calculateXpsrFlags(dres, drn, ~im, 1);
 
     regFile->write(rd, dres);
 
@@ -891,7 +782,7 @@ int Execute::sub2(Reg rdn, uint32_t drdn, uint32_t im)
     uint32_t dres;
 
     dres = drdn - im;
-    calculateXpsrFlags(dres, drdn, ~im, 1, BITS_PER_WORD);
+    calculateXpsrFlags(dres, drdn, ~im, 1);
 
     regFile->write(rdn, dres);
 
@@ -907,7 +798,7 @@ int Execute::sub3(Reg rd, uint32_t drm, uint32_t drn)
     uint32_t dres;
 
     dres = drn - drm;
-    calculateXpsrFlags(dres, drn, ~drm, 1, BITS_PER_WORD);
+    calculateXpsrFlags(dres, drn, ~drm, 1);
 
     regFile->write(rd, dres);
 
@@ -941,8 +832,7 @@ int Execute::tst(uint32_t drm, uint32_t drn)
 
     dres = drm & drn;
 
-    calculateXpsrN(dres, BITS_PER_WORD);
-    calculateXpsrZ(dres);
+    calculateXpsrNZ(dres);
 
     /* Record the instruction stats */
     stats->addInstruction(Instruction::TST);
@@ -0,0 +1,283 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "simulator/aot.h"
+
+#include "simulator/config.h"
+#include "simulator/decode.h"
+#include "simulator/execute.h"
+#include "simulator/memory.h"
+#include "simulator/regfile.h"
+#include "simulator/stats.h"
+#include "simulator/utils.h"
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Runtime for programs translated ahead of time. The translator emits the
+ * basic blocks of a binary as C++ and this file provides the main function
+ * that loads the same binary, so that the data sections are in memory, and
+ * jumps from block to block. Branches to addresses computed at run time may
+ * land where there is no translated block, that code is run one instruction
+ * at a time in the functional model of the simulator instead
+ */
+
+static AotState state;
+
+/* Functional model for the code that was not translated */
+static RegFile fallbackRegFile;
+static Decode *fallbackDecode;
+static Execute *fallbackExecute;
+
+static const char *HELP_MSG =
+    "Thumb program translated ahead of time.\n"
+    "\n"
+    "USAGE: %s -b <file> [-m <val> | -h]\n"
+    "\n"
+    "  -m    Memory size (words). Default: %" PRIu32 "\n"
+    "  -b    Program binary file that was translated\n"
+    "  -h    Prints this help message\n"
+    "\n"
+    "Cycle counts are approximate, pipeline and memory are not modelled\n";
+
+/* Move the counters kept by the translated code into the statistics */
+static void aotPrintStats(AotState &s)
+{
+    std::size_t i;
+
+    s.stats->addCycles(s.cycles);
+    s.stats->addBranchesTaken(s.branchesTaken);
+    s.stats->addBranchesNotTaken(s.branchesNotTaken);
+    for (i = 0; i < s.instCount.size(); i++)
+    {
+        s.stats->addInstructions(static_cast<Instruction>(i),
+                                 s.instCount[i]);
+    }
+    for (i = 0; i < s.decodedOpCount.size(); i++)
+    {
+        s.stats->addDecodedOperations(static_cast<DecodedOperation>(i),
+                                      s.decodedOpCount[i]);
+    }
+
+    s.stats->print();
+}
+
+uint32_t aotMissingBlock(AotState &s, uint32_t pc)
+{
+    uint32_t nextPc = pc;
+    uint32_t word;
+    uint16_t halfword;
+    uint32_t i;
+    DecodedInst *decodedInst;
+    DecodedInst inst;
+
+    /* The decoder reads the operands, so the registers must be up to date */
+    for (i = 0; i < REGFILE_CORE_REGS_COUNT; i++)
+    {
+        fallbackRegFile.write(static_cast<Reg>(i), s.regs[i]);
+    }
+    fallbackRegFile.write(Reg::XPSR, s.xpsr);
+
+    do
+    {
+        s.mem->loadWord(nextPc, word);
+        halfword = static_cast<uint16_t>(
+            word >> (GET_BYTE_INDEX(nextPc) * BITS_PER_BYTE));
+        decodedInst = fallbackDecode->decodeFunctional(halfword, nextPc);
+        nextPc = NEXT_THUMB_INST(nextPc);
+    } while (decodedInst == nullptr);
+
+    /* Keep a copy, the decoded instruction is released once it runs */
+    inst = *decodedInst;
+
+    /* Stop the same way as the translated code would */
+    switch (inst.getOperation())
+    {
+        case DecodedOperation::BKPT:
+            aotCountOp(s, DecodedOperation::BKPT, 1);
+            return aotBkpt(s, inst.getImmediate());
+
+        case DecodedOperation::SVC:
+            aotCountOp(s, DecodedOperation::SVC, 1);
+            return aotSvc(s, inst.getImmediate());
+
+        default:
+            break;
+    }
+
+    /*
+     * The address of a store is not known here, so any store to the code
+     * that was translated is taken as a modification
+     */
+    s.mem->watchStores(0, aotCodeEndAddr);
+    fallbackRegFile.write(Reg::PC, nextPc);
+    fallbackExecute->executeFunctional(decodedInst);
+    if (s.mem->checkWatchedStore())
+    {
+        aotFail("Self-modifying code is not supported ahead of time");
+    }
+    s.mem->unwatchStores();
+
+    for (i = 0; i < REGFILE_CORE_REGS_COUNT; i++)
+    {
+        s.regs[i] = fallbackRegFile.readData(i);
+    }
+    s.xpsr = fallbackRegFile.readData(Reg::XPSR);
+
+    /* The instruction and branch statistics were recorded when it ran */
+    pc = s.regs[static_cast<uint32_t>(Reg::PC)];
+    s.cycles += aotGetCycles(inst) + aotGetBranchCycles(inst, pc != nextPc);
+
+    return pc;
+}
+
+uint32_t aotBkpt(AotState &s, uint32_t im)
+{
+    aotPrintStats(s);
+    printf("Hit breakpoint with value %" PRIu32 ". Terminating...\n", im);
+    exit(im);
+}
+
+uint32_t aotSvc(AotState &s, uint32_t im)
+{
+    (void)s;
+
+    fprintf(stderr, "Reached SVC (im %" PRIu32 ") instruction\n", im);
+    exit(im);
+}
+
+/* Repurpose this instruction for printing a character in register r0 */
+void aotCps(AotState &s, uint32_t data)
+{
+    (void)s;
+
+    putchar(static_cast<char>(data & 0xFF));
+    fflush(stdout);
+}
+
+void aotFail(const char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    char *bin = nullptr;
+    uint32_t memSizeWords = MEM_SIZE_WORDS;
+    uint32_t pc;
+    uint32_t programByteSize;
+    int converted;
+    int i;
+
+    /* Parse command line arguments */
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-h") == 0)
+        {
+            printf(HELP_MSG, argv[0], MEM_SIZE_WORDS);
+            return EXIT_SUCCESS;
+        }
+        else if (strcmp(argv[i], "-m") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -m requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            converted = atoi(argv[i]);
+            if (converted <= 0)
+            {
+                fprintf(stderr, "Invalid value %s for -m\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            memSizeWords = static_cast<uint32_t>(converted);
+        }
+        else if (strcmp(argv[i], "-b") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -b requires an argument\n");
+                return EXIT_FAILURE;
+            }
+            bin = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "Unrecognized option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (bin == nullptr)
+    {
+        fprintf(stderr, "Option -b is required\n");
+        return EXIT_FAILURE;
+    }
+
+    state.mem = new Memory(memSizeWords, 1);
+    state.stats = new Statistics();
+    fallbackDecode = new Decode(nullptr, &fallbackRegFile, state.stats);
+    fallbackExecute = new Execute(
+        nullptr, fallbackDecode, &fallbackRegFile, state.mem, state.stats);
+
+    if (state.mem->loadProgram(bin, pc, programByteSize) != 0)
+    {
+        fprintf(stderr, "Failed to load program binary in memory\n");
+        return EXIT_FAILURE;
+    }
+    else if ((pc & 1) == 0)
+    {
+        fprintf(stderr,
+                "Reset vector contains an ARM address 0x%08" PRIX32 "\n",
+                pc);
+        return EXIT_FAILURE;
+    }
+
+    state.stats->setProgramSizeBytes(programByteSize);
+    state.stats->setMemSizeWords(state.mem->getMemSizeWords());
+    state.stats->setMemAccessWidthWords(state.mem->getMemAccessWidthWords());
+    state.stats->setMemLatencyCycles(state.mem->getLatencyCycles());
+    state.stats->setMemMaxOutstanding(state.mem->getMaxOutstanding());
+
+    /* Load the stack pointer from the first entry in the vector table */
+    state.regs[static_cast<uint32_t>(Reg::MSP)] =
+        aotLoadWord(state, RESET_VECTOR_SP_ADDRESS);
+
+    /* The program only stops at a breakpoint or an error */
+    pc = pc & ~1;
+    for (;;)
+    {
+        pc = aotRunBlock(state, pc);
+    }
+}
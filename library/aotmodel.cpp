@@ -0,0 +1,317 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "simulator/aot.h"
+
+#include "simulator/decode.h"
+#include "simulator/regfile.h"
+#include "simulator/stats.h"
+#include "simulator/utils.h"
+
+#include <cstdint>
+
+/*
+ * Classification of the instructions and cycle costs shared by the
+ * translator, which sums them up for each block, and by the runtime, which
+ * charges them to the instructions that it runs in the functional model
+ */
+
+/* Whether the instruction may continue anywhere other than the next one */
+bool aotEndsBlock(DecodedInst &inst)
+{
+    switch (inst.getOperation())
+    {
+        case DecodedOperation::B1:
+        case DecodedOperation::B2:
+        case DecodedOperation::BL:
+        case DecodedOperation::BLX:
+        case DecodedOperation::BX:
+        case DecodedOperation::BKPT:
+        case DecodedOperation::SVC:
+            return true;
+
+        case DecodedOperation::POP:
+            return GET_BIT_AT_POS(inst.getRegisterList(),
+                                  static_cast<uint32_t>(Reg::PC)) != 0;
+
+        case DecodedOperation::ADD4:
+            return inst.getRegisterNumber(DecodedInstRegIndex::RDN) ==
+                Reg::PC;
+
+        case DecodedOperation::CPY:
+            return inst.getRegisterNumber(DecodedInstRegIndex::RD) ==
+                Reg::PC;
+
+        default:
+            return false;
+    }
+}
+
+/* The instruction recorded in the statistics, COUNT if there is none */
+Instruction aotGetInstruction(DecodedInst &inst)
+{
+    switch (inst.getOperation())
+    {
+        case DecodedOperation::ADC:
+            return Instruction::ADC;
+
+        case DecodedOperation::ADD4:
+            if (aotEndsBlock(inst))
+            {
+                return Instruction::B;
+            }
+            return Instruction::ADD;
+
+        case DecodedOperation::ADD1:
+        case DecodedOperation::ADD2:
+        case DecodedOperation::ADD3:
+        case DecodedOperation::ADD5:
+        case DecodedOperation::ADD6:
+        case DecodedOperation::ADD7:
+            return Instruction::ADD;
+
+        case DecodedOperation::AND:
+            return Instruction::AND;
+
+        case DecodedOperation::ASR1:
+        case DecodedOperation::ASR2:
+            return Instruction::ASR;
+
+        case DecodedOperation::B1:
+        case DecodedOperation::B2:
+            return Instruction::B;
+
+        case DecodedOperation::BIC:
+            return Instruction::BIC;
+
+        case DecodedOperation::BL:
+            return Instruction::BL;
+
+        case DecodedOperation::BLX:
+            return Instruction::BLX;
+
+        case DecodedOperation::BX:
+            return Instruction::BX;
+
+        case DecodedOperation::CMN:
+            return Instruction::CMN;
+
+        case DecodedOperation::CMP1:
+        case DecodedOperation::CMP2:
+        case DecodedOperation::CMP3:
+            return Instruction::CMP;
+
+        case DecodedOperation::CPY:
+            if (aotEndsBlock(inst))
+            {
+                return Instruction::BX;
+            }
+            return Instruction::MOV;
+
+        case DecodedOperation::EOR:
+            return Instruction::EOR;
+
+        case DecodedOperation::LDMIA:
+        case DecodedOperation::POP:
+            return Instruction::LDMIA;
+
+        case DecodedOperation::LDR1:
+        case DecodedOperation::LDR2:
+        case DecodedOperation::LDR3:
+        case DecodedOperation::LDR4:
+            return Instruction::LDR;
+
+        case DecodedOperation::LDRB1:
+        case DecodedOperation::LDRB2:
+            return Instruction::LDRB;
+
+        case DecodedOperation::LDRH1:
+        case DecodedOperation::LDRH2:
+            return Instruction::LDRH;
+
+        case DecodedOperation::LDRSB:
+            return Instruction::LDRSB;
+
+        case DecodedOperation::LDRSH:
+            return Instruction::LDRSH;
+
+        case DecodedOperation::LSL1:
+        case DecodedOperation::LSL2:
+            return Instruction::LSL;
+
+        case DecodedOperation::LSR1:
+        case DecodedOperation::LSR2:
+            return Instruction::LSR;
+
+        case DecodedOperation::MOV1:
+        case DecodedOperation::MOV2:
+            return Instruction::MOV;
+
+        case DecodedOperation::MUL:
+            return Instruction::MUL;
+
+        case DecodedOperation::MVN:
+            return Instruction::MVN;
+
+        case DecodedOperation::NEG:
+            return Instruction::NEG;
+
+        case DecodedOperation::NOP:
+            return Instruction::NOP;
+
+        case DecodedOperation::ORR:
+            return Instruction::ORR;
+
+        case DecodedOperation::PUSH:
+            return Instruction::PUSH;
+
+        case DecodedOperation::REV:
+            return Instruction::REV;
+
+        case DecodedOperation::REV16:
+            return Instruction::REV16;
+
+        case DecodedOperation::REVSH:
+            return Instruction::REVSH;
+
+        case DecodedOperation::ROR:
+            return Instruction::ROR;
+
+        case DecodedOperation::SBC:
+            return Instruction::SBC;
+
+        case DecodedOperation::STMIA:
+            return Instruction::STMIA;
+
+        case DecodedOperation::STR1:
+        case DecodedOperation::STR2:
+        case DecodedOperation::STR3:
+            return Instruction::STR;
+
+        case DecodedOperation::STRB1:
+        case DecodedOperation::STRB2:
+            return Instruction::STRB;
+
+        case DecodedOperation::STRH1:
+        case DecodedOperation::STRH2:
+            return Instruction::STRH;
+
+        case DecodedOperation::SUB1:
+        case DecodedOperation::SUB2:
+        case DecodedOperation::SUB3:
+        case DecodedOperation::SUB4:
+            return Instruction::SUB;
+
+        case DecodedOperation::SXTB:
+            return Instruction::SXTB;
+
+        case DecodedOperation::SXTH:
+            return Instruction::SXTH;
+
+        case DecodedOperation::TST:
+            return Instruction::TST;
+
+        case DecodedOperation::UXTB:
+            return Instruction::UXTB;
+
+        case DecodedOperation::UXTH:
+            return Instruction::UXTH;
+
+        default:
+            return Instruction::COUNT;
+    }
+}
+
+/*
+ * Cycles of the instruction that do not depend on the execution. Branches
+ * are charged when they run, as the cost depends on whether they are taken
+ */
+uint32_t aotGetCycles(DecodedInst &inst)
+{
+    uint32_t regs = COUNT_SET_BITS(inst.getRegisterList() &
+                                   ((0x1 << REGFILE_CORE_REGS_COUNT) - 1));
+
+    switch (aotGetInstruction(inst))
+    {
+        case Instruction::B:
+        case Instruction::BL:
+        case Instruction::BLX:
+        case Instruction::BX:
+        case Instruction::COUNT:
+            return 0;
+
+        case Instruction::LDMIA:
+            if (aotEndsBlock(inst))
+            {
+                return AOT_CYCLES_POP_PC + regs;
+            }
+            return AOT_CYCLES_MULTIPLE + regs;
+
+        case Instruction::STMIA:
+        case Instruction::PUSH:
+            return AOT_CYCLES_MULTIPLE + regs;
+
+        case Instruction::LDR:
+        case Instruction::LDRB:
+        case Instruction::LDRH:
+        case Instruction::LDRSB:
+        case Instruction::LDRSH:
+        case Instruction::STR:
+        case Instruction::STRB:
+        case Instruction::STRH:
+            return AOT_CYCLES_LOAD_STORE;
+
+        default:
+            return AOT_CYCLES_DATA_PROCESSING;
+    }
+}
+
+/* Cycles of a branch once it is known whether it was taken */
+uint32_t aotGetBranchCycles(DecodedInst &inst, bool taken)
+{
+    if (!aotEndsBlock(inst))
+    {
+        return 0;
+    }
+
+    switch (inst.getOperation())
+    {
+        case DecodedOperation::B1:
+            return taken ? AOT_CYCLES_BRANCH_TAKEN :
+                           AOT_CYCLES_BRANCH_NOT_TAKEN;
+
+        case DecodedOperation::BL:
+            return AOT_CYCLES_BL;
+
+        case DecodedOperation::B2:
+        case DecodedOperation::BLX:
+        case DecodedOperation::BX:
+        case DecodedOperation::ADD4:
+        case DecodedOperation::CPY:
+            return AOT_CYCLES_BRANCH_TAKEN;
+
+        default:
+            /* A pop into the pc is charged with the rest of the pop */
+            return 0;
+    }
+}
@@ -0,0 +1,113 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "simulator/blockcache.h"
+
+#include "simulator/config.h"
+#include "simulator/decode.h"
+
+#include <cstddef>
+#include <cstdint>
+
+BlockCache::BlockCache()
+{
+    blocks = new PredecodedBlock[BLOCK_CACHE_ENTRIES];
+}
+
+BlockCache::~BlockCache()
+{
+    delete[] blocks;
+}
+
+PredecodedBlock *BlockCache::lookup(uint32_t startAddr)
+{
+    PredecodedBlock *block;
+
+    block = &blocks[(startAddr >> 1) & (BLOCK_CACHE_ENTRIES - 1)];
+    if (!block->valid || block->startAddr != startAddr)
+    {
+        return nullptr;
+    }
+
+    return block;
+}
+
+/*
+ * Count an execution of the block starting at a branch target. Returns the
+ * entry of the block when it needs to be predecoded and nullptr otherwise
+ */
+PredecodedBlock *BlockCache::recordBranchTarget(uint32_t startAddr)
+{
+    PredecodedBlock *block;
+
+    block = &blocks[(startAddr >> 1) & (BLOCK_CACHE_ENTRIES - 1)];
+    if (block->startAddr != startAddr)
+    {
+        /* Evict whatever was in the entry */
+        block->valid = false;
+        block->startAddr = startAddr;
+        block->hits = 0;
+    }
+
+    block->hits++;
+    if (block->valid || block->hits < BLOCK_CACHE_HOT_THRESHOLD)
+    {
+        return nullptr;
+    }
+
+    return block;
+}
+
+void BlockCache::invalidate()
+{
+    size_t i;
+
+    for (i = 0; i < BLOCK_CACHE_ENTRIES; i++)
+    {
+        blocks[i].valid = false;
+        blocks[i].hits = 0;
+    }
+}
+
+/*
+ * Operations that normally change the flow of the program. Other
+ * instructions that write the pc are caught when the block runs
+ */
+bool BlockCache::endsBlock(DecodedOperation op)
+{
+    switch (op)
+    {
+        case DecodedOperation::B1:
+        case DecodedOperation::B2:
+        case DecodedOperation::BL:
+        case DecodedOperation::BLX:
+        case DecodedOperation::BX:
+        case DecodedOperation::POP:
+        case DecodedOperation::SVC:
+        case DecodedOperation::BKPT:
+            return true;
+
+        default:
+            return false;
+    }
+}
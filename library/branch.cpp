@@ -25,6 +25,7 @@
 
 #include "simulator/debug.h"
 #include "simulator/memory.h"
+#include "simulator/predictor.h"
 #include "simulator/regfile.h"
 
 bool Execute::checkCondition(DecodedCondition cond, uint32_t xpsr)
@@ -84,6 +85,81 @@ bool Execute::checkCondition(DecodedCondition cond, uint32_t xpsr)
     }
 }
 
+/*
+ * Write the target of a taken branch into the pc and flush the pipeline,
+ * unless fetch predicted the branch and already continued from the target
+ */
+void Execute::takeBranch(Reg pcReg, uint32_t target)
+{
+    if (isFetchPredicting())
+    {
+        resolveBranch(true, target);
+        if (target == predictionTmps.predictedAddr)
+        {
+            return;
+        }
+    }
+
+    regFile->write(pcReg, target);
+    flushPipeline();
+}
+
+/* A conditional branch was not taken, which fetch may have mispredicted */
+void Execute::skipBranch()
+{
+    if (!isFetchPredicting())
+    {
+        return;
+    }
+
+    resolveBranch(false, predictionTmps.fallThroughAddr);
+    if (predictionTmps.predictedAddr != predictionTmps.fallThroughAddr)
+    {
+        /* Fetch went to the target, so go back to the next instruction */
+        regFile->write(Reg::PC, predictionTmps.fallThroughAddr);
+        flushPipeline();
+    }
+}
+
+/* Train the predictor and check where fetch went after the branch */
+void Execute::resolveBranch(bool taken, uint32_t nextAddr)
+{
+    bool correct = nextAddr == predictionTmps.predictedAddr;
+
+    predictionTmps.resolved = true;
+
+    if (predictor == nullptr)
+    {
+        /* Only the loop buffer redirects fetch */
+        return;
+    }
+
+    predictor->update(PREV_THUMB_INST(predictionTmps.fallThroughAddr),
+                      decodedInst->getOperation() == DecodedOperation::B1,
+                      taken,
+                      nextAddr);
+
+    stats->addBranchPrediction(correct);
+    if (correct && taken)
+    {
+        /* Without the prediction fetch would only go there now */
+        stats->addBranchPredictorSavedCycles(
+            fetch->getCycle() - predictionTmps.predictedCycle);
+    }
+}
+
+/* A backward branch that is taken may close a loop for the loop buffer */
+void Execute::recordLoop(uint32_t target)
+{
+    if (loopBuffer == nullptr || functional)
+    {
+        return;
+    }
+
+    loopBuffer->recordLoop(PREV_THUMB_INST(decodedInst->getFallThroughAddr()),
+                           target);
+}
+
 int Execute::b1(Reg rm,
                 uint32_t drm,
                 uint32_t im,
@@ -96,6 +172,8 @@ int Execute::b1(Reg rm,
     {
         /* Condition failed */
         stats->addBranchNotTaken();
+
+        skipBranch();
     }
     else
     {
@@ -108,11 +186,10 @@ int Execute::b1(Reg rm,
             im | (static_cast<uint32_t>(~0) << 7);
         dres = (im << 1) + drm;
 
-        /* Write the pc */
-        regFile->write(rm, dres);
+        recordLoop(dres);
 
-        /* Flush the pipeline */
-        flushPipeline();
+        /* Write the pc and flush the pipeline */
+        takeBranch(rm, dres);
     }
 
     /* Record the instruction stats */
@@ -132,11 +209,10 @@ int Execute::b2(Reg rm, uint32_t drm, uint32_t im)
         im | (static_cast<uint32_t>(~0) << 10);
     dres = (im << 1) + drm;
 
-    /* Write the pc */
-    regFile->write(rm, dres);
+    recordLoop(dres);
 
-    /* Flush the pipeline */
-    flushPipeline();
+    /* Write the pc and flush the pipeline */
+    takeBranch(rm, dres);
 
     stats->addBranchTaken();
 
@@ -166,10 +242,9 @@ int Execute::bl(Reg rdn, uint32_t drdn, uint32_t im)
     dres = im + drdn;
 
     regFile->write(Reg::LR, drdn | 0x1);
-    regFile->write(rdn, dres);
 
-    /* Flush the pipeline */
-    flushPipeline();
+    /* Write the pc and flush the pipeline */
+    takeBranch(rdn, dres);
 
     /* Record the instruction stats */
     stats->addInstruction(Instruction::BL);
@@ -189,10 +264,8 @@ int Execute::blx(Reg rdn, uint32_t drdn, uint32_t drm)
     }
 
     /* Write the target address into rdn/pc and store the previous pc in lr */
-    regFile->write(rdn, drm & ~0x1);
     regFile->write(Reg::LR, PREV_THUMB_INST(drdn) | 0x1);
-
-    flushPipeline();
+    takeBranch(rdn, drm & ~0x1);
 
     /* Record the instruction stats */
     stats->addInstruction(Instruction::BLX);
@@ -210,9 +283,7 @@ int Execute::bx(Reg rdn, uint32_t drm)
         exit(1);
     }
 
-    regFile->write(rdn, drm & ~0x1);
-
-    flushPipeline();
+    takeBranch(rdn, drm & ~0x1);
 
     /* Record the instruction stats */
     stats->addInstruction(Instruction::BX);
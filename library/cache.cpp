@@ -0,0 +1,245 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "simulator/cache.h"
+
+#include "simulator/utils.h"
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static bool isPowerOfTwo(uint32_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+Cache::Cache(const CacheConfig &configIn) : config(configIn)
+{
+    uint32_t lines = config.sizeBytes / config.lineBytes;
+    uint32_t i;
+
+    setMask = lines / config.ways - 1;
+    for (lineShift = 0; (1U << lineShift) < config.lineBytes; lineShift++)
+    {
+    }
+
+    tags = new uint32_t[lines];
+    valid = new bool[lines];
+    dirty = new bool[lines];
+    stamps = new uint64_t[lines];
+
+    for (i = 0; i < lines; i++)
+    {
+        tags[i] = 0;
+        valid[i] = false;
+        dirty[i] = false;
+        stamps[i] = 0;
+    }
+}
+
+Cache::~Cache()
+{
+    delete[] tags;
+    delete[] valid;
+    delete[] dirty;
+    delete[] stamps;
+}
+
+/*
+ * Look up the line of byteAddr and fill it on a miss. Write-through caches
+ * do not fill lines on store misses, as the store goes to the memory anyway
+ */
+CacheAccessResult Cache::access(uint32_t byteAddr,
+                                bool write,
+                                uint32_t &evictedByteAddr)
+{
+    uint32_t tag = byteAddr >> lineShift;
+    uint32_t firstLine = (tag & setMask) * config.ways;
+    uint32_t line;
+    CacheAccessResult result;
+
+    clock++;
+
+    for (line = firstLine; line < firstLine + config.ways; line++)
+    {
+        if (valid[line] && tags[line] == tag)
+        {
+            if (config.replacement == CacheReplacement::LRU)
+            {
+                stamps[line] = clock;
+            }
+            dirty[line] = dirty[line] || (write && config.writeBack);
+            return CacheAccessResult::HIT;
+        }
+    }
+
+    if (write && !config.writeBack)
+    {
+        return CacheAccessResult::MISS;
+    }
+
+    line = chooseVictim(firstLine);
+    if (!valid[line])
+    {
+        result = CacheAccessResult::MISS;
+    }
+    else if (dirty[line])
+    {
+        result = CacheAccessResult::WRITE_BACK;
+    }
+    else
+    {
+        result = CacheAccessResult::EVICTION;
+    }
+    evictedByteAddr = tags[line] << lineShift;
+
+    tags[line] = tag;
+    valid[line] = true;
+    dirty[line] = write;
+    stamps[line] = clock;
+
+    return result;
+}
+
+/* Free lines are taken first, otherwise the policy picks one of the set */
+uint32_t Cache::chooseVictim(uint32_t firstLine)
+{
+    uint32_t victim = firstLine;
+    uint32_t line;
+
+    for (line = firstLine; line < firstLine + config.ways; line++)
+    {
+        if (!valid[line])
+        {
+            return line;
+        }
+        else if (stamps[line] < stamps[victim])
+        {
+            victim = line;
+        }
+    }
+
+    if (config.replacement == CacheReplacement::RANDOM)
+    {
+        /* Deterministic xorshift, so runs can be reproduced */
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        victim = firstLine + randomState % config.ways;
+    }
+
+    return victim;
+}
+
+/*
+ * Parse a configuration written as <size>,<line>,<ways>,<policy>[,<write>]
+ * where the sizes are in bytes, the policy is lru, fifo or random and the
+ * write policy is wb (the default) or wt
+ */
+int Cache::parseConfig(const char *str, CacheConfig &config)
+{
+    unsigned int sizeBytes;
+    unsigned int lineBytes;
+    unsigned int ways;
+    char replacement[8];
+    char write[4];
+    int fields;
+
+    write[0] = '\0';
+    fields = sscanf(str,
+                    "%u,%u,%u,%7[a-z],%3s",
+                    &sizeBytes,
+                    &lineBytes,
+                    &ways,
+                    replacement,
+                    write);
+    if (fields < 4)
+    {
+        return -1;
+    }
+
+    config.sizeBytes = sizeBytes;
+    config.lineBytes = lineBytes;
+    config.ways = ways;
+
+    if (strcmp(replacement, "lru") == 0)
+    {
+        config.replacement = CacheReplacement::LRU;
+    }
+    else if (strcmp(replacement, "fifo") == 0)
+    {
+        config.replacement = CacheReplacement::FIFO;
+    }
+    else if (strcmp(replacement, "random") == 0)
+    {
+        config.replacement = CacheReplacement::RANDOM;
+    }
+    else
+    {
+        return -1;
+    }
+
+    if (fields == 4 || strcmp(write, "wb") == 0)
+    {
+        config.writeBack = true;
+    }
+    else if (strcmp(write, "wt") == 0)
+    {
+        config.writeBack = false;
+    }
+    else
+    {
+        return -1;
+    }
+
+    /* Lines hold whole words and the number of sets is a power of 2 */
+    if (!isPowerOfTwo(lineBytes) || lineBytes < BYTES_PER_WORD ||
+        ways == 0 || sizeBytes % (lineBytes * ways) != 0 ||
+        !isPowerOfTwo(sizeBytes / (lineBytes * ways)))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+std::string Cache::configToStr(const CacheConfig &config)
+{
+    static const char *replacementStr[] = { "lru", "fifo", "random" };
+    char str[128];
+
+    snprintf(str,
+             sizeof(str),
+             "%" PRIu32 " bytes (%" PRIu32 " byte lines, %" PRIu32
+             " ways, %s, %s)",
+             config.sizeBytes,
+             config.lineBytes,
+             config.ways,
+             replacementStr[static_cast<int>(config.replacement)],
+             config.writeBack ? "write-back" : "write-through");
+
+    return std::string(str);
+}
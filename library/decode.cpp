@@ -24,6 +24,7 @@
 #include "simulator/decode.h"
 
 #include "simulator/debug.h"
+#include "simulator/stats.h"
 #include "simulator/utils.h"
 
 #include <cinttypes>
@@ -32,17 +33,64 @@
 #include <cstdlib>
 #include <string>
 
-Decode::Decode(Fetch *fetchInit, RegFile *regFileInit) :
+Decode::Decode(Fetch *fetchInit,
+               RegFile *regFileInit,
+               Statistics *statsInit) :
+    instPool(statsInit),
     fetch(fetchInit),
-    regFile(regFileInit)
+    regFile(regFileInit),
+    stats(statsInit)
 {
+    decodeTable = new DecodeTableEntry[DECODE_TABLE_ENTRIES];
+    decodeCache = new DecodeCacheEntry[DECODE_CACHE_ENTRIES];
+
+    buildDecodeTable();
+}
+
+Decode::~Decode()
+{
+    delete[] decodeTable;
+    delete[] decodeCache;
+}
+
+DecodedInstPool::DecodedInstPool(Statistics *statsIn) : stats(statsIn)
+{
+}
+
+DecodedInst *DecodedInstPool::allocate()
+{
+    size_t i;
+
+    for (i = 0; i < DECODED_INST_POOL_SIZE; i++)
+    {
+        if (!slotUsed[i])
+        {
+            slotUsed[i] = true;
+            slots[i] = DecodedInst();
+            return &slots[i];
+        }
+    }
+
+    stats->addDecodedInstAllocation();
+
+    return new DecodedInst();
+}
+
+void DecodedInstPool::release(DecodedInst *inst)
+{
+    if (inst >= &slots[0] && inst < &slots[DECODED_INST_POOL_SIZE])
+    {
+        slotUsed[inst - &slots[0]] = false;
+    }
+    else
+    {
+        delete inst;
+    }
 }
 
-uint32_t Decode::getCorrectedFetchAddress()
+void Decode::releaseInst(DecodedInst *inst)
 {
-    uint32_t pc;
-    regFile->read(Reg::PC, pc);
-    return NEXT_THUMB_INST(pc);
+    instPool.release(inst);
 }
 
 void Decode::flush()
@@ -93,6 +141,105 @@ void Decode::updateDecodedInstRegs()
     updateDecodedInstReg(DecodedInstRegIndex::XPSR);
 }
 
+/* Reload an operand, the PC is relative to the instruction address */
+void Decode::reloadInstOperand(DecodedInst *inst,
+                               DecodedInstRegIndex regIndex,
+                               Reg reg,
+                               uint32_t pc)
+{
+    if (reg == Reg::PC)
+    {
+        inst->setRegister(regIndex, reg, pc);
+    }
+    else if (reg != Reg::RNONE)
+    {
+        if (reg == Reg::MSP || reg == Reg::PSP)
+        {
+            reg = regFile->getActiveSp();
+        }
+        inst->setRegister(regIndex, reg, regFile->readData(reg));
+    }
+}
+
+void Decode::reloadInstOperands(DecodedInst *inst, uint32_t pc)
+{
+    size_t i;
+    DecodedInstRegIndex regIndex;
+
+    for (i = 0; i < static_cast<size_t>(DecodedInstRegIndex::RCOUNT); i++)
+    {
+        regIndex = static_cast<DecodedInstRegIndex>(i);
+        reloadInstOperand(
+            inst, regIndex, inst->getRegisterNumber(regIndex), pc);
+    }
+}
+
+/*
+ * The decoder is a long chain of comparisons, so instructions that are
+ * executed repeatedly are kept in a direct-mapped cache indexed by their
+ * address. The cached halfword is compared on lookup, so a store that
+ * modifies the code simply causes a miss and the entry is refilled
+ */
+bool Decode::lookupDecodeCache(uint16_t inst, uint32_t instAddr, uint32_t pc)
+{
+    DecodeCacheEntry *entry;
+    uint32_t i;
+
+    entry = &decodeCache[(instAddr >> 1) & (DECODE_CACHE_ENTRIES - 1)];
+    if (!entry->valid || entry->addr != instAddr || entry->inst != inst)
+    {
+        stats->addDecodeCacheMiss();
+        return false;
+    }
+
+    /* The instruction comes fresh from the pool, so only set what is used */
+    decodedInst->setOperation(entry->op);
+    decodedInst->setImmediate(entry->im);
+    decodedInst->setRegisterList(entry->regList);
+    decodedInst->setCondition(entry->cond);
+    for (i = 0; i < entry->regCount; i++)
+    {
+        reloadInstOperand(
+            decodedInst, entry->regIndexes[i], entry->regs[i], pc);
+    }
+    decodedHalfInst = entry->halfInst;
+
+    stats->addDecodeCacheHit();
+
+    return true;
+}
+
+void Decode::fillDecodeCache(uint16_t inst, uint32_t instAddr)
+{
+    DecodeCacheEntry *entry;
+    uint32_t usedRegs = decodedInst->getUsedRegisters();
+    uint32_t i;
+    DecodedInstRegIndex regIndex;
+
+    entry = &decodeCache[(instAddr >> 1) & (DECODE_CACHE_ENTRIES - 1)];
+    entry->valid = true;
+    entry->halfInst = decodedHalfInst;
+    entry->inst = inst;
+    entry->addr = instAddr;
+    entry->op = decodedInst->getOperation();
+    entry->cond = decodedInst->getCondition();
+    entry->im = decodedInst->getImmediate();
+    entry->regList = decodedInst->getRegisterList();
+
+    entry->regCount = 0;
+    for (i = 0; i < static_cast<uint32_t>(DecodedInstRegIndex::RCOUNT); i++)
+    {
+        if (GET_BIT_AT_POS(usedRegs, i))
+        {
+            regIndex = static_cast<DecodedInstRegIndex>(i);
+            entry->regIndexes[entry->regCount] = regIndex;
+            entry->regs[entry->regCount] =
+                decodedInst->getRegisterNumber(regIndex);
+            entry->regCount++;
+        }
+    }
+}
+
 /*
  * When the decode stage runs ahead of the execution, it is possible that a
  * value that does not correspond to an instruction is fetched. The decode
@@ -107,46 +254,535 @@ void Decode::issuePlaceholderInst()
     decodedInst->setImmediate(66);
 }
 
-int Decode::run()
+struct DecodePattern
+{
+    uint16_t mask;
+    uint16_t value;
+    DecodedOperation op;
+    DecodedInstFormat format;
+};
+
+#define DECODE_PATTERN(mask, value, op, format) \
+    { mask, value, DecodedOperation::op, DecodedInstFormat::format }
+
+/*
+ * Encodings in the same order as the comparisons in decodeInstChain(), so
+ * the first pattern that matches a halfword gives its operation. The
+ * unpredictable cases that the chain rejects after matching an encoding come
+ * first as they are special cases of the patterns below
+ */
+static const DecodePattern decodePatterns[] = {
+    /* ADD4 with rdn == rm == pc */
+    DECODE_PATTERN(0xFFFF, 0x44FF, SVC, PLACEHOLDER),
+    /* B1 with condition U0 is undefined and U1 is SVC */
+    DECODE_PATTERN(0xFF00, 0xDE00, SVC, PLACEHOLDER),
+    DECODE_PATTERN(0xFF00, 0xDF00, SVC, IM8),
+    /* BLX with pc as operand register */
+    DECODE_PATTERN(0xFFFF, 0x47F8, SVC, PLACEHOLDER),
+    /* CMP3 with two low registers or a pc operand */
+    DECODE_PATTERN(0xFFC0, 0x4500, SVC, PLACEHOLDER),
+    DECODE_PATTERN(0xFF87, 0x4587, SVC, PLACEHOLDER),
+    DECODE_PATTERN(0xFF78, 0x4578, SVC, PLACEHOLDER),
+    /* LDMIA, POP, PUSH and STMIA with 0 length register list */
+    DECODE_PATTERN(0xF8FF, 0xC800, SVC, PLACEHOLDER),
+    DECODE_PATTERN(0xFFFF, 0xBC00, SVC, PLACEHOLDER),
+    DECODE_PATTERN(0xFFFF, 0xB400, SVC, PLACEHOLDER),
+    DECODE_PATTERN(0xF8FF, 0xC000, SVC, PLACEHOLDER),
+
+    DECODE_PATTERN(0xFFC0, 0x4140, ADC, RDN_RM_XPSR),
+    DECODE_PATTERN(0xFE00, 0x1C00, ADD1, RD_RN_IM3),
+    DECODE_PATTERN(0xF800, 0x3000, ADD2, RDN_IM8),
+    DECODE_PATTERN(0xFE00, 0x1800, ADD3, RD_RN_RM),
+    DECODE_PATTERN(0xFF00, 0x4400, ADD4, RDN_RM_HI),
+    DECODE_PATTERN(0xF800, 0xA000, ADD5, RD_PC_IM8),
+    DECODE_PATTERN(0xF800, 0xA800, ADD6, RD_SP_IM8),
+    DECODE_PATTERN(0xFF80, 0xB000, ADD7, SP_SP_IM7),
+    DECODE_PATTERN(0xFFC0, 0x4000, AND, RDN_RM),
+    DECODE_PATTERN(0xF800, 0x1000, ASR1, RD_RM_IM5),
+    DECODE_PATTERN(0xFFC0, 0x4100, ASR2, RDN_RM),
+    DECODE_PATTERN(0xF000, 0xD000, B1, COND_IM8),
+    DECODE_PATTERN(0xF800, 0xE000, B2, IM11),
+    DECODE_PATTERN(0xFFC0, 0x4380, BIC, RDN_RM),
+    DECODE_PATTERN(0xFF00, 0xBE00, BKPT, IM8),
+    DECODE_PATTERN(0xF800, 0xF000, BL, BL_PREFIX),
+    DECODE_PATTERN(0xFF87, 0x4780, BLX, PC_RM_HI),
+    DECODE_PATTERN(0xFF87, 0x4700, BX, PC_RM_HI),
+    DECODE_PATTERN(0xFFC0, 0x42C0, CMN, RN_RM),
+    DECODE_PATTERN(0xF800, 0x2800, CMP1, RN_IM8),
+    DECODE_PATTERN(0xFFC0, 0x4280, CMP2, RN_RM),
+    DECODE_PATTERN(0xFF00, 0x4500, CMP3, RN_RM_HI),
+    DECODE_PATTERN(0xFFEC, 0xB660, CPS, R0),
+    DECODE_PATTERN(0xFF00, 0x4600, CPY, RD_RM_HI),
+    DECODE_PATTERN(0xFFC0, 0x4040, EOR, RDN_RM),
+    DECODE_PATTERN(0xF800, 0xC800, LDMIA, RN_LIST),
+    DECODE_PATTERN(0xF800, 0x6800, LDR1, LD_RT_RN_IM5),
+    DECODE_PATTERN(0xFE00, 0x5800, LDR2, LD_RT_RN_RM),
+    DECODE_PATTERN(0xF800, 0x4800, LDR3, LD_RT_PC_IM8),
+    DECODE_PATTERN(0xF800, 0x9800, LDR4, LD_RT_SP_IM8),
+    DECODE_PATTERN(0xF800, 0x7800, LDRB1, LD_RT_RN_IM5),
+    DECODE_PATTERN(0xFE00, 0x5C00, LDRB2, LD_RT_RN_RM),
+    DECODE_PATTERN(0xF800, 0x8800, LDRH1, LD_RT_RN_IM5),
+    DECODE_PATTERN(0xFE00, 0x5A00, LDRH2, LD_RT_RN_RM),
+    DECODE_PATTERN(0xFE00, 0x5600, LDRSB, LD_RT_RN_RM),
+    DECODE_PATTERN(0xFE00, 0x5E00, LDRSH, LD_RT_RN_RM),
+    DECODE_PATTERN(0xF800, 0x0000, LSL1, RD_RM_IM5),
+    DECODE_PATTERN(0xFFC0, 0x4080, LSL2, RDN_RM),
+    DECODE_PATTERN(0xF800, 0x0800, LSR1, RD_RM_IM5),
+    DECODE_PATTERN(0xFFC0, 0x40C0, LSR2, RDN_RM),
+    DECODE_PATTERN(0xF800, 0x2000, MOV1, RD_IM8),
+    DECODE_PATTERN(0xFFC0, 0x0000, MOV2, RD_RM),
+    DECODE_PATTERN(0xFFC0, 0x4340, MUL, RDN_RN),
+    DECODE_PATTERN(0xFFC0, 0x43C0, MVN, RD_RM),
+    DECODE_PATTERN(0xFFC0, 0x4240, NEG, RD_RN),
+    DECODE_PATTERN(0xFFFF, 0xBF00, NOP, NONE),
+    DECODE_PATTERN(0xFFC0, 0x4300, ORR, RDN_RM),
+    DECODE_PATTERN(0xFE00, 0xBC00, POP, SP_LIST_PC),
+    DECODE_PATTERN(0xFE00, 0xB400, PUSH, SP_LIST_LR),
+    DECODE_PATTERN(0xFFC0, 0xBA00, REV, RD_RM),
+    DECODE_PATTERN(0xFFC0, 0xBA40, REV16, RD_RM),
+    /* REVSH is decoded as REV16 by decodeInstChain() */
+    DECODE_PATTERN(0xFFC0, 0xBAC0, REV16, RD_RM),
+    DECODE_PATTERN(0xFFC0, 0x41C0, ROR, RDN_RM),
+    DECODE_PATTERN(0xFFC0, 0x4180, SBC, RDN_RM_XPSR),
+    DECODE_PATTERN(0xFFFF, 0xBF40, NOP, UNSUPPORTED),
+    DECODE_PATTERN(0xF800, 0xC000, STMIA, RN_LIST),
+    DECODE_PATTERN(0xF800, 0x6000, STR1, ST_RT_RN_IM5),
+    DECODE_PATTERN(0xFE00, 0x5000, STR2, ST_RT_RN_RM),
+    DECODE_PATTERN(0xF800, 0x9000, STR3, ST_RT_SP_IM8),
+    DECODE_PATTERN(0xF800, 0x7000, STRB1, ST_RT_RN_IM5),
+    DECODE_PATTERN(0xFE00, 0x5400, STRB2, ST_RT_RN_RM),
+    DECODE_PATTERN(0xF800, 0x8000, STRH1, ST_RT_RN_IM5),
+    DECODE_PATTERN(0xFE00, 0x5200, STRH2, ST_RT_RN_RM),
+    DECODE_PATTERN(0xFE00, 0x1E00, SUB1, RD_RN_IM3),
+    DECODE_PATTERN(0xF800, 0x3800, SUB2, RDN_IM8),
+    DECODE_PATTERN(0xFE00, 0x1A00, SUB3, RD_RN_RM),
+    DECODE_PATTERN(0xFF80, 0xB080, SUB4, SPN_IM7),
+    DECODE_PATTERN(0xFF00, 0xDF00, SVC, IM8),
+    DECODE_PATTERN(0xFFC0, 0xB240, SXTB, RD_RM),
+    DECODE_PATTERN(0xFFC0, 0xB200, SXTH, RD_RM),
+    DECODE_PATTERN(0xFFC0, 0x4200, TST, RN_RM),
+    DECODE_PATTERN(0xFFC0, 0xB2C0, UXTB, RD_RM),
+    DECODE_PATTERN(0xFFC0, 0xB280, UXTH, RD_RM),
+};
+
+void Decode::buildDecodeTable()
+{
+    uint32_t inst;
+    size_t i;
+
+    for (inst = 0; inst < DECODE_TABLE_ENTRIES; inst++)
+    {
+        /* Halfwords that do not match any pattern issue a placeholder */
+        decodeTable[inst].op = DecodedOperation::SVC;
+        decodeTable[inst].format = DecodedInstFormat::PLACEHOLDER;
+
+        for (i = 0; i < sizeof(decodePatterns) / sizeof(decodePatterns[0]);
+             i++)
+        {
+            if ((inst & decodePatterns[i].mask) == decodePatterns[i].value)
+            {
+                decodeTable[inst].op = decodePatterns[i].op;
+                decodeTable[inst].format = decodePatterns[i].format;
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Decode the first halfword of an instruction with a single lookup in the
+ * decode table. The register values are read in the same way as
+ * decodeInstChain(): destination registers are set to 0 and pc operands are
+ * replaced with the corrected fetch address
+ */
+int Decode::decodeInst(uint16_t inst, uint32_t pc, Reg activeSp)
 {
-    uint16_t inst;
     uint32_t rd, rdn, rm, rn, rl, rt;
-    uint32_t im32, im11, im10, im8, im7, im5, im3;
-    uint32_t s, j1, j2, i1, i2;
-    uint32_t cond;
-    uint32_t ra, rb, rc, xpsr, pc;
-    Reg activeSp;
+    DecodeTableEntry entry = decodeTable[inst];
 
-    /*
-     * This is the main decoder function that receives an integer value from
-     * the fetch stage and performs some bitwise operations to:
-     *      - Work out the instruction that needs to be executed
-     *      - Extract register values (if any)
-     *      - Extract immediate values (if any)
-     * The code for this decoder reuses some code from David Welch's
-     * thumbulator available at https://github.com/dwelch67/thumbulator
-     */
-    /* Copyright (c) 2010 David Welch dwelch@dwelch.com
-     *
-     * Permission is hereby granted, free of charge, to any person obtaining a
-     * copy of this software and associated documentation files (the
-     * "Software"), to deal in the Software without restriction, including
-     * without limitation the rights to use, copy, modify, merge, publish,
-     * distribute, sublicense, and/or sell copies of the Software, and to
-     * permit persons to whom the Software is furnished to do so, subject to
-     * the following conditions:
-     *
-     * The above copyright notice and this permission notice shall be included
-     * in all copies or substantial portions of the Software.
-     *
-     * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
-     * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
-     * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
-     * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
-     * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
-     * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
-     * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-     */
+    if (entry.format == DecodedInstFormat::UNSUPPORTED)
+    {
+        fprintf(stderr, "Unsupported instruction %04" PRIX16 "\n", inst);
+        exit(1);
+    }
+    else if (entry.format == DecodedInstFormat::PLACEHOLDER)
+    {
+        issuePlaceholderInst();
+
+        DEBUG_CMD(DEBUG_DECODE,
+                  printf("Unable to decode instruction %04" PRIX16
+                         ", issuing: ",
+                         inst);
+                  decodedInst->printDisassembly());
+
+        return 0;
+    }
+
+    decodedInst->setOperation(entry.op);
+
+    switch (entry.format)
+    {
+        case DecodedInstFormat::NONE:
+            break;
+
+        case DecodedInstFormat::IM8:
+            decodedInst->setImmediate((inst >> 0) & 0xFF);
+            break;
+
+        case DecodedInstFormat::IM11:
+            decodedInst->setRegister(DecodedInstRegIndex::RM, Reg::PC, pc);
+            decodedInst->setImmediate((inst >> 0) & 0x7FF);
+            break;
+
+        case DecodedInstFormat::R0:
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RM, Reg::R0, regFile->readData(Reg::R0));
+            break;
+
+        case DecodedInstFormat::BL_PREFIX:
+            decodedInst->setRegister(DecodedInstRegIndex::RDN, Reg::PC, pc);
+            decodedInst->setImmediate((((inst >> 0) & 0x3FF) << 12) |
+                                      (((inst >> 10) & 0x1) << 24));
+            decodedHalfInst = true;
+            break;
+
+        case DecodedInstFormat::COND_IM8:
+            decodedInst->setRegister(DecodedInstRegIndex::RM, Reg::PC, pc);
+            decodedInst->setRegister(DecodedInstRegIndex::XPSR,
+                                     Reg::XPSR,
+                                     regFile->readData(Reg::XPSR));
+            decodedInst->setImmediate((inst >> 0) & 0xFF);
+            decodedInst->setCondition((inst >> 8) & 0xF);
+            break;
+
+        case DecodedInstFormat::RDN_RM:
+        case DecodedInstFormat::RDN_RM_XPSR:
+            rdn = (inst >> 0) & 0x7;
+            rm = (inst >> 3) & 0x7;
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RDN, rdn, regFile->readData(rdn));
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RM, rm, regFile->readData(rm));
+            if (entry.format == DecodedInstFormat::RDN_RM_XPSR)
+            {
+                decodedInst->setRegister(DecodedInstRegIndex::XPSR,
+                                         Reg::XPSR,
+                                         regFile->readData(Reg::XPSR));
+            }
+            break;
+
+        case DecodedInstFormat::RDN_RN:
+            rdn = (inst >> 0) & 0x7;
+            rn = (inst >> 3) & 0x7;
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RDN, rdn, regFile->readData(rdn));
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RN, rn, regFile->readData(rn));
+            break;
+
+        case DecodedInstFormat::RN_RM:
+            rn = (inst >> 0) & 0x7;
+            rm = (inst >> 3) & 0x7;
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RN, rn, regFile->readData(rn));
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RM, rm, regFile->readData(rm));
+            break;
+
+        case DecodedInstFormat::RD_RM:
+            rd = (inst >> 0) & 0x7;
+            rm = (inst >> 3) & 0x7;
+            decodedInst->setRegister(DecodedInstRegIndex::RD, rd, 0);
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RM, rm, regFile->readData(rm));
+            break;
+
+        case DecodedInstFormat::RD_RN:
+            rd = (inst >> 0) & 0x7;
+            rn = (inst >> 3) & 0x7;
+            decodedInst->setRegister(DecodedInstRegIndex::RD, rd, 0);
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RN, rn, regFile->readData(rn));
+            decodedInst->setImmediate(0);
+            break;
+
+        case DecodedInstFormat::RD_RN_IM3:
+            rd = (inst >> 0) & 0x7;
+            rn = (inst >> 3) & 0x7;
+            decodedInst->setRegister(DecodedInstRegIndex::RD, rd, 0);
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RN, rn, regFile->readData(rn));
+            decodedInst->setImmediate((inst >> 6) & 0x7);
+            break;
+
+        case DecodedInstFormat::RD_RN_RM:
+            rd = (inst >> 0) & 0x7;
+            rn = (inst >> 3) & 0x7;
+            rm = (inst >> 6) & 0x7;
+            decodedInst->setRegister(DecodedInstRegIndex::RD, rd, 0);
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RN, rn, regFile->readData(rn));
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RM, rm, regFile->readData(rm));
+            break;
+
+        case DecodedInstFormat::RD_RM_IM5:
+            rd = (inst >> 0) & 0x7;
+            rm = (inst >> 3) & 0x7;
+            decodedInst->setRegister(DecodedInstRegIndex::RD, rd, 0);
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RM, rm, regFile->readData(rm));
+            decodedInst->setImmediate((inst >> 6) & 0x1F);
+            break;
+
+        case DecodedInstFormat::RDN_IM8:
+            rdn = (inst >> 8) & 0x7;
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RDN, rdn, regFile->readData(rdn));
+            decodedInst->setImmediate((inst >> 0) & 0xFF);
+            break;
+
+        case DecodedInstFormat::RN_IM8:
+            rn = (inst >> 8) & 0x7;
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RN, rn, regFile->readData(rn));
+            decodedInst->setImmediate((inst >> 0) & 0xFF);
+            break;
+
+        case DecodedInstFormat::RD_IM8:
+            rd = (inst >> 8) & 0x7;
+            decodedInst->setRegister(DecodedInstRegIndex::RD, rd, 0);
+            decodedInst->setImmediate((inst >> 0) & 0xFF);
+            break;
+
+        case DecodedInstFormat::RD_PC_IM8:
+            rd = (inst >> 8) & 0x7;
+            decodedInst->setRegister(DecodedInstRegIndex::RD, rd, 0);
+            decodedInst->setRegister(DecodedInstRegIndex::RM, Reg::PC, pc);
+            decodedInst->setImmediate((inst >> 0) & 0xFF);
+            break;
+
+        case DecodedInstFormat::RD_SP_IM8:
+            rd = (inst >> 8) & 0x7;
+            decodedInst->setRegister(DecodedInstRegIndex::RD, rd, 0);
+            decodedInst->setRegister(DecodedInstRegIndex::RM,
+                                     activeSp,
+                                     regFile->readData(activeSp));
+            decodedInst->setImmediate((inst >> 0) & 0xFF);
+            break;
+
+        case DecodedInstFormat::SP_SP_IM7:
+            decodedInst->setRegister(DecodedInstRegIndex::RD, activeSp, 0);
+            decodedInst->setRegister(DecodedInstRegIndex::RM,
+                                     activeSp,
+                                     regFile->readData(activeSp));
+            decodedInst->setImmediate((inst >> 0) & 0x7F);
+            break;
+
+        case DecodedInstFormat::SPN_IM7:
+            decodedInst->setRegister(DecodedInstRegIndex::RDN,
+                                     activeSp,
+                                     regFile->readData(activeSp));
+            decodedInst->setImmediate((inst >> 0) & 0x7F);
+            break;
+
+        case DecodedInstFormat::RDN_RM_HI:
+            rdn = ((inst >> 0) & 0x7) | ((inst >> 4) & 0x8);
+            rm = (inst >> 3) & 0xF;
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RDN,
+                rdn,
+                (rdn == static_cast<uint32_t>(Reg::PC)) ?
+                    pc :
+                    regFile->readData(rdn));
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RM,
+                rm,
+                (rm == static_cast<uint32_t>(Reg::PC)) ?
+                    pc :
+                    regFile->readData(rm));
+            break;
+
+        case DecodedInstFormat::RD_RM_HI:
+            rd = ((inst >> 0) & 0x7) | ((inst >> 4) & 0x8);
+            rm = (inst >> 3) & 0xF;
+            decodedInst->setRegister(DecodedInstRegIndex::RD, rd, 0);
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RM,
+                rm,
+                (rm == static_cast<uint32_t>(Reg::PC)) ?
+                    pc :
+                    regFile->readData(rm));
+            break;
+
+        case DecodedInstFormat::RN_RM_HI:
+            rn = ((inst >> 0) & 0x7) | ((inst >> 4) & 0x8);
+            rm = (inst >> 3) & 0xF;
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RN, rn, regFile->readData(rn));
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RM, rm, regFile->readData(rm));
+            break;
+
+        case DecodedInstFormat::PC_RM_HI:
+            rm = (inst >> 3) & 0xF;
+            decodedInst->setRegister(DecodedInstRegIndex::RDN, Reg::PC, pc);
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RM,
+                rm,
+                (rm == static_cast<uint32_t>(Reg::PC)) ?
+                    pc :
+                    regFile->readData(rm));
+            break;
+
+        case DecodedInstFormat::RN_LIST:
+            rn = (inst >> 8) & 0x7;
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RN, rn, regFile->readData(rn));
+            decodedInst->setRegisterList((inst >> 0) & 0xFF);
+            break;
+
+        case DecodedInstFormat::SP_LIST_LR:
+        case DecodedInstFormat::SP_LIST_PC:
+            rl = (inst >> 0) & 0xFF;
+            rl |= ((inst >> 8) & 0x1)
+                << static_cast<uint32_t>(
+                      (entry.format == DecodedInstFormat::SP_LIST_LR) ?
+                          Reg::LR :
+                          Reg::PC);
+            decodedInst->setRegister(DecodedInstRegIndex::RN,
+                                     activeSp,
+                                     regFile->readData(activeSp));
+            decodedInst->setRegisterList(rl);
+            break;
+
+        case DecodedInstFormat::LD_RT_RN_IM5:
+        case DecodedInstFormat::ST_RT_RN_IM5:
+            rt = (inst >> 0) & 0x7;
+            rn = (inst >> 3) & 0x7;
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RT,
+                rt,
+                (entry.format == DecodedInstFormat::ST_RT_RN_IM5) ?
+                    regFile->readData(rt) :
+                    0);
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RN, rn, regFile->readData(rn));
+            decodedInst->setImmediate((inst >> 6) & 0x1F);
+            break;
+
+        case DecodedInstFormat::LD_RT_RN_RM:
+        case DecodedInstFormat::ST_RT_RN_RM:
+            rt = (inst >> 0) & 0x7;
+            rn = (inst >> 3) & 0x7;
+            rm = (inst >> 6) & 0x7;
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RT,
+                rt,
+                (entry.format == DecodedInstFormat::ST_RT_RN_RM) ?
+                    regFile->readData(rt) :
+                    0);
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RN, rn, regFile->readData(rn));
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RM, rm, regFile->readData(rm));
+            break;
+
+        case DecodedInstFormat::LD_RT_PC_IM8:
+            rt = (inst >> 8) & 0x7;
+            decodedInst->setRegister(DecodedInstRegIndex::RT, rt, 0);
+            decodedInst->setRegister(DecodedInstRegIndex::RN, Reg::PC, pc);
+            decodedInst->setImmediate((inst >> 0) & 0xFF);
+            break;
+
+        case DecodedInstFormat::LD_RT_SP_IM8:
+        case DecodedInstFormat::ST_RT_SP_IM8:
+            rt = (inst >> 8) & 0x7;
+            decodedInst->setRegister(
+                DecodedInstRegIndex::RT,
+                rt,
+                (entry.format == DecodedInstFormat::ST_RT_SP_IM8) ?
+                    regFile->readData(rt) :
+                    0);
+            decodedInst->setRegister(DecodedInstRegIndex::RN,
+                                     activeSp,
+                                     regFile->readData(activeSp));
+            decodedInst->setImmediate((inst >> 0) & 0xFF);
+            break;
+
+        default:
+            fprintf(stderr,
+                    "Invalid decode table format for %04" PRIX16 "\n",
+                    inst);
+            exit(1);
+    }
+
+    DEBUG_CMD(DEBUG_DECODE, decodedInst->printDisassembly());
+
+    return 0;
+}
+
+/*
+ * Check that the decode table gives the same result as the reference decoder
+ * for every possible halfword. The registers are loaded with distinct values
+ * first so that swapped operands are also caught
+ */
+int Decode::checkDecodeTable()
+{
+    uint32_t inst, i;
+    uint32_t pc = 0x1004;
+    uint32_t mismatches = 0;
+    Reg activeSp = regFile->getActiveSp();
+    bool chainHalfInst;
+    DecodedInst chainInst = DecodedInst();
+    DecodedInst tableInst = DecodedInst();
+    DecodedInst *savedInst = decodedInst;
+
+    for (i = 0; i <= static_cast<uint32_t>(Reg::XPSR); i++)
+    {
+        regFile->write(RegFile::uint32ToReg(i), 0x10101010 * (i + 1) + i);
+    }
+
+    for (inst = 0; inst < DECODE_TABLE_ENTRIES; inst++)
+    {
+        if (decodeTable[inst].format == DecodedInstFormat::UNSUPPORTED)
+        {
+            /* The reference decoder exits on unsupported instructions */
+            continue;
+        }
+
+        chainInst = DecodedInst();
+        decodedInst = &chainInst;
+        decodedHalfInst = false;
+        decodeInstChain(static_cast<uint16_t>(inst), pc, activeSp);
+        chainHalfInst = decodedHalfInst;
+
+        tableInst = DecodedInst();
+        decodedInst = &tableInst;
+        decodedHalfInst = false;
+        decodeInst(static_cast<uint16_t>(inst), pc, activeSp);
+
+        if (!tableInst.isEqual(chainInst) || decodedHalfInst != chainHalfInst)
+        {
+            fprintf(stderr,
+                    "Decode table mismatch for %04" PRIX32 "\n",
+                    inst);
+            mismatches++;
+        }
+    }
+
+    decodedInst = savedInst;
+    decodedHalfInst = false;
+
+    printf("Decode table checked: %" PRIu32 " mismatches\n", mismatches);
+
+    return (mismatches == 0) ? 0 : -1;
+}
+
+int Decode::run()
+{
+    int ret;
+    FetchedInst fetched;
 
     if (flushPending)
     {
@@ -155,7 +791,7 @@ int Decode::run()
         decodedHalfInst = false;
         if (decodedInst != nullptr)
         {
-            delete decodedInst;
+            instPool.release(decodedInst);
             decodedInst = nullptr;
         }
 
@@ -181,7 +817,7 @@ int Decode::run()
      * Try to get the next instruction, if there is none, then stall, if there
      * is it also lets the fetch stage know that we can progress
      */
-    if (fetch->getNextInst(inst) != 0)
+    if (fetch->getNextInst(fetched) != 0)
     {
         /* Stall as fetch could not provide the following instruction */
         DEBUG_CMD(DEBUG_DECODE, printf("Decode: stalled, pending fetch\n"));
@@ -191,14 +827,74 @@ int Decode::run()
     else if (decodedInst == nullptr)
     {
         /* Allocate a new instruction if we are not in the middle of one */
-        decodedInst = new DecodedInst();
+        decodedInst = instPool.allocate();
     }
 
-    pc = getCorrectedFetchAddress();
-    activeSp = regFile->getActiveSp();
-
     DEBUG_CMD(DEBUG_DECODE, printf("Decode: "));
 
+    /* The pc reads as the address of the instruction plus 4 */
+    ret = decodeHalfword(fetched.inst,
+                         NEXT_THUMB_INST(NEXT_THUMB_INST(fetched.addr)));
+
+    if (!decodedHalfInst)
+    {
+        decodedInst->setPrediction(NEXT_THUMB_INST(fetched.addr),
+                                   fetched.nextAddr,
+                                   fetched.redirectCycle);
+    }
+
+    return ret;
+}
+
+/*
+ * Decode the instruction at instAddr for the functional model, which reads
+ * the halfwords from memory itself instead of going through the fetch stage.
+ * Returns nullptr if the halfword is the first half of a 32-bit instruction
+ */
+DecodedInst *Decode::decodeFunctional(uint16_t inst, uint32_t instAddr)
+{
+    DecodedInst *functionalInst;
+
+    if (decodedInst == nullptr)
+    {
+        decodedInst = instPool.allocate();
+    }
+
+    decodeHalfword(inst, NEXT_THUMB_INST(NEXT_THUMB_INST(instAddr)));
+
+    if (decodedHalfInst)
+    {
+        return nullptr;
+    }
+
+    functionalInst = decodedInst;
+    decodedInst = nullptr;
+
+    return functionalInst;
+}
+
+/*
+ * Get an instruction of a block predecoded by the functional model with its
+ * operands reloaded from the register file. The pc is the address of the
+ * instruction plus 4
+ */
+DecodedInst *Decode::loadPredecodedInst(DecodedInst &inst, uint32_t pc)
+{
+    DecodedInst *predecodedInst = instPool.allocate();
+
+    *predecodedInst = inst;
+    reloadInstOperands(predecodedInst, pc);
+
+    return predecodedInst;
+}
+
+/* Decode a halfword given the address of the instruction plus 4 */
+int Decode::decodeHalfword(uint16_t inst, uint32_t pc)
+{
+    uint32_t im32, im11;
+    uint32_t s, j1, j2, i1, i2;
+    uint32_t instAddr;
+
     /* In some cases the instruction are 32-bit, so process the second half */
     if (decodedHalfInst)
     {
@@ -237,6 +933,59 @@ int Decode::run()
     }
 
     /* Main instruction decoder */
+    instAddr = PREV_THUMB_INST(PREV_THUMB_INST(pc));
+    if (lookupDecodeCache(inst, instAddr, pc))
+    {
+        DEBUG_CMD(DEBUG_DECODE, decodedInst->printDisassembly());
+        return 0;
+    }
+
+    decodeInst(inst, pc, regFile->getActiveSp());
+    fillDecodeCache(inst, instAddr);
+
+    return 0;
+}
+
+int Decode::decodeInstChain(uint16_t inst, uint32_t pc, Reg activeSp)
+{
+    uint32_t rd, rdn, rm, rn, rl, rt;
+    uint32_t im32, im11, im10, im8, im7, im5, im3;
+    uint32_t s;
+    uint32_t cond;
+    uint32_t ra, rb, rc, xpsr;
+
+    /*
+     * This is the main decoder function that receives an integer value from
+     * the fetch stage and performs some bitwise operations to:
+     *      - Work out the instruction that needs to be executed
+     *      - Extract register values (if any)
+     *      - Extract immediate values (if any)
+     * It is kept as the reference for the table-driven decoder in
+     * decodeInst(), which must produce exactly the same results.
+     * The code for this decoder reuses some code from David Welch's
+     * thumbulator available at https://github.com/dwelch67/thumbulator
+     */
+    /* Copyright (c) 2010 David Welch dwelch@dwelch.com
+     *
+     * Permission is hereby granted, free of charge, to any person obtaining a
+     * copy of this software and associated documentation files (the
+     * "Software"), to deal in the Software without restriction, including
+     * without limitation the rights to use, copy, modify, merge, publish,
+     * distribute, sublicense, and/or sell copies of the Software, and to
+     * permit persons to whom the Software is furnished to do so, subject to
+     * the following conditions:
+     *
+     * The above copyright notice and this permission notice shall be included
+     * in all copies or substantial portions of the Software.
+     *
+     * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+     * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+     * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+     * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+     * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+     * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+     * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+     */
 
     /* A6.7.2 ADC (register) Encoding T1 */
     if ((inst & 0xFFC0) == 0x4140)
@@ -1648,6 +2397,11 @@ uint32_t DecodedInst::getRegisterData(DecodedInstRegIndex index)
     return regsData[static_cast<uint32_t>(index)];
 }
 
+uint32_t DecodedInst::getUsedRegisters()
+{
+    return regsUsed;
+}
+
 uint32_t DecodedInst::getRegisterList()
 {
     return regList;
@@ -1658,6 +2412,30 @@ DecodedCondition DecodedInst::getCondition()
     return cond;
 }
 
+void DecodedInst::setPrediction(uint32_t fallThroughAddrIn,
+                                uint32_t predictedAddrIn,
+                                uint64_t predictedCycleIn)
+{
+    fallThroughAddr = fallThroughAddrIn;
+    predictedAddr = predictedAddrIn;
+    predictedCycle = predictedCycleIn;
+}
+
+uint32_t DecodedInst::getFallThroughAddr()
+{
+    return fallThroughAddr;
+}
+
+uint32_t DecodedInst::getPredictedAddr()
+{
+    return predictedAddr;
+}
+
+uint64_t DecodedInst::getPredictedCycle()
+{
+    return predictedCycle;
+}
+
 void DecodedInst::clear()
 {
     size_t i;
@@ -1668,12 +2446,35 @@ void DecodedInst::clear()
     }
 }
 
+bool DecodedInst::isEqual(DecodedInst &other)
+{
+    size_t i;
+
+    if (pending != other.pending || op != other.op || im != other.im ||
+        regList != other.regList || cond != other.cond)
+    {
+        return false;
+    }
+
+    for (i = 0; i < REGFILE_LOW_REGS_COUNT; i++)
+    {
+        if (regsNumber[i] != other.regsNumber[i] ||
+            regsData[i] != other.regsData[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void DecodedInst::setRegister(DecodedInstRegIndex index,
                               uint32_t reg,
                               uint32_t data)
 {
     regsNumber[static_cast<uint32_t>(index)] = RegFile::uint32ToReg(reg);
     regsData[static_cast<uint32_t>(index)] = data;
+    regsUsed = regsUsed | (1 << static_cast<uint32_t>(index));
 }
 
 void DecodedInst::setRegister(DecodedInstRegIndex index,
@@ -1682,6 +2483,7 @@ void DecodedInst::setRegister(DecodedInstRegIndex index,
 {
     regsNumber[static_cast<uint32_t>(index)] = reg;
     regsData[static_cast<uint32_t>(index)] = data;
+    regsUsed = regsUsed | (1 << static_cast<uint32_t>(index));
 }
 
 void DecodedInst::setCondition(uint32_t condIn)
@@ -1695,6 +2497,11 @@ void DecodedInst::setCondition(uint32_t condIn)
     cond = static_cast<DecodedCondition>(condIn);
 }
 
+void DecodedInst::setCondition(DecodedCondition condIn)
+{
+    cond = condIn;
+}
+
 void DecodedInst::printDisassembly()
 {
     uint32_t i;
@@ -2117,3 +2924,157 @@ std::string DecodedInst::getConditionString(DecodedCondition cond)
             exit(1);
     }
 }
+
+std::string DecodedInst::getOperationString(DecodedOperation op)
+{
+    switch (op)
+    {
+        case DecodedOperation::NOP:
+            return "nop";
+        case DecodedOperation::ADC:
+            return "adc";
+        case DecodedOperation::ADD1:
+            return "add1";
+        case DecodedOperation::ADD2:
+            return "add2";
+        case DecodedOperation::ADD3:
+            return "add3";
+        case DecodedOperation::ADD4:
+            return "add4";
+        case DecodedOperation::ADD5:
+            return "add5";
+        case DecodedOperation::ADD6:
+            return "add6";
+        case DecodedOperation::ADD7:
+            return "add7";
+        case DecodedOperation::AND:
+            return "and";
+        case DecodedOperation::ASR1:
+            return "asr1";
+        case DecodedOperation::ASR2:
+            return "asr2";
+        case DecodedOperation::B1:
+            return "b1";
+        case DecodedOperation::B2:
+            return "b2";
+        case DecodedOperation::BIC:
+            return "bic";
+        case DecodedOperation::BKPT:
+            return "bkpt";
+        case DecodedOperation::BL:
+            return "bl";
+        case DecodedOperation::BLX:
+            return "blx";
+        case DecodedOperation::BX:
+            return "bx";
+        case DecodedOperation::CMN:
+            return "cmn";
+        case DecodedOperation::CMP1:
+            return "cmp1";
+        case DecodedOperation::CMP2:
+            return "cmp2";
+        case DecodedOperation::CMP3:
+            return "cmp3";
+        case DecodedOperation::CPS:
+            return "cps";
+        case DecodedOperation::CPY:
+            return "cpy";
+        case DecodedOperation::EOR:
+            return "eor";
+        case DecodedOperation::LDMIA:
+            return "ldmia";
+        case DecodedOperation::LDR1:
+            return "ldr1";
+        case DecodedOperation::LDR2:
+            return "ldr2";
+        case DecodedOperation::LDR3:
+            return "ldr3";
+        case DecodedOperation::LDR4:
+            return "ldr4";
+        case DecodedOperation::LDRB1:
+            return "ldrb1";
+        case DecodedOperation::LDRB2:
+            return "ldrb2";
+        case DecodedOperation::LDRH1:
+            return "ldrh1";
+        case DecodedOperation::LDRH2:
+            return "ldrh2";
+        case DecodedOperation::LDRSB:
+            return "ldrsb";
+        case DecodedOperation::LDRSH:
+            return "ldrsh";
+        case DecodedOperation::LSL1:
+            return "lsl1";
+        case DecodedOperation::LSL2:
+            return "lsl2";
+        case DecodedOperation::LSR1:
+            return "lsr1";
+        case DecodedOperation::LSR2:
+            return "lsr2";
+        case DecodedOperation::MOV1:
+            return "mov1";
+        case DecodedOperation::MOV2:
+            return "mov2";
+        case DecodedOperation::MUL:
+            return "mul";
+        case DecodedOperation::MVN:
+            return "mvn";
+        case DecodedOperation::NEG:
+            return "neg";
+        case DecodedOperation::ORR:
+            return "orr";
+        case DecodedOperation::POP:
+            return "pop";
+        case DecodedOperation::PUSH:
+            return "push";
+        case DecodedOperation::REV:
+            return "rev";
+        case DecodedOperation::REV16:
+            return "rev16";
+        case DecodedOperation::REVSH:
+            return "revsh";
+        case DecodedOperation::ROR:
+            return "ror";
+        case DecodedOperation::SBC:
+            return "sbc";
+        case DecodedOperation::STMIA:
+            return "stmia";
+        case DecodedOperation::STR1:
+            return "str1";
+        case DecodedOperation::STR2:
+            return "str2";
+        case DecodedOperation::STR3:
+            return "str3";
+        case DecodedOperation::STRB1:
+            return "strb1";
+        case DecodedOperation::STRB2:
+            return "strb2";
+        case DecodedOperation::STRH1:
+            return "strh1";
+        case DecodedOperation::STRH2:
+            return "strh2";
+        case DecodedOperation::SUB1:
+            return "sub1";
+        case DecodedOperation::SUB2:
+            return "sub2";
+        case DecodedOperation::SUB3:
+            return "sub3";
+        case DecodedOperation::SUB4:
+            return "sub4";
+        case DecodedOperation::SVC:
+            return "svc";
+        case DecodedOperation::SXTB:
+            return "sxtb";
+        case DecodedOperation::SXTH:
+            return "sxth";
+        case DecodedOperation::TST:
+            return "tst";
+        case DecodedOperation::UXTB:
+            return "uxtb";
+        case DecodedOperation::UXTH:
+            return "uxth";
+        default:
+            fprintf(stderr, "Invalid operation\n");
+            exit(1);
+    }
+}
@@ -0,0 +1,207 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "simulator/execute.h"
+
+#include "simulator/blockcache.h"
+#include "simulator/decode.h"
+#include "simulator/dispatch.h"
+#include "simulator/regfile.h"
+#include "simulator/stats.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+/*
+ * Direct-threaded interpreter for the blocks predecoded by the functional
+ * model. The first time a block runs, the address of the handler of each
+ * instruction is stored next to its predecoded operands. Every handler then
+ * ends by jumping straight to the handler of the following instruction, so
+ * each instruction has its own indirect jump that the host can predict from
+ * the one before it. Without computed goto the handlers are reached through
+ * a switch instead
+ */
+#if defined(__GNUC__)
+#define THREADED_DISPATCH goto *block->handlers[i];
+#else
+#define THREADED_DISPATCH goto dispatch;
+#endif /* __GNUC__ */
+
+/* Operands are read from the register file instead of the decoded copy */
+#undef RDATA
+#define RDATA(index)                                                      \
+    threadedOperand(regFile, decodedInst, DecodedInstRegIndex::index, pc)
+
+/*
+ * Stop after a taken branch or a store to predecoded code, otherwise move on
+ * to the next instruction of the block
+ */
+#define THREADED_NEXT                                           \
+    i++;                                                        \
+    if (mem->checkWatchedStore())                               \
+    {                                                           \
+        modifiedCode = true;                                    \
+        goto done;                                              \
+    }                                                           \
+    if (regFile->readData(Reg::PC) != block->nextAddr[i - 1] || \
+        i == block->instCount)                                  \
+    {                                                           \
+        goto done;                                              \
+    }                                                           \
+    THREADED_DISPATCH
+
+#define THREADED_HANDLER(name, call)                           \
+    threaded_##name:                                           \
+    decodedInst = &block->insts[i];                            \
+    pc = NEXT_THUMB_INST(NEXT_THUMB_INST(block->instAddr[i])); \
+    regFile->write(Reg::PC, block->nextAddr[i]);               \
+    stats->addDecodedOperation(DecodedOperation::name);        \
+    call;                                                      \
+    THREADED_NEXT
+
+#define THREADED_LABEL(name, call)                                           \
+    labels[static_cast<size_t>(DecodedOperation::name)] = &&threaded_##name;
+
+#define THREADED_CASE(name, call) \
+    case DecodedOperation::name:  \
+        goto threaded_##name;
+
+/* Operand of a predecoded instruction, the pc is the address plus 4 */
+static inline uint32_t threadedOperand(RegFile *regFile,
+                                       DecodedInst *inst,
+                                       DecodedInstRegIndex index,
+                                       uint32_t pc)
+{
+    Reg reg = inst->getRegisterNumber(index);
+
+    if (reg == Reg::PC)
+    {
+        return pc;
+    }
+    else if (reg == Reg::RNONE)
+    {
+        return 0;
+    }
+    else if (reg == Reg::MSP || reg == Reg::PSP)
+    {
+        reg = regFile->getActiveSp();
+    }
+
+    return regFile->readData(reg);
+}
+
+#if defined(__GNUC__)
+/* Label addresses and computed gotos are GNU extensions */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif /* __GNUC__ */
+
+/*
+ * Run the instructions of a predecoded block until one of them branches or
+ * writes to predecoded code, which is reported in modifiedCode. Returns the
+ * number of instructions completed
+ */
+uint32_t Execute::runThreadedBlock(PredecodedBlock *block, bool &modifiedCode)
+{
+    uint32_t i = 0;
+    uint32_t pc;
+
+#if defined(__GNUC__)
+    static void *labels[static_cast<size_t>(DecodedOperation::COUNT)];
+    static bool labelsReady = false;
+    DecodedOperation op;
+
+    if (!labelsReady)
+    {
+        EXECUTE_HANDLERS(THREADED_LABEL)
+        labelsReady = true;
+    }
+
+    if (!block->threaded)
+    {
+        for (i = 0; i < block->instCount; i++)
+        {
+            op = block->insts[i].getOperation();
+            block->handlers[i] = (op == DecodedOperation::BKPT ||
+                                  op == DecodedOperation::SVC) ?
+                &&threaded_exit :
+                labels[static_cast<size_t>(op)];
+        }
+        block->threaded = true;
+        i = 0;
+    }
+#endif /* __GNUC__ */
+
+    if (decodedInst != nullptr || execState != ExecuteState::NEXT_INST)
+    {
+        fprintf(stderr,
+                "Functional execution with an instruction in the "
+                "pipeline\n");
+        exit(1);
+    }
+
+    modifiedCode = false;
+    functional = true;
+
+    THREADED_DISPATCH
+
+#if !defined(__GNUC__)
+dispatch:
+    if (block->insts[i].getOperation() == DecodedOperation::BKPT ||
+        block->insts[i].getOperation() == DecodedOperation::SVC)
+    {
+        goto threaded_exit;
+    }
+
+    switch (block->insts[i].getOperation())
+    {
+        EXECUTE_HANDLERS(THREADED_CASE)
+
+        default:
+            fprintf(stderr, "Invalid decoded operation\n");
+            exit(1);
+    }
+#endif /* __GNUC__ */
+
+    EXECUTE_HANDLERS(THREADED_HANDLER)
+
+threaded_exit:
+    /* The handlers of BKPT and SVC release their instruction to the pool */
+    pc = NEXT_THUMB_INST(NEXT_THUMB_INST(block->instAddr[i]));
+    decodedInst = decode->loadPredecodedInst(block->insts[i], pc);
+    regFile->write(Reg::PC, block->nextAddr[i]);
+    executeDecodedInst();
+    i++;
+
+done:
+    decodedInst = nullptr;
+    functional = false;
+
+    return i;
+}
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif /* __GNUC__ */
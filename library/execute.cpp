@@ -25,16 +25,17 @@
 
 #include "simulator/debug.h"
 #include "simulator/decode.h"
+#include "simulator/dispatch.h"
 #include "simulator/fetch.h"
 #include "simulator/memory.h"
 #include "simulator/regfile.h"
 #include "simulator/utils.h"
 
+#include <algorithm>
 #include <cinttypes>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
-#include <list>
 #include <string>
 
 Execute::Execute(Fetch *fetchIn,
@@ -52,6 +53,12 @@ Execute::Execute(Fetch *fetchIn,
 
 void Execute::flushPipeline()
 {
+    if (functional)
+    {
+        /* The functional model does not fill the pipeline */
+        return;
+    }
+
     decode->flush();
     fetch->flush();
 }
@@ -76,16 +83,30 @@ bool Execute::isStalled()
 
 int Execute::executeMultipleStoreFirstMemReq()
 {
-    uint32_t regListByteSize = WORD_TO_BYTE_SIZE(mstoreTmps.regList.size());
+    uint32_t regListByteSize =
+        WORD_TO_BYTE_SIZE(COUNT_SET_BITS(mstoreTmps.regList));
     uint32_t endByteOffset;
+    uint32_t baseByteAddr = mstoreTmps.ptr + mstoreTmps.byteOffset;
 
-    if (!mem->isAvailable())
+    if (!mem->isAvailable(Component::EXECUTE))
     {
-        fprintf(stderr, "Unexpected unavailable memory and directory\n");
-        exit(1);
-        ///* Memory is busy, try again later */
-        // execState = ExecuteState::MULTIPLE_STORE_FIRST_MEM_REQ;
-        // return 0;
+        /* Memory is busy, try again later */
+        stats->addExecuteStallForMemCycle();
+        execState = ExecuteState::MULTIPLE_STORE_FIRST_MEM_REQ;
+        return 0;
+    }
+
+    if (mstoreTmps.op == DecodedOperation::PUSH)
+    {
+        baseByteAddr = baseByteAddr - regListByteSize;
+    }
+    if (writeBuffer != nullptr &&
+        writeBuffer->overlaps(baseByteAddr, baseByteAddr + regListByteSize))
+    {
+        /* Older stores to the same words must reach the memory first */
+        stats->addWriteBufferDrainStall();
+        execState = ExecuteState::MULTIPLE_STORE_FIRST_MEM_REQ;
+        return 0;
     }
 
     /*
@@ -110,6 +131,8 @@ int Execute::executeMultipleStoreFirstMemReq()
     /* Update the base pointer to 1 element after the data stored */
     regFile->write(mstoreTmps.baseReg, mstoreTmps.ptr + endByteOffset);
 
+    mstoreTmps.reqIndex = 0;
+    mstoreTmps.respIndex = 0;
     requestNextStore();
 
     execState = ExecuteState::MULTIPLE_STORE_MEM_REQ;
@@ -118,36 +141,53 @@ int Execute::executeMultipleStoreFirstMemReq()
 
 int Execute::executeMultipleStoreMemReq()
 {
-    /* Wait for the store to complete */
-    if (mem->retrieveStore(mstoreTmps.memToken) != 0)
+    uint32_t token;
+    uint32_t regList;
+
+    /* Place the last store again if it lost the memory arbitration */
+    if (mstoreTmps.respIndex < mstoreTmps.reqIndex &&
+        mem->isRejected(mstoreTmps.memTokens[mstoreTmps.reqIndex - 1]))
     {
-        fprintf(stderr, "Failed memory response when expected\n");
-        exit(1);
+        mstoreTmps.reqIndex--;
+        regList = mstoreTmps.reqRegLists[mstoreTmps.reqIndex];
+        mstoreTmps.regList = mstoreTmps.regList | regList;
+        mstoreTmps.byteOffset = mstoreTmps.byteOffset -
+            WORD_TO_BYTE_SIZE(COUNT_SET_BITS(regList));
     }
 
-    /* Store the next element */
-    if (mstoreTmps.regList.size() > 0)
+    /* Retire the oldest store once the memory served it */
+    if (mstoreTmps.respIndex < mstoreTmps.reqIndex &&
+        !mem->isPending(mstoreTmps.memTokens[mstoreTmps.respIndex]))
     {
-        if (!mem->isAvailable())
+        token = mstoreTmps.memTokens[mstoreTmps.respIndex];
+        if (mem->retrieveStore(token) != 0)
         {
-            fprintf(stderr, "Unexpected unavailable memory\n");
+            fprintf(stderr, "Failed memory response when expected\n");
             exit(1);
-            ///* Memory is busy, try again later */
-            // execState = ExecuteState::MULTIPLE_STORE_MEM_REQ;
-            // return 0;
         }
-        /*
-         * requestNextStore does not always require the directory, so there is
-         * an opportunity to optimise this in the case that we needed to
-         * update the deep and mark flags, but a directory load is not needed
-         */
+        regList = mstoreTmps.reqRegLists[mstoreTmps.respIndex];
+        mstoreTmps.respIndex++;
+
+        stats->addMultipleMemRequest();
+        stats->addMultipleMemWords(COUNT_SET_BITS(regList));
+    }
+
+    /* Store the next elements while the memory accepts more requests */
+    if (mstoreTmps.regList != 0 &&
+        mem->isAvailable(Component::EXECUTE))
+    {
         requestNextStore();
-        execState = ExecuteState::MULTIPLE_STORE_MEM_REQ;
     }
-    else
+
+    if (mstoreTmps.regList == 0 &&
+        mstoreTmps.respIndex == mstoreTmps.reqIndex)
     {
         execState = ExecuteState::NEXT_INST;
     }
+    else
+    {
+        execState = ExecuteState::MULTIPLE_STORE_MEM_REQ;
+    }
 
     return 0;
 }
@@ -156,117 +196,187 @@ int Execute::requestNextStore()
 {
     int ret;
     uint32_t byteAddr = mstoreTmps.ptr + mstoreTmps.byteOffset;
+    uint32_t words =
+        getBurstWords(byteAddr, COUNT_SET_BITS(mstoreTmps.regList));
+    uint32_t regList = mstoreTmps.regList;
+    uint32_t i;
 
-    mstoreTmps.srcReg = mstoreTmps.regList.front();
-    mstoreTmps.regList.pop_front();
-    regFile->read(mstoreTmps.srcReg, mstoreTmps.data);
+    for (i = 0; i < words; i++)
+    {
+        mstoreTmps.srcReg = popRegisterList(mstoreTmps.regList);
+        regFile->read(mstoreTmps.srcReg, mstoreTmps.burstData[i]);
+    }
 
-    ret = mem->requestStore(
-        Component::EXECUTE, byteAddr, mstoreTmps.data, mstoreTmps.memToken);
+    ret = mem->requestBurstStore(Component::EXECUTE,
+                                 byteAddr,
+                                 mstoreTmps.burstData,
+                                 words,
+                                 mstoreTmps.memTokens[mstoreTmps.reqIndex]);
     if (ret != 0)
     {
         fprintf(stderr, "Memory request failed when available\n");
         exit(1);
     }
-    mstoreTmps.byteOffset = mstoreTmps.byteOffset + BYTES_PER_WORD;
+    if (predictor != nullptr || loopBuffer != nullptr)
+    {
+        fetch->snoopStore(byteAddr);
+    }
+    mstoreTmps.byteOffset = mstoreTmps.byteOffset + WORD_TO_BYTE_SIZE(words);
+    mstoreTmps.reqRegLists[mstoreTmps.reqIndex] =
+        regList & ~mstoreTmps.regList;
+    mstoreTmps.reqIndex++;
 
     return 0;
 }
 
-int Execute::executeMultipleLoadFirstMemReq()
+int Execute::requestNextLoad()
 {
-    uint32_t regListByteSize = WORD_TO_BYTE_SIZE(mloadTmps.regList.size());
-    uint32_t byteAddr = mloadTmps.ptr + mloadTmps.byteOffset;
     int ret;
+    uint32_t byteAddr = mloadTmps.ptr + mloadTmps.byteOffset;
+    uint32_t words = getBurstWords(byteAddr, mloadTmps.reqWords);
 
-    if (!mem->isAvailable())
-    {
-        fprintf(stderr, "Unexpected unavailable memory\n");
-        exit(1);
-        ///* Memory is busy, try again later */
-        // execState = ExecuteState::MULTIPLE_LOAD_FIRST_MEM_REQ;
-        // return 0;
-    }
-
-    /* Update the base pointer to 1 element after the data loaded */
-    regFile->write(mloadTmps.baseReg,
-                   mloadTmps.ptr + mloadTmps.byteOffset + regListByteSize);
-
-    ret = mem->requestLoad(Component::EXECUTE, byteAddr, mloadTmps.memToken);
+    ret = mem->requestLoad(Component::EXECUTE,
+                           byteAddr,
+                           mloadTmps.memTokens[mloadTmps.reqIndex]);
     if (ret != 0)
     {
         fprintf(stderr, "Multiple memory request failed when available\n");
         exit(1);
     }
-    mloadTmps.byteOffset = mloadTmps.byteOffset + BYTES_PER_WORD;
+    mloadTmps.burstWords[mloadTmps.reqIndex] = words;
+    mloadTmps.byteOffset = mloadTmps.byteOffset + WORD_TO_BYTE_SIZE(words);
+    mloadTmps.reqWords = mloadTmps.reqWords - words;
+    mloadTmps.reqIndex++;
 
-    execState = ExecuteState::MULTIPLE_LOAD_MEM_REQ;
     return 0;
 }
 
-int Execute::executeMultipleLoadMemReq()
+/*
+ * Number of the words left that the next request transfers. Without bursts
+ * every register needs its own request
+ */
+uint32_t Execute::getBurstWords(uint32_t byteAddr, uint32_t words)
 {
-    uint32_t byteAddr = mloadTmps.ptr + mloadTmps.byteOffset;
-    int ret;
+    uint32_t lineWords;
 
-    /* Get the previous data and update the target register */
-    if (mem->retrieveLoad(mloadTmps.memToken, mloadTmps.data) != 0)
+    if (!burstTransfers)
     {
-        fprintf(stderr, "Memory response not available when expected\n");
-        exit(1);
-        // execState = ExecuteState::MULTIPLE_LOAD_MEM_REQ;
-        // return 0;
+        return 1;
     }
-    mloadTmps.destReg = mloadTmps.regList.front();
-    mloadTmps.regList.pop_front();
-    if (mloadTmps.destReg == Reg::PC)
-    {
-        regFile->write(mloadTmps.destReg, mloadTmps.data & ~0x1);
 
-        execState = ExecuteState::FLUSH_PIPELINE;
+    lineWords = mem->getMemAccessWidthWords() -
+        mem->getMemAccessWidthWordIndex(byteAddr);
 
-        stats->addBranchTaken();
+    return std::min(words, lineWords);
+}
 
-        /* Sanity check */
-        if (mloadTmps.regList.size() > 0)
-        {
-            fprintf(stderr,
-                    "pc is not the last register in multiple memory "
-                    "load\n");
-            exit(1);
-        }
+int Execute::executeMultipleLoadFirstMemReq()
+{
+    uint32_t regListByteSize =
+        WORD_TO_BYTE_SIZE(COUNT_SET_BITS(mloadTmps.regList));
+    uint32_t baseByteAddr = mloadTmps.ptr + mloadTmps.byteOffset;
 
+    if (!mem->isAvailable(Component::EXECUTE))
+    {
+        /* Memory is busy, try again later */
+        stats->addExecuteStallForMemCycle();
+        execState = ExecuteState::MULTIPLE_LOAD_FIRST_MEM_REQ;
         return 0;
     }
-    else
+    else if (writeBuffer != nullptr &&
+             writeBuffer->overlaps(baseByteAddr,
+                                   baseByteAddr + regListByteSize))
     {
-        regFile->write(mloadTmps.destReg, mloadTmps.data);
+        /* Wait for the stores to the same words to reach the memory */
+        stats->addWriteBufferDrainStall();
+        execState = ExecuteState::MULTIPLE_LOAD_FIRST_MEM_REQ;
+        return 0;
     }
 
-    /* Load the next element */
-    if (mloadTmps.regList.size() > 0)
+    /* Update the base pointer to 1 element after the data loaded */
+    regFile->write(mloadTmps.baseReg,
+                   mloadTmps.ptr + mloadTmps.byteOffset + regListByteSize);
+
+    mloadTmps.reqWords = COUNT_SET_BITS(mloadTmps.regList);
+    mloadTmps.reqIndex = 0;
+    mloadTmps.respIndex = 0;
+    requestNextLoad();
+
+    execState = ExecuteState::MULTIPLE_LOAD_MEM_REQ;
+    return 0;
+}
+
+int Execute::executeMultipleLoadMemReq()
+{
+    uint32_t i;
+    uint32_t words;
+    uint32_t token;
+
+    /* Place the last load again if it lost the memory arbitration */
+    if (mloadTmps.respIndex < mloadTmps.reqIndex &&
+        mem->isRejected(mloadTmps.memTokens[mloadTmps.reqIndex - 1]))
+    {
+        mloadTmps.reqIndex--;
+        words = mloadTmps.burstWords[mloadTmps.reqIndex];
+        mloadTmps.reqWords = mloadTmps.reqWords + words;
+        mloadTmps.byteOffset =
+            mloadTmps.byteOffset - WORD_TO_BYTE_SIZE(words);
+    }
+
+    /* Update the target registers once the oldest load is served */
+    if (mloadTmps.respIndex < mloadTmps.reqIndex &&
+        !mem->isPending(mloadTmps.memTokens[mloadTmps.respIndex]))
     {
-        if (!mem->isAvailable())
+        token = mloadTmps.memTokens[mloadTmps.respIndex];
+        words = mloadTmps.burstWords[mloadTmps.respIndex];
+        if (mem->retrieveBurstLoad(token, mloadTmps.burstData, words) != 0)
         {
-            fprintf(stderr, "Unexpected memory unavailable\n");
+            fprintf(stderr, "Memory response not available when expected\n");
             exit(1);
-            ///* Memory is busy, try again later */
-            // execState = ExecuteState::MULTIPLE_LOAD_MEM_REQ;
-            // return 0;
         }
+        mloadTmps.respIndex++;
+
+        stats->addMultipleMemRequest();
+        stats->addMultipleMemWords(words);
 
-        ret =
-            mem->requestLoad(Component::EXECUTE, byteAddr, mloadTmps.memToken);
-        if (ret != 0)
+        for (i = 0; i < words; i++)
         {
-            fprintf(stderr, "Multiple memory request failed when available\n");
-            exit(1);
+            mloadTmps.destReg = popRegisterList(mloadTmps.regList);
+            if (mloadTmps.destReg == Reg::PC)
+            {
+                regFile->write(mloadTmps.destReg,
+                               mloadTmps.burstData[i] & ~0x1);
+
+                execState = ExecuteState::FLUSH_PIPELINE;
+
+                stats->addBranchTaken();
+
+                /* Sanity check */
+                if (mloadTmps.regList != 0)
+                {
+                    fprintf(stderr,
+                            "pc is not the last register in multiple memory "
+                            "load\n");
+                    exit(1);
+                }
+
+                return 0;
+            }
+            else
+            {
+                regFile->write(mloadTmps.destReg, mloadTmps.burstData[i]);
+            }
         }
-        mloadTmps.byteOffset = mloadTmps.byteOffset + BYTES_PER_WORD;
+    }
 
-        execState = ExecuteState::MULTIPLE_LOAD_MEM_REQ;
+    /* Load the next elements while the memory accepts more requests */
+    if (mloadTmps.reqWords != 0 &&
+        mem->isAvailable(Component::EXECUTE))
+    {
+        requestNextLoad();
     }
-    else
+
+    if (mloadTmps.regList == 0)
     {
         /*
          * This looks like we are going to spend an extra cycle just deciding
@@ -276,6 +386,10 @@ int Execute::executeMultipleLoadMemReq()
          */
         execState = ExecuteState::NEXT_INST;
     }
+    else
+    {
+        execState = ExecuteState::MULTIPLE_LOAD_MEM_REQ;
+    }
 
     return 0;
 }
@@ -293,14 +407,35 @@ int Execute::executeLoadMemReq()
 {
     int ret;
     uint32_t byteAddr = loadTmps.ptr + loadTmps.byteOffset;
+    WriteBufferLookup lookup;
 
-    if (!mem->isAvailable())
+    if (writeBuffer != nullptr)
+    {
+        lookup = writeBuffer->lookup(
+            byteAddr,
+            getLoadByteEnable(loadTmps.type, loadTmps.byteOffset),
+            loadTmps.data);
+        if (lookup == WriteBufferLookup::HIT)
+        {
+            /* Forward the data of the stores that are still buffered */
+            stats->addWriteBufferForward();
+            return executeLoadWriteBack();
+        }
+        else if (lookup == WriteBufferLookup::PARTIAL)
+        {
+            /* Wait for the stores to the same word to reach the memory */
+            stats->addWriteBufferDrainStall();
+            execState = ExecuteState::LOAD_MEM_REQ;
+            return 0;
+        }
+    }
+
+    if (!mem->isAvailable(Component::EXECUTE))
     {
-        fprintf(stderr, "Unexpected memory unavailable\n");
-        exit(1);
         /* Memory is busy, try again later */
-        // execState = ExecuteState::LOAD_MEM_REQ;
-        // return 0;
+        stats->addExecuteStallForMemCycle();
+        execState = ExecuteState::LOAD_MEM_REQ;
+        return 0;
     }
 
     ret = mem->requestLoad(Component::EXECUTE, byteAddr, loadTmps.memToken);
@@ -318,15 +453,30 @@ int Execute::executeLoadMemResp()
 {
     int ret;
 
+    if (mem->isRejected(loadTmps.memToken))
+    {
+        /* Lost the memory arbitration, try again */
+        return executeLoadMemReq();
+    }
+    else if (mem->isPending(loadTmps.memToken))
+    {
+        /* The loaded data is not yet ready */
+        return 0;
+    }
+
     ret = mem->retrieveLoad(loadTmps.memToken, loadTmps.data);
     if (ret != 0)
     {
         fprintf(stderr, "Failed memory response when expected\n");
         exit(1);
-        ///* The loaded data is not yet ready */
-        // return 0;
     }
 
+    return executeLoadWriteBack();
+}
+
+/* Complete a load with the word that holds its data in loadTmps.data */
+int Execute::executeLoadWriteBack()
+{
     /* Format the data according to the instruction */
     Execute::formatDataForMemLoad(
         loadTmps.type, loadTmps.data, loadTmps.byteOffset);
@@ -349,28 +499,35 @@ int Execute::executeStoreMemReq()
 {
     int ret;
     uint32_t byteAddr = storeTmps.ptr + storeTmps.byteOffset;
-    uint32_t prevData;
 
-    if (!mem->isAvailable())
+    if (writeBuffer != nullptr)
     {
-        fprintf(stderr, "Unexpected directory or memory unavailable\n");
-        exit(1);
-        ///* Memory is busy, try again later */
-        // execState = ExecuteState::STORE_MEM_REQ;
-        // return 0;
+        return executeStoreWriteBuffer();
     }
 
-    mem->loadWord(byteAddr, prevData);
-    formatDataForMemStore(
-        storeTmps.type, prevData, storeTmps.data, storeTmps.byteOffset);
+    if (!mem->isAvailable(Component::EXECUTE))
+    {
+        /* Memory is busy, try again later */
+        stats->addExecuteStallForMemCycle();
+        execState = ExecuteState::STORE_MEM_REQ;
+        return 0;
+    }
 
-    ret = mem->requestStore(
-        Component::EXECUTE, byteAddr, storeTmps.data, storeTmps.memToken);
+    ret = mem->requestStore(Component::EXECUTE,
+                            byteAddr,
+                            storeTmps.data,
+                            storeTmps.byteEnable,
+                            storeTmps.memToken);
     if (ret != 0)
     {
         fprintf(stderr, "Memory request failed when available\n");
         exit(1);
     }
+    if (predictor != nullptr || loopBuffer != nullptr)
+    {
+        /* The store may modify instructions that fetch already queued */
+        fetch->snoopStore(byteAddr);
+    }
 
     execState = ExecuteState::STORE_MEM_RESP;
     return 0;
@@ -378,7 +535,17 @@ int Execute::executeStoreMemReq()
 
 int Execute::executeStoreMemResp()
 {
-    if (mem->retrieveStore(storeTmps.memToken) != 0)
+    if (mem->isRejected(storeTmps.memToken))
+    {
+        /* Lost the memory arbitration, try again */
+        return executeStoreMemReq();
+    }
+    else if (mem->isPending(storeTmps.memToken))
+    {
+        /* The store is still in the memory wait states */
+        return 0;
+    }
+    else if (mem->retrieveStore(storeTmps.memToken) != 0)
     {
         fprintf(stderr, "Failed memory response when expected\n");
         exit(1);
@@ -388,6 +555,134 @@ int Execute::executeStoreMemResp()
     return 0;
 }
 
+/*
+ * The store retires as soon as it is in the write buffer, which writes it to
+ * the memory later, so execute only stalls while the buffer is full
+ */
+int Execute::executeStoreWriteBuffer()
+{
+    uint32_t byteAddr = storeTmps.ptr + storeTmps.byteOffset;
+
+    if (writeBuffer->isFull())
+    {
+        stats->addWriteBufferFullStall();
+        execState = ExecuteState::STORE_MEM_REQ;
+        return 0;
+    }
+
+    writeBuffer->push(byteAddr, storeTmps.data, storeTmps.byteEnable);
+    if (predictor != nullptr || loopBuffer != nullptr)
+    {
+        /* The store may modify instructions that fetch already queued */
+        fetch->snoopStore(byteAddr);
+    }
+
+    execState = ExecuteState::NEXT_INST;
+    return 0;
+}
+
+int Execute::executeLoadFunctional()
+{
+    uint32_t byteAddr = loadTmps.ptr + loadTmps.byteOffset;
+
+    mem->loadWord(byteAddr, loadTmps.data);
+
+    /* Format the data according to the instruction */
+    Execute::formatDataForMemLoad(
+        loadTmps.type, loadTmps.data, loadTmps.byteOffset);
+
+    if (loadTmps.destReg == Reg::PC)
+    {
+        fprintf(stderr, "Cannot load into pc\n");
+        exit(1);
+    }
+
+    /* Write back the register */
+    regFile->write(loadTmps.destReg, loadTmps.data);
+
+    return 0;
+}
+
+int Execute::executeStoreFunctional()
+{
+    uint32_t byteAddr = storeTmps.ptr + storeTmps.byteOffset;
+
+    mem->storeWord(byteAddr, storeTmps.data, storeTmps.byteEnable);
+
+    return 0;
+}
+
+int Execute::executeMultipleLoadFunctional()
+{
+    uint32_t regListByteSize =
+        WORD_TO_BYTE_SIZE(COUNT_SET_BITS(mloadTmps.regList));
+
+    /* Update the base pointer to 1 element after the data loaded */
+    regFile->write(mloadTmps.baseReg,
+                   mloadTmps.ptr + mloadTmps.byteOffset + regListByteSize);
+
+    while (mloadTmps.regList != 0)
+    {
+        mem->loadWord(mloadTmps.ptr + mloadTmps.byteOffset, mloadTmps.data);
+        mloadTmps.byteOffset = mloadTmps.byteOffset + BYTES_PER_WORD;
+
+        mloadTmps.destReg = popRegisterList(mloadTmps.regList);
+        if (mloadTmps.destReg == Reg::PC)
+        {
+            regFile->write(mloadTmps.destReg, mloadTmps.data & ~0x1);
+
+            stats->addBranchTaken();
+
+            /* Sanity check */
+            if (mloadTmps.regList != 0)
+            {
+                fprintf(stderr,
+                        "pc is not the last register in multiple memory "
+                        "load\n");
+                exit(1);
+            }
+        }
+        else
+        {
+            regFile->write(mloadTmps.destReg, mloadTmps.data);
+        }
+    }
+
+    return 0;
+}
+
+int Execute::executeMultipleStoreFunctional()
+{
+    uint32_t regListByteSize =
+        WORD_TO_BYTE_SIZE(COUNT_SET_BITS(mstoreTmps.regList));
+    uint32_t endByteOffset;
+
+    /* PUSH moves the base pointer before storing anything */
+    if (mstoreTmps.op == DecodedOperation::STMIA)
+    {
+        endByteOffset = mstoreTmps.byteOffset + regListByteSize;
+    }
+    else
+    {
+        endByteOffset = mstoreTmps.byteOffset - regListByteSize;
+        mstoreTmps.byteOffset = endByteOffset;
+    }
+
+    /* Update the base pointer to 1 element after the data stored */
+    regFile->write(mstoreTmps.baseReg, mstoreTmps.ptr + endByteOffset);
+
+    while (mstoreTmps.regList != 0)
+    {
+        mstoreTmps.srcReg = popRegisterList(mstoreTmps.regList);
+        regFile->read(mstoreTmps.srcReg, mstoreTmps.data);
+        mem->storeWord(mstoreTmps.ptr + mstoreTmps.byteOffset,
+                       mstoreTmps.data);
+        mstoreTmps.byteOffset = mstoreTmps.byteOffset + BYTES_PER_WORD;
+    }
+
+    return 0;
+}
+
 void Execute::calculateExecCycles()
 {
     switch (curExecState)
@@ -536,13 +831,6 @@ std::string Execute::execStateToStr(ExecuteState state)
 
 int Execute::executeNextInst()
 {
-    Reg rd, rt, rdn, rm, rn;
-    uint32_t drt, drdn, drm, drn, dxpsr;
-    DecodedCondition cond;
-    uint32_t rl;
-    uint32_t im;
-    uint32_t cflag;
-
     if (decodedInst != nullptr)
     {
         fprintf(stderr,
@@ -567,312 +855,103 @@ int Execute::executeNextInst()
         DEBUG_CMD(DEBUG_EXECUTE, printf("Execute: new instruction\n"));
     }
 
-    /* Extract all the decoded data for convenience */
-    rd = decodedInst->getRegisterNumber(DecodedInstRegIndex::RD);
-    rt = decodedInst->getRegisterNumber(DecodedInstRegIndex::RT);
-    rdn = decodedInst->getRegisterNumber(DecodedInstRegIndex::RDN);
-    rm = decodedInst->getRegisterNumber(DecodedInstRegIndex::RM);
-    rn = decodedInst->getRegisterNumber(DecodedInstRegIndex::RN);
-
-    drt = decodedInst->getRegisterData(DecodedInstRegIndex::RT);
-    drdn = decodedInst->getRegisterData(DecodedInstRegIndex::RDN);
-    drm = decodedInst->getRegisterData(DecodedInstRegIndex::RM);
-    drn = decodedInst->getRegisterData(DecodedInstRegIndex::RN);
-    dxpsr = decodedInst->getRegisterData(DecodedInstRegIndex::XPSR);
-
-    rl = decodedInst->getRegisterList();
-
-    im = decodedInst->getImmediate();
-
-    cond = decodedInst->getCondition();
-
-    cflag = RegFile::getXpsrC(dxpsr);
-
-    DEBUG_CMD(DEBUG_EXECUTE, printf("Execute:"));
-
-    /* Execute the decoded instruction */
-    switch (decodedInst->getOperation())
+    if (predictor == nullptr && loopBuffer == nullptr)
     {
-        /* Multiple memory access instructions */
-        case DecodedOperation::POP:
-        case DecodedOperation::LDMIA:
-            popLdmia(rn, drn, rl);
-            break;
-
-        case DecodedOperation::PUSH:
-            push(rn, drn, rl);
-            break;
-
-        case DecodedOperation::STMIA:
-            stmia(rn, drn, rl);
-            break;
-
-        /* Memory access instructions */
-        case DecodedOperation::STR1:
-        case DecodedOperation::STR3:
-            str1Str3(rt, drt, rn, drn, im);
-            break;
-
-        case DecodedOperation::STR2:
-            str2(rt, drt, rn, drn, drm);
-            break;
-
-        case DecodedOperation::STRB1:
-            strb1(rt, drt, rn, drn, im);
-            break;
-
-        case DecodedOperation::STRB2:
-            strb2(rt, drt, rn, drn, drm);
-            break;
-
-        case DecodedOperation::STRH1:
-            strh1(rt, drt, rn, drn, im);
-            break;
-
-        case DecodedOperation::STRH2:
-            strh2(rt, drt, rn, drn, drm);
-            break;
-
-        case DecodedOperation::LDR1:
-        case DecodedOperation::LDR4:
-            ldr1Ldr4(rt, drn, im);
-            break;
-
-        case DecodedOperation::LDR2:
-            ldr2(rt, drn, drm);
-            break;
-
-        case DecodedOperation::LDR3:
-            ldr3(rt, drn, im);
-            break;
-
-        case DecodedOperation::LDRB1:
-            ldrb1(rt, drn, im);
-            break;
-
-        case DecodedOperation::LDRB2:
-            ldrb2(rt, drn, drm);
-            break;
-
-        case DecodedOperation::LDRH1:
-            ldrh1(rt, drn, im);
-            break;
-
-        case DecodedOperation::LDRH2:
-            ldrh2(rt, drn, drm);
-            break;
-
-        case DecodedOperation::LDRSB:
-            ldrsb(rt, drn, drm);
-            break;
-
-        case DecodedOperation::LDRSH:
-            ldrsh(rt, drn, drm);
-            break;
-
-        /* Branch instructions */
-        case DecodedOperation::B1:
-            b1(rm, drm, im, dxpsr, cond);
-            break;
-
-        case DecodedOperation::B2:
-            b2(rm, drm, im);
-            break;
-
-        case DecodedOperation::BL:
-            bl(rdn, drdn, im);
-            break;
-
-        case DecodedOperation::BLX:
-            blx(rdn, drdn, drm);
-            break;
-
-        case DecodedOperation::BX:
-            bx(rdn, drm);
-            break;
-
-        case DecodedOperation::CPY:
-            cpy(rd, drm);
-            break;
-
-        /* Arithmetic and logic instructions */
-        case DecodedOperation::ADC:
-            adc(rdn, drdn, drm, cflag);
-            break;
-
-        case DecodedOperation::ADD1:
-            add1(rd, drn, im);
-            break;
-
-        case DecodedOperation::ADD2:
-            add2(rdn, drdn, im);
-            break;
-
-        case DecodedOperation::ADD3:
-            add3(rd, drn, drm);
-            break;
-
-        case DecodedOperation::ADD4:
-            add4(rdn, drdn, drm);
-            break;
-
-        case DecodedOperation::ADD5:
-            add5(rd, drm, im);
-            break;
-
-        case DecodedOperation::ADD6:
-        case DecodedOperation::ADD7:
-            add6Add7(rd, drm, im);
-            break;
-
-        case DecodedOperation::AND:
-            and0(rdn, drdn, drm);
-            break;
-
-        case DecodedOperation::ASR1:
-            asr1(rd, drm, im);
-            break;
-
-        case DecodedOperation::ASR2:
-            asr2(rdn, drdn, drm);
-            break;
-
-        case DecodedOperation::BIC:
-            bic(rdn, drdn, drm);
-            break;
-
-        case DecodedOperation::CMN:
-            cmn(drn, drm);
-            break;
-
-        case DecodedOperation::CMP1:
-            cmp1(drn, im);
-            break;
-
-        case DecodedOperation::CMP2:
-        case DecodedOperation::CMP3:
-            cmp2Cmp3(drn, drm);
-            break;
-
-        case DecodedOperation::EOR:
-            eor(rdn, drdn, drm);
-            break;
-
-        case DecodedOperation::LSL1:
-            lsl1(rd, drm, im);
-            break;
-
-        case DecodedOperation::LSL2:
-            lsl2(rdn, drdn, drm);
-            break;
-
-        case DecodedOperation::LSR1:
-            lsr1(rd, drm, im);
-            break;
-
-        case DecodedOperation::LSR2:
-            lsr2(rdn, drdn, drm);
-            break;
-
-        case DecodedOperation::MOV1:
-            mov1(rd, im);
-            break;
-
-        case DecodedOperation::MOV2:
-            mov2(rd, drm);
-            break;
-
-        case DecodedOperation::MUL:
-            mul(rdn, drdn, drn);
-            break;
-
-        case DecodedOperation::MVN:
-            mvn(rd, drm);
-            break;
-
-        case DecodedOperation::ORR:
-            orr(rdn, drdn, drm);
-            break;
-
-        case DecodedOperation::REV:
-            rev(rd, drm);
-            break;
-
-        case DecodedOperation::REV16:
-            rev16(rd, drm);
-            break;
-
-        case DecodedOperation::REVSH:
-            revsh(rd, drm);
-            break;
-
-        case DecodedOperation::ROR:
-            ror(rdn, drdn, drm);
-            break;
+        return executeDecodedInst();
+    }
 
-        case DecodedOperation::NEG:
-            neg(rd, drn, im);
-            break;
+    predictionTmps.fallThroughAddr = decodedInst->getFallThroughAddr();
+    predictionTmps.predictedAddr = decodedInst->getPredictedAddr();
+    predictionTmps.predictedCycle = decodedInst->getPredictedCycle();
+    predictionTmps.resolved = false;
 
-        case DecodedOperation::NOP:
-            nop();
-            break;
+    executeDecodedInst();
 
-        case DecodedOperation::SBC:
-            sbc(rdn, drdn, drm, cflag);
-            break;
+    if (!predictionTmps.resolved &&
+        predictionTmps.predictedAddr != predictionTmps.fallThroughAddr)
+    {
+        /*
+         * Fetch predicted a branch that is not there, which happens if the
+         * program modified its code, so continue after the instruction
+         */
+        if (predictor != nullptr)
+        {
+            predictor->invalidate(
+                PREV_THUMB_INST(predictionTmps.fallThroughAddr));
+        }
+        regFile->write(Reg::PC, predictionTmps.fallThroughAddr);
+        flushPipeline();
+    }
 
-        case DecodedOperation::SUB1:
-            sub1(rd, drn, im);
-            break;
+    return 0;
+}
 
-        case DecodedOperation::SUB2:
-            sub2(rdn, drdn, im);
-            break;
+/*
+ * Run an instruction in the functional model. Memory is accessed directly and
+ * the instruction completes immediately, the pc must already point to the
+ * following instruction
+ */
+int Execute::executeFunctional(DecodedInst *inst)
+{
+    if (decodedInst != nullptr || execState != ExecuteState::NEXT_INST)
+    {
+        fprintf(stderr,
+                "Functional execution with an instruction in the "
+                "pipeline\n");
+        exit(1);
+    }
 
-        case DecodedOperation::SUB3:
-            sub3(rd, drm, drn);
-            break;
+    functional = true;
+    decodedInst = inst;
+    executeDecodedInst();
+    functional = false;
 
-        case DecodedOperation::SUB4:
-            sub4(rdn, drdn, im);
-            break;
+    return 0;
+}
 
-        case DecodedOperation::TST:
-            tst(drm, drn);
-            break;
+void Execute::setBurstTransfers(bool burstTransfersIn)
+{
+    burstTransfers = burstTransfersIn;
+}
 
-        case DecodedOperation::UXTB:
-            uxtb(rd, drm);
-            break;
+void Execute::setBranchPredictor(BranchPredictor *predictorIn)
+{
+    predictor = predictorIn;
+}
 
-        case DecodedOperation::UXTH:
-            uxth(rd, drm);
-            break;
+void Execute::setLoopBuffer(LoopBuffer *loopBufferIn)
+{
+    loopBuffer = loopBufferIn;
+}
 
-        case DecodedOperation::SXTB:
-            sxtb(rd, drm);
-            break;
+void Execute::setWriteBuffer(WriteBuffer *writeBufferIn)
+{
+    writeBuffer = writeBufferIn;
+}
 
-        case DecodedOperation::SXTH:
-            sxth(rd, drm);
-            break;
+int Execute::executeDecodedInst()
+{
+    DEBUG_CMD(DEBUG_EXECUTE, printf("Execute:"));
 
-        /* Other instructions */
-        case DecodedOperation::BKPT:
-            bkpt(im);
-            break;
+    /* Record the encoding stats */
+    stats->addDecodedOperation(decodedInst->getOperation());
 
-        case DecodedOperation::SVC:
-            svc(im);
-            break;
+    /* Execute the decoded instruction */
+    switch (decodedInst->getOperation())
+    {
+#define EXECUTE_CASE(name, call)    \
+    case DecodedOperation::name:    \
+        call;                       \
+        break;
+        EXECUTE_HANDLERS(EXECUTE_CASE)
+#undef EXECUTE_CASE
 
-        case DecodedOperation::CPS:
-            cps(drm);
-            break;
+        default:
+            fprintf(stderr, "Invalid decoded operation\n");
+            exit(1);
     }
 
-    delete decodedInst;
+    decode->releaseInst(decodedInst);
     decodedInst = nullptr;
 
     return 0;
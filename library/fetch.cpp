@@ -27,23 +27,53 @@
 #include "simulator/execute.h"
 #include "simulator/memory.h"
 #include "simulator/regfile.h"
+#include "simulator/stats.h"
 #include "simulator/utils.h"
 
 #include <cinttypes>
 #include <cstdint>
-#include <cstring>
+#include <string>
 
-Fetch::Fetch(Memory *memIn, RegFile *regFileIn, Statistics *statsIn) :
+Fetch::Fetch(Memory *memIn,
+             RegFile *regFileIn,
+             Statistics *statsIn,
+             uint32_t queueDepthIn) :
     mem(memIn),
     regFile(regFileIn),
-    stats(statsIn)
+    stats(statsIn),
+    queueDepth(queueDepthIn)
 {
-    instBuffer = new uint16_t[memIn->getMemAccessWidthWords() * 2];
+    uint32_t i;
+
+    queueSize = queueDepth + 1;
+    lineBytes = WORD_TO_BYTE_SIZE(memIn->getMemAccessWidthWords());
+    queue = new FetchQueueEntry[queueSize];
+
+    for (i = 0; i < queueSize; i++)
+    {
+        queue[i].baseAddr = 0;
+        queue[i].memToken = 0xFFFFFFFF;
+        queue[i].issued = false;
+        queue[i].rejected = false;
+        queue[i].valid = false;
+        queue[i].fetched = false;
+        queue[i].redirect = false;
+        queue[i].branchAddr = 0;
+        queue[i].target = 0;
+        queue[i].requestCycle = 0;
+        queue[i].insts = new uint16_t[memIn->getMemAccessWidthWords() * 2];
+    }
 }
 
 Fetch::~Fetch()
 {
-    delete instBuffer;
+    uint32_t i;
+
+    for (i = 0; i < queueSize; i++)
+    {
+        delete[] queue[i].insts;
+    }
+    delete[] queue;
 }
 
 void Fetch::flush()
@@ -51,97 +81,309 @@ void Fetch::flush()
     flushPending = true;
 }
 
+bool Fetch::isFlushPending()
+{
+    return flushPending;
+}
+
+/* Whether a fetch was accepted by the memory and is not yet retrieved */
+bool Fetch::hasIssuedMemAccess()
+{
+    uint32_t i;
+    FetchQueueEntry *entry;
+
+    for (i = 0; i < queueCount; i++)
+    {
+        entry = getQueueEntry(i);
+        if (entry->issued && !mem->isRejected(entry->memToken))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void Fetch::setExecute(Execute *executeIn)
 {
     execute = executeIn;
 }
 
+void Fetch::setBranchPredictor(BranchPredictor *predictorIn)
+{
+    predictor = predictorIn;
+}
+
+void Fetch::setLoopBuffer(LoopBuffer *loopBufferIn)
+{
+    loopBuffer = loopBufferIn;
+}
+
 void Fetch::print()
 {
     uint32_t i;
+    uint32_t j;
+    FetchQueueEntry *entry;
     std::string prefix = "    ";
 
-    printf("Fetch: base:0x%08" PRIX32 " valid:%s flushPending:%s "
-           "issuedMemAccess:%s memToken:0x%08" PRIX32 "\n",
-           instBufferBaseAddr,
-           BOOL_TO_STR(instBufferValid),
-           BOOL_TO_STR(flushPending),
-           BOOL_TO_STR(issuedMemAccess),
-           memToken);
+    printf("Fetch: entries:%" PRIu32 " filled:%s flushPending:%s\n",
+           queueCount,
+           BOOL_TO_STR(filled),
+           BOOL_TO_STR(flushPending));
 
-    for (i = 0; i < mem->getMemAccessWidthWords() * 2; i++)
+    for (i = 0; i < queueCount; i++)
     {
-        printf("%s0x%08" PRIX32 ": %04" PRIX16 "\n",
+        entry = getQueueEntry(i);
+        printf("%sbase:0x%08" PRIX32 " valid:%s issued:%s rejected:%s "
+               "memToken:0x%08" PRIX32 "\n",
                prefix.c_str(),
-               i * THUMB_INST_BYTES + instBufferBaseAddr,
-               instBuffer[i]);
+               entry->baseAddr,
+               BOOL_TO_STR(entry->valid),
+               BOOL_TO_STR(entry->issued),
+               BOOL_TO_STR(entry->rejected),
+               entry->memToken);
+
+        for (j = 0; entry->valid && j < mem->getMemAccessWidthWords() * 2;
+             j++)
+        {
+            printf("%s%s0x%08" PRIX32 ": %04" PRIX16 "\n",
+                   prefix.c_str(),
+                   prefix.c_str(),
+                   j * THUMB_INST_BYTES + entry->baseAddr,
+                   entry->insts[j]);
+        }
     }
 }
 
-int Fetch::getNextInst(uint16_t &inst)
+int Fetch::getNextInst(FetchedInst &fetched)
 {
     uint32_t pc;
+    uint16_t inst;
+    FetchQueueEntry *entry = getQueueEntry(0);
 
     regFile->read(Reg::PC, pc);
 
-    if (!instBufferValid || flushPending)
+    if (flushPending || execute->isFlushPending())
+    {
+        return -1;
+    }
+    else if (loopBuffer != nullptr && loopBuffer->lookup(pc, inst))
+    {
+        replayLoopInst(pc, inst, fetched);
+        return 0;
+    }
+    else if (queueCount == 0)
+    {
+        return -1;
+    }
+    else if (!entry->valid)
     {
+        /* The memory is still waiting to return the line */
         return -1;
     }
-    else if (mem->getMemAccessWidthBaseByteAddr(pc) != instBufferBaseAddr)
+    else if (mem->getMemAccessWidthBaseByteAddr(pc) != entry->baseAddr)
     {
         fprintf(stderr,
                 "Unpredictable state: instruction buffer (0x%08" PRIX32
                 ") is valid and out of sync with pc (0x%08" PRIX32 ")\n",
-                instBufferBaseAddr,
+                entry->baseAddr,
                 mem->getMemAccessWidthBaseByteAddr(pc));
         exit(1);
     }
 
     /* Get the next instruction to decode */
-    inst = instBuffer[mem->getMemAccessWidthInstOffset(pc)];
+    fetched.inst = entry->insts[mem->getMemAccessWidthInstOffset(pc)];
+    fetched.addr = pc;
+    fetched.redirectCycle = cycle;
+    entry->fetched = true;
+
+    if (loopBuffer != nullptr)
+    {
+        loopBuffer->capture(pc, fetched.inst);
+        timeLoopIteration(pc, false);
+    }
+
+    if (entry->redirect && pc == entry->branchAddr)
+    {
+        /*
+         * Move the pc to the predicted target, whose line is the next one in
+         * the queue or the first requested after this one
+         */
+        pc = entry->target;
+        if (queueCount > 1)
+        {
+            fetched.redirectCycle = getQueueEntry(1)->requestCycle;
+        }
+
+        queueHead = (queueHead + 1) % queueSize;
+        queueCount--;
+
+        DEBUG_CMD(DEBUG_FETCH,
+                  printf("Fetch: predicted branch 0x%08" PRIX32
+                         " -> 0x%08" PRIX32 "\n",
+                         fetched.addr,
+                         pc));
+    }
+    else
+    {
+        /* Move the pc to the next instruction */
+        pc = NEXT_THUMB_INST(pc);
+
+        if (mem->getMemAccessWidthBaseByteAddr(pc) != entry->baseAddr)
+        {
+            /* Decode moves on to the next line in the queue */
+            queueHead = (queueHead + 1) % queueSize;
+            queueCount--;
+        }
+    }
 
-    /* Move the pc to the next instruction */
-    regFile->write(Reg::PC, NEXT_THUMB_INST(pc));
+    regFile->write(Reg::PC, pc);
+    fetched.nextAddr = pc;
 
     return 0;
 }
 
-int Fetch::run()
+/*
+ * Hand decode the instruction at pc from the loop buffer. The branch at the
+ * end of the loop is assumed to be taken, so the loop repeats until execute
+ * finds otherwise and flushes the pipeline. Other branches in the loop follow
+ * the predictor, if there is one
+ */
+void Fetch::replayLoopInst(uint32_t pc, uint16_t inst, FetchedInst &fetched)
 {
-    int ret;
-    uint32_t pc;
+    uint32_t target;
 
-    if (flushPending)
+    fetched.inst = inst;
+    fetched.addr = pc;
+    fetched.redirectCycle = cycle;
+
+    if (pc == loopBuffer->getStartAddr() ||
+        mem->getMemAccessWidthBaseByteAddr(pc) == pc)
+    {
+        /* Without the buffer the line would have been requested again */
+        stats->addLoopBufferSavedRequest();
+    }
+    timeLoopIteration(pc, true);
+
+    if (pc == loopBuffer->getEndAddr())
+    {
+        pc = loopBuffer->getStartAddr();
+    }
+    else if (predictor != nullptr && predictor->predict(pc, target))
     {
-        /* Flushing the instruction buffer */
-        instBufferValid = false;
-        instBufferBaseAddr = 0xFFFFFFFF;
-        memset(instBuffer,
-               0x0,
-               sizeof(uint16_t) * mem->getMemAccessWidthWords() * 2);
+        pc = target;
+    }
+    else
+    {
+        pc = NEXT_THUMB_INST(pc);
+    }
 
-        /* We no longer care about previously issued fetches */
-        issuedMemAccess = false;
+    regFile->write(Reg::PC, pc);
+    fetched.nextAddr = pc;
+}
 
-        flushPending = false;
+/* Compare the iterations replayed with the last one fetched from memory */
+void Fetch::timeLoopIteration(uint32_t pc, bool replayed)
+{
+    uint64_t iterationCycles;
+    uint64_t fetchedCycles;
 
-        DEBUG_CMD(DEBUG_FETCH, printf("Fetch: flushing\n"));
+    if (pc == loopBuffer->getStartAddr() &&
+        loopBuffer->startIteration(
+            cycle, replayed, iterationCycles, fetchedCycles))
+    {
+        stats->addLoopBufferIteration(iterationCycles, fetchedCycles);
     }
+}
 
-    /* Load the pc and  tuple metadata */
-    regFile->read(Reg::PC, pc);
+/*
+ * Discard the lines from the first one that a store modifies. Without a
+ * predictor the flush of the branch to the modified code refetches them, but
+ * a predicted branch does not flush the queue. The loop buffer forgets its
+ * loop if the store falls in it
+ */
+void Fetch::snoopStore(uint32_t byteAddr)
+{
+    uint32_t lineAddr = mem->getMemAccessWidthBaseByteAddr(byteAddr);
+    uint32_t i;
 
-    if (issuedMemAccess)
+    if (loopBuffer != nullptr)
     {
-        /* Check whether the data was loaded */
-        ret = mem->retrieveWideLoad(memToken,
-                                    reinterpret_cast<uint32_t *>(instBuffer));
-        if (ret == 0)
+        loopBuffer->invalidate(lineAddr, lineAddr + lineBytes - 1);
+    }
+
+    for (i = 0; i < queueCount; i++)
+    {
+        if (getQueueEntry(i)->baseAddr == lineAddr)
         {
-            instBufferValid = true;
-            instBufferBaseAddr = mem->getMemAccessWidthBaseByteAddr(pc);
-            issuedMemAccess = false;
+            discardQueueEntries(i);
+            return;
+        }
+    }
+}
+
+/* We no longer care about the lines requested before the flush */
+void Fetch::flushQueue()
+{
+    discardQueueEntries(0);
+
+    queueHead = 0;
+    filled = false;
+}
+
+/* Drop the lines of the queue from the one at index first onwards */
+void Fetch::discardQueueEntries(uint32_t first)
+{
+    uint32_t i;
+    FetchQueueEntry *entry;
+
+    for (i = first; i < queueCount; i++)
+    {
+        entry = getQueueEntry(i);
+        if (entry->issued)
+        {
+            mem->discard(entry->memToken);
+        }
+        if (!entry->fetched)
+        {
+            stats->addFetchQueueFlushedEntry();
+        }
+    }
+
+    queueCount = first;
+}
+
+void Fetch::retrieveQueueEntries()
+{
+    uint32_t i;
+    FetchQueueEntry *entry;
+
+    for (i = 0; i < queueCount; i++)
+    {
+        entry = getQueueEntry(i);
+        if (!entry->issued)
+        {
+            continue;
+        }
+        else if (mem->isRejected(entry->memToken))
+        {
+            /*
+             * Lost the arbitration, so the fetch has to be placed again even
+             * if the execute stage stalls in the meantime
+             */
+            entry->issued = false;
+            entry->rejected = true;
+
+            DEBUG_CMD(DEBUG_FETCH,
+                      printf("Fetch: memory request rejected\n"));
+        }
+        else if (mem->retrieveWideLoad(
+                     entry->memToken,
+                     reinterpret_cast<uint32_t *>(entry->insts)) == 0)
+        {
+            entry->issued = false;
+            entry->valid = true;
+            filled = true;
 
             DEBUG_CMD(DEBUG_FETCH, print());
         }
@@ -150,6 +392,205 @@ int Fetch::run()
             DEBUG_CMD(DEBUG_FETCH, printf("Fetch: memory reply not ready\n"));
         }
     }
+}
+
+/*
+ * Look up the branches predicted taken in the lines of the queue from the pc
+ * onwards. The lines that no longer follow the prediction, for example
+ * because the predictor changed its mind, are discarded
+ */
+void Fetch::predictQueueEntries(uint32_t pc)
+{
+    uint32_t i;
+    uint32_t addr;
+    uint32_t target;
+    uint32_t nextAddr = pc;
+    FetchQueueEntry *entry;
+
+    for (i = 0; i < queueCount; i++)
+    {
+        entry = getQueueEntry(i);
+        if (mem->getMemAccessWidthBaseByteAddr(nextAddr) != entry->baseAddr)
+        {
+            if (i > 0)
+            {
+                discardQueueEntries(i);
+                break;
+            }
+
+            /* The pc moved away before a flush, so look at the whole line */
+            nextAddr = entry->baseAddr;
+        }
+
+        entry->redirect = false;
+        for (addr = nextAddr; addr < entry->baseAddr + lineBytes;
+             addr = NEXT_THUMB_INST(addr))
+        {
+            if (predictor->predict(addr, target))
+            {
+                entry->redirect = true;
+                entry->branchAddr = addr;
+                entry->target = target;
+                break;
+            }
+        }
+
+        nextAddr = entry->redirect ? entry->target :
+                                     entry->baseAddr + lineBytes;
+    }
+}
+
+/*
+ * Place the request for the first of the queueDepth lines from the one of pc
+ * that is neither in the queue nor in flight. Only the line of pc waits for
+ * the execute stage, the ones after it are prefetched regardless. If pc was
+ * redirected to a predicted target its line goes after the one of the branch
+ */
+void Fetch::requestQueueEntries(uint32_t pc, bool redirected)
+{
+    uint32_t lineAddr = mem->getMemAccessWidthBaseByteAddr(pc);
+    uint32_t index = 0;
+    uint32_t i;
+    uint32_t token;
+    bool wanted = false;
+    FetchQueueEntry *entry = nullptr;
+    FetchQueueEntry *prevEntry;
+
+    if (redirected)
+    {
+        index = 1;
+    }
+    else if (queueCount > 0)
+    {
+        index = (lineAddr - getQueueEntry(0)->baseAddr) / lineBytes;
+    }
+
+    for (i = 0; i < queueDepth && index + i < queueSize; i++)
+    {
+        entry = (index + i < queueCount) ? getQueueEntry(index + i) :
+                                           nullptr;
+        if (entry != nullptr && entry->valid)
+        {
+            continue;
+        }
+        else if (i == 0 && filled && (entry == nullptr || !entry->rejected) &&
+                 execute->isStalled())
+        {
+            /*
+             * If we were to fetch when the execution unit is stalled, then we
+             * might have to discard the fetched data, so the line of the next
+             * instruction is only requested when the pipeline moves on. The
+             * lines after it cannot be queued before it
+             */
+            if (entry == nullptr)
+            {
+                break;
+            }
+            continue;
+        }
+
+        wanted = true;
+        if (entry == nullptr || entry->rejected)
+        {
+            /* This line is the next one to request */
+            break;
+        }
+    }
+
+    if (!wanted)
+    {
+        DEBUG_CMD(DEBUG_FETCH, printf("Fetch: stalled\n"));
+        return;
+    }
+
+    /* Record that this fetch required a memory access */
+    stats->addFetchCycle();
+
+    if (i == queueDepth || index + i == queueSize)
+    {
+        /* The lines are in flight, wait for the memory to return them */
+        return;
+    }
+
+    if (i > 0 && entry != nullptr)
+    {
+        /* Request the rejected line again from its start */
+        pc = entry->baseAddr;
+    }
+    else if (i > 0)
+    {
+        /* Prefetch the line that follows the last one in the queue */
+        prevEntry = getQueueEntry(queueCount - 1);
+        pc = prevEntry->redirect ?
+            mem->getMemAccessWidthBaseByteAddr(prevEntry->target) :
+            prevEntry->baseAddr + lineBytes;
+    }
+
+    if (mem->requestLoad(Component::FETCH, pc, token) != 0)
+    {
+        /* The memory port is busy with other requests */
+        stats->addFetchStallForMemCycle();
+
+        DEBUG_CMD(DEBUG_FETCH,
+                  printf("Fetch: Could not create memory request\n"));
+        return;
+    }
+
+    if (entry == nullptr)
+    {
+        entry = getQueueEntry(queueCount);
+        entry->baseAddr = mem->getMemAccessWidthBaseByteAddr(pc);
+        entry->valid = false;
+        entry->fetched = false;
+        entry->redirect = false;
+        entry->requestCycle = cycle;
+        queueCount++;
+    }
+    entry->memToken = token;
+    entry->issued = true;
+    entry->rejected = false;
+
+    DEBUG_CMD(DEBUG_FETCH,
+              printf("Fetch: requested from pc %08" PRIX32 "\n", pc));
+}
+
+int Fetch::run()
+{
+    uint32_t pc;
+    uint16_t inst;
+    bool redirected = false;
+    FetchQueueEntry *entry;
+
+    if (flushPending)
+    {
+        /* Flushing the instruction queue */
+        flushQueue();
+        flushPending = false;
+
+        DEBUG_CMD(DEBUG_FETCH, printf("Fetch: flushing\n"));
+    }
+
+    /* Check whether the requested lines were loaded */
+    retrieveQueueEntries();
+
+    /* Load the pc and  tuple metadata */
+    regFile->read(Reg::PC, pc);
+
+    if (loopBuffer != nullptr && loopBuffer->lookup(pc, inst))
+    {
+        /* Decode takes the instructions of the loop from the buffer */
+        flushQueue();
+
+        stats->addFetchQueueEntries(queueCount);
+        cycle++;
+
+        return 0;
+    }
+
+    if (predictor != nullptr)
+    {
+        predictQueueEntries(pc);
+    }
 
     /*
      * We want to start a fetch whenever:
@@ -159,7 +600,7 @@ int Fetch::run()
      * early, so we make the pc point to the next instruction instead of the
      * one currently being decoded
      */
-    if (instBufferValid)
+    if (filled && queueCount > 0)
     {
         /*
          * Fetch operations take at least two cycles:
@@ -171,46 +612,28 @@ int Fetch::run()
          * pointing to the last instruction in the instruction buffer and
          * the execution unit is not currently stalled.
          *
-         * Note that if we were to fetch when the execution unit is stalled,
-         * then we would have to discard the fetched data, meaning that there
-         * could potentially be several unecessary memory requests.
-         *
          * Note that this trick only works if the instruction buffer is at
          * least one word in length, otherwise the pc base address will be
          * different when we get the memory response
          */
-        pc = NEXT_THUMB_INST(pc);
-    }
-
-    if (!instBufferValid ||
-        (!execute->isStalled() &&
-         mem->getMemAccessWidthBaseByteAddr(pc) != instBufferBaseAddr))
-    {
-        /* In this case, we need to start a fetch from memory */
-
-        /* Issue a load request */
-        ret = mem->requestLoad(Component::FETCH, pc, memToken);
-        if (ret == 0)
+        entry = getQueueEntry(0);
+        if (entry->redirect && pc == entry->branchAddr)
         {
-            /* Memory device busy, cannot issue fetch request */
-            issuedMemAccess = true;
-
-            DEBUG_CMD(DEBUG_FETCH,
-                      printf("Fetch: requested from pc %08" PRIX32 "\n", pc));
+            /* The next instruction is the target of a predicted branch */
+            pc = entry->target;
+            redirected = true;
         }
         else
         {
-            DEBUG_CMD(DEBUG_FETCH,
-                      printf("Fetch: Could not create memory request\n"));
+            pc = NEXT_THUMB_INST(pc);
         }
-
-        /* Record that this fetch required a memory access */
-        stats->addFetchCycle();
-    }
-    else
-    {
-        DEBUG_CMD(DEBUG_FETCH, printf("Fetch: stalled\n"));
     }
 
+    requestQueueEntries(pc, redirected);
+
+    stats->addFetchQueueEntries(queueCount);
+
+    cycle++;
+
     return 0;
 }
@@ -0,0 +1,153 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "simulator/loopbuffer.h"
+
+#include "simulator/utils.h"
+
+#include <cstdint>
+
+LoopBuffer::LoopBuffer(uint32_t entriesIn) : entries(entriesIn)
+{
+    uint32_t i;
+
+    insts = new uint16_t[entries];
+    captured = new bool[entries];
+
+    for (i = 0; i < entries; i++)
+    {
+        insts[i] = 0;
+        captured[i] = false;
+    }
+}
+
+LoopBuffer::~LoopBuffer()
+{
+    delete[] insts;
+    delete[] captured;
+}
+
+/*
+ * Called when the branch at branchAddr is taken backwards. If the loop fits,
+ * it replaces the one in the buffer and is captured in the next iteration
+ */
+void LoopBuffer::recordLoop(uint32_t branchAddr, uint32_t target)
+{
+    uint32_t i;
+
+    if (target > branchAddr || ((branchAddr - target) >> 1) >= entries)
+    {
+        return;
+    }
+    else if (valid && startAddr == target && endAddr == branchAddr)
+    {
+        /* The loop is already in the buffer */
+        return;
+    }
+
+    for (i = 0; i < entries; i++)
+    {
+        captured[i] = false;
+    }
+
+    valid = true;
+    startAddr = target;
+    endAddr = branchAddr;
+    capturedCount = 0;
+    iterationStarted = false;
+    fetchedIterationCycles = 0;
+}
+
+/* Record a halfword that fetch took from memory */
+void LoopBuffer::capture(uint32_t addr, uint16_t inst)
+{
+    uint32_t index;
+
+    if (!contains(addr))
+    {
+        /* The program left the loop, so the iteration cannot be timed */
+        iterationStarted = false;
+        return;
+    }
+
+    index = getIndex(addr);
+    if (!captured[index])
+    {
+        captured[index] = true;
+        capturedCount++;
+    }
+    insts[index] = inst;
+}
+
+/* Get the halfword at addr if the whole loop that holds it was captured */
+bool LoopBuffer::lookup(uint32_t addr, uint16_t &inst)
+{
+    if (!contains(addr) || capturedCount != getIndex(endAddr) + 1)
+    {
+        return false;
+    }
+
+    inst = insts[getIndex(addr)];
+
+    return true;
+}
+
+/* Forget the loop if a store modified any of its halfwords */
+void LoopBuffer::invalidate(uint32_t baseByteAddr, uint32_t endByteAddr)
+{
+    if (valid && baseByteAddr <= NEXT_THUMB_INST(endAddr) - 1 &&
+        endByteAddr >= startAddr)
+    {
+        valid = false;
+    }
+}
+
+/*
+ * Called when fetch hands the first halfword of the loop to decode. Returns
+ * true when a replayed iteration finished and the last iteration fetched
+ * from memory is known, in which case both durations are given in cycles
+ */
+bool LoopBuffer::startIteration(uint64_t cycle,
+                                bool replayed,
+                                uint64_t &iterationCycles,
+                                uint64_t &fetchedCycles)
+{
+    bool timed = false;
+
+    if (iterationStarted && !iterationReplayed)
+    {
+        fetchedIterationCycles = cycle - iterationStart;
+    }
+    else if (iterationStarted && fetchedIterationCycles != 0)
+    {
+        iterationCycles = cycle - iterationStart;
+        fetchedCycles = fetchedIterationCycles;
+        timed = true;
+    }
+
+    iterationStarted = true;
+    iterationReplayed = replayed;
+    iterationStart = cycle;
+
+    return timed;
+}
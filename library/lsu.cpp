@@ -30,7 +30,6 @@
 #include <cinttypes>
 #include <cstdint>
 #include <cstdlib>
-#include <list>
 
 void Execute::formatDataForMemLoad(MemoryInstructionType type,
                                    uint32_t &data,
@@ -68,13 +67,16 @@ void Execute::formatDataForMemLoad(MemoryInstructionType type,
     }
 }
 
+/*
+ * Move the register data to the byte lanes written by the store, which are
+ * returned in byteEnable so that the memory merges them into the word
+ */
 void Execute::formatDataForMemStore(MemoryInstructionType type,
-                                    uint32_t data,
                                     uint32_t &drt,
+                                    uint32_t &byteEnable,
                                     uint32_t offset)
 {
     uint32_t byteOffset = GET_BYTE_INDEX(offset);
-    uint32_t mask;
 
     switch (type)
     {
@@ -85,10 +87,9 @@ void Execute::formatDataForMemStore(MemoryInstructionType type,
             exit(1);
 
         case MemoryInstructionType::UBYTE:
+            byteEnable = 0x1 << byteOffset;
             byteOffset = byteOffset * BITS_PER_BYTE;
-            mask = (0x1 << BITS_PER_BYTE) - 1;
-            data = data & ~(mask << byteOffset);
-            drt = data | ((drt & mask) << byteOffset);
+            drt = (drt & ((0x1 << BITS_PER_BYTE) - 1)) << byteOffset;
             break;
 
         case MemoryInstructionType::SHALFWORD:
@@ -98,19 +99,40 @@ void Execute::formatDataForMemStore(MemoryInstructionType type,
             exit(1);
 
         case MemoryInstructionType::UHALFWORD:
-            byteOffset = (byteOffset & ~0x1) * BITS_PER_BYTE;
-            mask = (0x1 << BITS_PER_HALFWORD) - 1;
-            data = data & ~(mask << byteOffset);
-            drt = data | ((drt & mask) << byteOffset);
+            byteOffset = byteOffset & ~0x1;
+            byteEnable = 0x3 << byteOffset;
+            byteOffset = byteOffset * BITS_PER_BYTE;
+            drt = (drt & ((0x1 << BITS_PER_HALFWORD) - 1)) << byteOffset;
             break;
 
         case MemoryInstructionType::WORD:
-            /* Data and pflag remain unchanged here */
-            // drt = drt;
+            /* Data remains unchanged here */
+            byteEnable = MEM_BYTE_ENABLE_WORD;
             break;
     }
 }
 
+/* Byte lanes of the word that a load of this type reads */
+uint32_t Execute::getLoadByteEnable(MemoryInstructionType type,
+                                    uint32_t offset)
+{
+    uint32_t byteOffset = GET_BYTE_INDEX(offset);
+
+    switch (type)
+    {
+        case MemoryInstructionType::SBYTE:
+        case MemoryInstructionType::UBYTE:
+            return 0x1 << byteOffset;
+
+        case MemoryInstructionType::SHALFWORD:
+        case MemoryInstructionType::UHALFWORD:
+            return 0x3 << (byteOffset & ~0x1);
+
+        default:
+            return MEM_BYTE_ENABLE_WORD;
+    }
+}
+
 int Execute::ldr(Reg rt,
                  uint32_t drn,
                  uint32_t offset,
@@ -121,6 +143,11 @@ int Execute::ldr(Reg rt,
     loadTmps.type = type;
     loadTmps.destReg = rt;
 
+    if (functional)
+    {
+        return executeLoadFunctional();
+    }
+
     return executeLoadMemReq();
 }
 
@@ -238,6 +265,17 @@ int Execute::str(Reg rt,
     storeTmps.dataReg = rt;
     storeTmps.addrReg = rn;
 
+    /* Formatted once, so the request can be placed again if it is rejected */
+    formatDataForMemStore(storeTmps.type,
+                          storeTmps.data,
+                          storeTmps.byteEnable,
+                          storeTmps.byteOffset);
+
+    if (functional)
+    {
+        return executeStoreFunctional();
+    }
+
     return executeStoreMemReq();
 }
 
@@ -314,7 +352,14 @@ int Execute::popLdmia(Reg rn, uint32_t drn, uint32_t rl)
     mloadTmps.byteOffset = 0;
     populateRegisterList(mloadTmps.regList, rl);
 
-    executeMultipleLoadFirstMemReq();
+    if (functional)
+    {
+        executeMultipleLoadFunctional();
+    }
+    else
+    {
+        executeMultipleLoadFirstMemReq();
+    }
 
     /* Record the instruction stats */
     stats->addInstruction(Instruction::LDMIA);
@@ -323,12 +368,9 @@ int Execute::popLdmia(Reg rn, uint32_t drn, uint32_t rl)
     return 0;
 }
 
-void Execute::populateRegisterList(std::list<Reg> &regList, uint32_t rl)
+void Execute::populateRegisterList(uint32_t &regList, uint32_t rl)
 {
-    uint32_t i;
-    Reg reg;
-
-    if (!regList.empty())
+    if (regList != 0)
     {
         fprintf(stderr,
                 "Starting multiple memory access without empty "
@@ -336,18 +378,9 @@ void Execute::populateRegisterList(std::list<Reg> &regList, uint32_t rl)
         exit(1);
     }
 
-    for (i = 0; i < REGFILE_CORE_REGS_COUNT; i++)
-    {
-        if (GET_BIT_AT_POS(rl, i) == 0x0)
-        {
-            continue;
-        }
-
-        reg = RegFile::uint32ToReg(i);
-        regList.push_back(reg);
-    }
+    regList = rl & ((0x1 << REGFILE_CORE_REGS_COUNT) - 1);
 
-    if (regList.empty())
+    if (regList == 0)
     {
         fprintf(stderr,
                 "%s:%d:Multiple memory access instruction has empty "
@@ -358,6 +391,19 @@ void Execute::populateRegisterList(std::list<Reg> &regList, uint32_t rl)
     }
 }
 
+/*
+ * Registers are transferred in ascending order, so the next one is always the
+ * lowest bit that is still set in the list
+ */
+Reg Execute::popRegisterList(uint32_t &regList)
+{
+    Reg reg = RegFile::uint32ToReg(GET_LOWEST_SET_BIT_POS(regList));
+
+    regList = CLEAR_LOWEST_SET_BIT(regList);
+
+    return reg;
+}
+
 int Execute::stmia(Reg rn, uint32_t drn, uint32_t rl)
 {
     mstoreTmps.baseReg = rn;
@@ -366,7 +412,14 @@ int Execute::stmia(Reg rn, uint32_t drn, uint32_t rl)
     mstoreTmps.op = DecodedOperation::STMIA;
     populateRegisterList(mstoreTmps.regList, rl);
 
-    executeMultipleStoreFirstMemReq();
+    if (functional)
+    {
+        executeMultipleStoreFunctional();
+    }
+    else
+    {
+        executeMultipleStoreFirstMemReq();
+    }
 
     /* Record the instruction stats */
     stats->addInstruction(Instruction::STMIA);
@@ -383,7 +436,14 @@ int Execute::push(Reg rn, uint32_t drn, uint32_t rl)
     mstoreTmps.op = DecodedOperation::PUSH;
     populateRegisterList(mstoreTmps.regList, rl);
 
-    executeMultipleStoreFirstMemReq();
+    if (functional)
+    {
+        executeMultipleStoreFunctional();
+    }
+    else
+    {
+        executeMultipleStoreFirstMemReq();
+    }
 
     /* Record the instruction stats */
     stats->addInstruction(Instruction::PUSH);
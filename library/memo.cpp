@@ -0,0 +1,244 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "simulator/memo.h"
+
+#include "simulator/blockcache.h"
+#include "simulator/config.h"
+#include "simulator/decode.h"
+#include "simulator/regfile.h"
+
+#include <cstddef>
+#include <cstdint>
+
+TimingMemo::TimingMemo(uint32_t verifyIntervalIn) :
+    verifyInterval(verifyIntervalIn)
+{
+    entries = new MemoizedBlock[TIMING_MEMO_ENTRIES];
+}
+
+TimingMemo::~TimingMemo()
+{
+    delete[] entries;
+}
+
+MemoizedBlock *TimingMemo::lookup(uint32_t startAddr)
+{
+    MemoizedBlock *entry;
+
+    entry = &entries[(startAddr >> 1) & (TIMING_MEMO_ENTRIES - 1)];
+    if (!entry->valid || entry->startAddr != startAddr)
+    {
+        return nullptr;
+    }
+
+    return entry;
+}
+
+/* Get the entry for the block evicting whatever was there */
+MemoizedBlock *TimingMemo::allocate(uint32_t startAddr)
+{
+    MemoizedBlock *entry;
+
+    entry = &entries[(startAddr >> 1) & (TIMING_MEMO_ENTRIES - 1)];
+    entry->valid = true;
+    entry->memoizable = false;
+    entry->timed = false;
+    entry->startAddr = startAddr;
+    entry->visits = 0;
+
+    return entry;
+}
+
+/*
+ * Count a visit to the block. Returns true if the memoized counters can be
+ * charged and false if the block has to be simulated in full
+ */
+bool TimingMemo::replayVisit(MemoizedBlock *entry)
+{
+    entry->visits++;
+
+    if (!entry->memoizable || !entry->timed)
+    {
+        return false;
+    }
+
+    return verifyInterval == 0 || entry->visits % verifyInterval != 0;
+}
+
+/*
+ * Keep the counters of a block simulated in full from start to end. Returns
+ * false if they differ from the counters memoized earlier
+ */
+bool TimingMemo::record(MemoizedBlock *entry,
+                        PipelineCounters &start,
+                        PipelineCounters &end)
+{
+    PipelineCounters counters;
+    bool match;
+
+    counters.cycles = end.cycles - start.cycles;
+    counters.fetchMemCycles = end.fetchMemCycles - start.fetchMemCycles;
+    counters.executeMemCycles = end.executeMemCycles - start.executeMemCycles;
+    counters.stalledForDecodeCycles =
+        end.stalledForDecodeCycles - start.stalledForDecodeCycles;
+    counters.fetchStalledForMemCycles =
+        end.fetchStalledForMemCycles - start.fetchStalledForMemCycles;
+    counters.executeStalledForMemCycles =
+        end.executeStalledForMemCycles - start.executeStalledForMemCycles;
+    counters.memWaitCycles = end.memWaitCycles - start.memWaitCycles;
+    counters.fetchQueueEntries =
+        end.fetchQueueEntries - start.fetchQueueEntries;
+    counters.fetchQueueFlushedEntries =
+        end.fetchQueueFlushedEntries - start.fetchQueueFlushedEntries;
+
+    match = !entry->timed ||
+        (counters.cycles == entry->counters.cycles &&
+         counters.fetchMemCycles == entry->counters.fetchMemCycles &&
+         counters.executeMemCycles == entry->counters.executeMemCycles &&
+         counters.stalledForDecodeCycles ==
+             entry->counters.stalledForDecodeCycles &&
+         counters.fetchStalledForMemCycles ==
+             entry->counters.fetchStalledForMemCycles &&
+         counters.executeStalledForMemCycles ==
+             entry->counters.executeStalledForMemCycles &&
+         counters.memWaitCycles == entry->counters.memWaitCycles &&
+         counters.fetchQueueEntries == entry->counters.fetchQueueEntries &&
+         counters.fetchQueueFlushedEntries ==
+             entry->counters.fetchQueueFlushedEntries);
+
+    entry->counters = counters;
+    entry->timed = true;
+
+    return match;
+}
+
+/* Add the memoized counters of the block to the running counters */
+void TimingMemo::charge(MemoizedBlock *entry, PipelineCounters &counters)
+{
+    counters.cycles += entry->counters.cycles;
+    counters.fetchMemCycles += entry->counters.fetchMemCycles;
+    counters.executeMemCycles += entry->counters.executeMemCycles;
+    counters.stalledForDecodeCycles += entry->counters.stalledForDecodeCycles;
+    counters.fetchStalledForMemCycles +=
+        entry->counters.fetchStalledForMemCycles;
+    counters.executeStalledForMemCycles +=
+        entry->counters.executeStalledForMemCycles;
+    counters.memWaitCycles += entry->counters.memWaitCycles;
+    counters.fetchQueueEntries += entry->counters.fetchQueueEntries;
+    counters.fetchQueueFlushedEntries +=
+        entry->counters.fetchQueueFlushedEntries;
+}
+
+void TimingMemo::invalidate()
+{
+    size_t i;
+
+    for (i = 0; i < TIMING_MEMO_ENTRIES; i++)
+    {
+        entries[i].valid = false;
+    }
+}
+
+/*
+ * Whether the timing of the block is fixed. The block cannot access memory
+ * or print, and it must end with the only branch in it, which flushes the
+ * pipeline when taken
+ */
+bool TimingMemo::isMemoizable(PredecodedBlock &block)
+{
+    uint32_t i;
+    DecodedInst *inst;
+
+    if (!block.valid)
+    {
+        return false;
+    }
+
+    for (i = 0; i < block.instCount; i++)
+    {
+        inst = &block.insts[i];
+        switch (inst->getOperation())
+        {
+            case DecodedOperation::B1:
+            case DecodedOperation::B2:
+            case DecodedOperation::BL:
+            case DecodedOperation::BLX:
+            case DecodedOperation::BX:
+                if (i + 1 != block.instCount)
+                {
+                    return false;
+                }
+                break;
+
+            case DecodedOperation::ADD4:
+                if (inst->getRegisterNumber(DecodedInstRegIndex::RDN) ==
+                    Reg::PC)
+                {
+                    return false;
+                }
+                break;
+
+            case DecodedOperation::CPY:
+                if (inst->getRegisterNumber(DecodedInstRegIndex::RD) ==
+                    Reg::PC)
+                {
+                    return false;
+                }
+                break;
+
+            case DecodedOperation::BKPT:
+            case DecodedOperation::CPS:
+            case DecodedOperation::LDMIA:
+            case DecodedOperation::LDR1:
+            case DecodedOperation::LDR2:
+            case DecodedOperation::LDR3:
+            case DecodedOperation::LDR4:
+            case DecodedOperation::LDRB1:
+            case DecodedOperation::LDRB2:
+            case DecodedOperation::LDRH1:
+            case DecodedOperation::LDRH2:
+            case DecodedOperation::LDRSB:
+            case DecodedOperation::LDRSH:
+            case DecodedOperation::POP:
+            case DecodedOperation::PUSH:
+            case DecodedOperation::STMIA:
+            case DecodedOperation::STR1:
+            case DecodedOperation::STR2:
+            case DecodedOperation::STR3:
+            case DecodedOperation::STRB1:
+            case DecodedOperation::STRB2:
+            case DecodedOperation::STRH1:
+            case DecodedOperation::STRH2:
+            case DecodedOperation::SVC:
+                return false;
+
+            default:
+                break;
+        }
+    }
+
+    /* Blocks that are cut short do not end with a branch */
+    return BlockCache::endsBlock(
+        block.insts[block.instCount - 1].getOperation());
+}
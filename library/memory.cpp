@@ -24,19 +24,29 @@
 #include "simulator/memory.h"
 
 #include "simulator/debug.h"
+#include "simulator/stats.h"
 #include "simulator/utils.h"
 
+#include <algorithm>
+#include <cerrno>
 #include <cinttypes>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <fstream>
-#include <iostream>
+#include <fcntl.h>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 Memory::Memory(uint32_t memSizeWordsIn,
                uint32_t memAccessWidthWordsIn,
-               uint32_t pipelineSizeIn)
+               uint32_t latencyCyclesIn,
+               uint32_t maxOutstandingIn,
+               Statistics *statsIn) :
+    latencyCycles(latencyCyclesIn),
+    maxOutstanding(maxOutstandingIn),
+    stats(statsIn)
 {
     uint32_t i;
 
@@ -47,28 +57,67 @@ Memory::Memory(uint32_t memSizeWordsIn,
         memSizeWords = memSizeWords + memAccessWidthWords -
             (memSizeWordsIn % memAccessWidthWords);
     }
-    mem = new uint32_t[memSizeWords];
 
-    for (i = 0; i < memSizeWords; i++)
+    if (memSizeWords > MEM_MAX_SIZE_WORDS)
     {
-        mem[i] = 0;
+        fprintf(stderr,
+                "Memory size of %" PRIu32 " words exceeds the %" PRIu32
+                " words of the address space\n",
+                memSizeWords,
+                MEM_MAX_SIZE_WORDS);
+        exit(1);
+    }
+    else if (MEM_CHUNK_WORDS % memAccessWidthWords > 0)
+    {
+        fprintf(stderr,
+                "Memory access width of %" PRIu32 " words does not divide "
+                "the chunk size of %" PRIu32 " words\n",
+                memAccessWidthWords,
+                MEM_CHUNK_WORDS);
+        exit(1);
+    }
+    else if (latencyCycles == 0 || maxOutstanding == 0)
+    {
+        fprintf(stderr,
+                "Memory needs a latency and outstanding requests of at least "
+                "1\n");
+        exit(1);
     }
 
-    /* The +1 is to not clear served responses early */
-    pipeline = new MemoryRequest[pipelineSizeIn + 1];
-    pipelineSize = pipelineSizeIn + 1;
-    nextReqIndex = 0;
+    /*
+     * Responses wait for their issuer in as many extra entries as there can
+     * be requests in flight
+     */
+    portRequestsSize = maxOutstanding * 2;
+    requestsSize = portRequestsSize * MEM_PORT_COUNT;
+    requests = new MemoryRequest[requestsSize];
     nextToken = 0;
 
-    for (i = 0; i < pipelineSize; i++)
+    for (i = 0; i < MEM_PORT_COUNT; i++)
     {
-        pipeline[i].issuer = Component::NONE;
-        pipeline[i].type = MemoryAccessType::NONE;
-        pipeline[i].token = 0;
-        pipeline[i].byteAddr = 0;
-        pipeline[i].reqData = new uint32_t[memAccessWidthWords];
-        pipeline[i].reqEnable = new bool[memAccessWidthWords];
-        pipeline[i].respData = new uint32_t[memAccessWidthWords];
+        ports[i].requestsBase = i * portRequestsSize;
+        ports[i].inFlight = new uint32_t[maxOutstanding];
+        ports[i].inFlightHead = 0;
+        ports[i].inFlightCount = 0;
+        ports[i].lastGranted = Component::NONE;
+        ports[i].bidCount = 0;
+        ports[i].lastBid = nullptr;
+    }
+
+    for (i = 0; i < requestsSize; i++)
+    {
+        requests[i].issuer = Component::NONE;
+        requests[i].type = MemoryAccessType::NONE;
+        requests[i].token = 0;
+        requests[i].byteAddr = 0;
+        requests[i].waitCycles = 0;
+        requests[i].latencyCycles = 0;
+        requests[i].granted = false;
+        requests[i].completed = false;
+        requests[i].discarded = false;
+        requests[i].reqData = new uint32_t[memAccessWidthWords];
+        requests[i].reqEnable = new uint8_t[memAccessWidthWords];
+        requests[i].respData = new uint32_t[memAccessWidthWords];
     }
 }
 
@@ -76,187 +125,976 @@ Memory::~Memory()
 {
     uint32_t i;
 
-    delete mem;
+    for (i = 0; i < MEM_CHUNK_COUNT; i++)
+    {
+        if (chunks[i] != nullptr)
+        {
+            munmap(chunks[i], WORD_TO_BYTE_SIZE(MEM_CHUNK_WORDS));
+        }
+    }
+
+    for (i = 0; i < requestsSize; i++)
+    {
+        delete[] requests[i].reqData;
+        delete[] requests[i].reqEnable;
+        delete[] requests[i].respData;
+    }
+    delete[] requests;
+    for (i = 0; i < MEM_PORT_COUNT; i++)
+    {
+        delete[] ports[i].inFlight;
+    }
+
+    delete instCache;
+    delete dataCache;
+    delete fetchAccelerator;
+}
+
+/* Find the chunk that holds the words from chunkIndex * MEM_CHUNK_WORDS */
+uint32_t *Memory::lookupChunk(uint32_t chunkIndex)
+{
+    void *chunk;
 
-    for (i = 0; i < pipelineSize; i++)
+    if (chunks[chunkIndex] == nullptr)
     {
-        delete pipeline[i].reqData;
-        delete pipeline[i].reqEnable;
-        delete pipeline[i].respData;
+        chunk = mmap(nullptr,
+                     WORD_TO_BYTE_SIZE(MEM_CHUNK_WORDS),
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                     -1,
+                     0);
+        if (chunk == MAP_FAILED)
+        {
+            fprintf(stderr,
+                    "Failed to map memory chunk %" PRIu32 ": %s\n",
+                    chunkIndex,
+                    strerror(errno));
+            exit(1);
+        }
+        chunks[chunkIndex] = static_cast<uint32_t *>(chunk);
     }
-    delete pipeline;
+
+    return chunks[chunkIndex];
 }
 
+/*
+ * The program binary is mapped copy-on-write over the memory chunks, so that
+ * only the pages of the binary that are touched are ever read from the file
+ */
 int Memory::loadProgram(char *programFile,
                         uint32_t &pc,
                         uint32_t &programByteSize)
 {
     int ret = -1;
     uint32_t addr = 0x00000000;
-    std::ifstream inBin{ programFile,
-                         std::ios::in | std::ios::binary | std::ios::ate };
-    std::streampos binSize;
+    uint32_t offset;
+    uint32_t chunkSize;
+    uint32_t hostPageSize = static_cast<uint32_t>(sysconf(_SC_PAGESIZE));
+    uint32_t mapSize;
+    uint64_t binSize;
+    struct stat binStat;
+    int fd;
 
-    if (!inBin.is_open())
+    fd = open(programFile, O_RDONLY);
+    if (fd < 0)
     {
         fprintf(stderr, "Could not open '%s'\n", programFile);
         return ret;
     }
 
-    binSize = inBin.tellg();
-    if (binSize >= WORD_TO_BYTE_SIZE(memSizeWords))
+    if (fstat(fd, &binStat) != 0)
     {
-        std::cerr << "Program binary is too large for memory (" << binSize
-                  << " bytes, " << BYTE_TO_WORD_SIZE(binSize) << " words)"
-                  << std::endl;
+        fprintf(stderr, "Could not get the size of '%s'\n", programFile);
         goto exit;
     }
 
-    /* Allocate space for the program binary */
-    inBin.seekg(0, std::ios::beg);
-    inBin.read(reinterpret_cast<char *>(mem + GET_WORD_INDEX(addr)), binSize);
-    if (binSize != inBin.gcount())
+    binSize = static_cast<uint64_t>(binStat.st_size);
+    if (binSize >= WORD_TO_BYTE_SIZE(static_cast<uint64_t>(memSizeWords)))
     {
-        fprintf(stderr, "Failed to read full program binary\n");
+        fprintf(stderr,
+                "Program binary is too large for memory (%" PRIu64
+                " bytes, %" PRIu64 " words)\n",
+                binSize,
+                BYTE_TO_WORD_SIZE(binSize));
         goto exit;
     }
 
-    programByteSize = binSize;
+    /* Map the binary one chunk at a time, rounding up to whole host pages */
+    for (offset = 0; offset < binSize; offset += chunkSize)
+    {
+        chunkSize = static_cast<uint32_t>(
+            std::min(binSize - offset,
+                     static_cast<uint64_t>(
+                         WORD_TO_BYTE_SIZE(MEM_CHUNK_WORDS))));
+        mapSize = (chunkSize + hostPageSize - 1) & ~(hostPageSize - 1);
+        if (mmap(getWordPtr(GET_WORD_INDEX(addr + offset)),
+                 mapSize,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_FIXED,
+                 fd,
+                 offset) == MAP_FAILED)
+        {
+            fprintf(stderr,
+                    "Failed to map program binary: %s\n",
+                    strerror(errno));
+            goto exit;
+        }
+    }
+
+    programByteSize = static_cast<uint32_t>(binSize);
+    programMapBytes = static_cast<uint32_t>((binSize + hostPageSize - 1) &
+                                            ~(hostPageSize - 1));
 
     /*
      * Load the program counter from the second entry in the vector table into
      * PC.
      */
-    pc = mem[GET_WORD_INDEX(addr + RESET_VECTOR_PC_ADDRESS)];
+    pc = *getWordPtr(GET_WORD_INDEX(addr + RESET_VECTOR_PC_ADDRESS));
 
     ret = 0;
 
 exit:
-    inBin.close();
+    close(fd);
 
     return ret;
 }
 
-int Memory::requestLoad(Component issuer, uint32_t byteAddr, uint32_t &token)
+/*
+ * Read the regions from a text file with one region per line in the format
+ *     <base> <size> <read latency> <write latency> <access width> [ro]
+ * Numbers can be decimal or hexadecimal and comments start with #
+ */
+int Memory::loadRegionMap(char *regionMapFile)
 {
-    if (pipeline[nextReqIndex].issuer != Component::NONE)
+    int ret = -1;
+    FILE *file;
+    char line[256];
+    char *comment;
+    char flag[8];
+    int fields;
+    uint32_t lineNum = 0;
+    long long base;
+    long long size;
+    unsigned int readLatency;
+    unsigned int writeLatency;
+    unsigned int accessWidthWords;
+    MemoryRegion region;
+    std::size_t i;
+
+    file = fopen(regionMapFile, "r");
+    if (file == nullptr)
     {
-        /* Cannot place more than one requests in the same cycle */
-        return -1;
+        fprintf(stderr, "Could not open '%s'\n", regionMapFile);
+        return ret;
     }
 
-    pipeline[nextReqIndex].issuer = issuer;
-    pipeline[nextReqIndex].type = MemoryAccessType::LOAD;
-    pipeline[nextReqIndex].token = nextToken;
-    pipeline[nextReqIndex].byteAddr = byteAddr;
+    while (fgets(line, sizeof(line), file) != nullptr)
+    {
+        lineNum++;
+        comment = strchr(line, '#');
+        if (comment != nullptr)
+        {
+            *comment = '\0';
+        }
+
+        if (line[strspn(line, " \t\r\n")] == '\0')
+        {
+            /* Empty line */
+            continue;
+        }
+
+        flag[0] = '\0';
+        fields = sscanf(line,
+                        "%lli %lli %u %u %u %7s",
+                        &base,
+                        &size,
+                        &readLatency,
+                        &writeLatency,
+                        &accessWidthWords,
+                        flag);
+        if (fields < 5 || base < 0 || size <= 0 ||
+            base + size > (1LL << 32) || accessWidthWords == 0 ||
+            (fields == 6 && strcmp(flag, "ro") != 0))
+        {
+            fprintf(stderr,
+                    "Invalid memory region at %s:%" PRIu32 "\n",
+                    regionMapFile,
+                    lineNum);
+            goto exit;
+        }
+
+        /* Regions cannot overlap as an address only maps to one */
+        for (i = 0; i < regionMap.size(); i++)
+        {
+            if (base < static_cast<long long>(regionMap[i].endByteAddr) &&
+                base + size > regionMap[i].baseByteAddr)
+            {
+                fprintf(stderr,
+                        "Invalid memory region at %s:%" PRIu32 "\n",
+                        regionMapFile,
+                        lineNum);
+                goto exit;
+            }
+        }
+
+        region.baseByteAddr = static_cast<uint32_t>(base);
+        region.endByteAddr = static_cast<uint64_t>(base + size);
+        region.readLatency = readLatency;
+        region.writeLatency = writeLatency;
+        region.accessWidthWords = accessWidthWords;
+        region.readOnly = fields == 6;
+        regionMap.push_back(region);
+    }
 
+    ret = 0;
+
+exit:
+    fclose(file);
+
+    return ret;
+}
+
+MemoryRegion *Memory::findRegion(uint32_t byteAddr)
+{
+    std::size_t i;
+
+    for (i = 0; i < regionMap.size(); i++)
+    {
+        if (byteAddr >= regionMap[i].baseByteAddr &&
+            byteAddr < regionMap[i].endByteAddr)
+        {
+            return &regionMap[i];
+        }
+    }
+
+    return nullptr;
+}
+
+/* Cycles that an access waits before it is served */
+uint32_t Memory::getWaitCycles(uint32_t byteAddr,
+                               MemoryAccessType type,
+                               uint32_t words)
+{
+    MemoryRegion *region = findRegion(byteAddr);
+    uint32_t latency;
+    uint32_t transfers;
+
+    if (region == nullptr)
+    {
+        return 0;
+    }
+
+    latency = (type == MemoryAccessType::STORE) ? region->writeLatency :
+                                                  region->readLatency;
+
+    /* Regions narrower than the access need several transfers */
+    transfers = (words + region->accessWidthWords - 1) /
+        region->accessWidthWords;
+
+    return transfers * (latency + 1) - 1;
+}
+
+/* Cycles to move a whole cache line in beats of the access width */
+uint32_t Memory::getLineTransferCycles(uint32_t byteAddr,
+                                       MemoryAccessType type,
+                                       uint32_t lineBytes)
+{
+    uint32_t beats = BYTE_TO_WORD_SIZE(lineBytes) / memAccessWidthWords;
+
+    return beats *
+        (getWaitCycles(byteAddr, type, memAccessWidthWords) + 1);
+}
+
+void Memory::checkWritable(uint32_t byteAddr)
+{
+    MemoryRegion *region = findRegion(byteAddr);
+
+    if (region != nullptr && region->readOnly)
+    {
+        fprintf(stderr,
+                "%s:%s:%d: Store to read-only memory at byteAddr "
+                "0x%08" PRIX32 "\n",
+                __FILE__,
+                __func__,
+                __LINE__,
+                byteAddr);
+        exit(1);
+    }
+}
+
+/*
+ * Take a free entry for a new request, or return nullptr if the memory cannot
+ * accept it in this cycle. The request only goes in flight if it wins the
+ * arbitration at the end of the cycle
+ */
+MemoryRequest *Memory::allocateRequest(Component issuer,
+                                       MemoryAccessType type,
+                                       uint32_t byteAddr,
+                                       uint32_t waitCycles,
+                                       uint32_t &token)
+{
+    MemoryPort *port = getPort(issuer);
+    MemoryRequest *req = nullptr;
+    uint32_t i;
+
+    if (port->inFlightCount == maxOutstanding)
+    {
+        /* Cannot place more requests until one is served */
+        return nullptr;
+    }
+
+    for (i = port->requestsBase;
+         i < port->requestsBase + portRequestsSize && req == nullptr;
+         i++)
+    {
+        if (requests[i].issuer == Component::NONE)
+        {
+            req = &requests[i];
+        }
+    }
+    if (req == nullptr)
+    {
+        /* Too many responses are waiting to be retrieved */
+        return nullptr;
+    }
+
+    req->issuer = issuer;
+    req->type = type;
+    req->token = nextToken;
+    req->byteAddr = byteAddr;
+    req->waitCycles = waitCycles;
+    req->latencyCycles = latencyCycles;
+    req->granted = false;
+    req->completed = false;
+    req->discarded = false;
+
+    port->bidCount++;
+    port->lastBid = req;
     token = nextToken++;
 
-    return 0;
+    return req;
+}
+
+/* Find the request with this token that is still pending or completed */
+MemoryRequest *Memory::findRequest(uint32_t token, bool completed)
+{
+    uint32_t i;
+
+    for (i = 0; i < requestsSize; i++)
+    {
+        if (requests[i].issuer != Component::NONE &&
+            requests[i].token == token && requests[i].completed == completed)
+        {
+            return &requests[i];
+        }
+    }
+
+    return nullptr;
+}
+
+int Memory::requestLoad(Component issuer, uint32_t byteAddr, uint32_t &token)
+{
+    MemoryRequest *req = allocateRequest(
+        issuer,
+        MemoryAccessType::LOAD,
+        byteAddr,
+        getWaitCycles(byteAddr, MemoryAccessType::LOAD, memAccessWidthWords),
+        token);
+
+    return (req == nullptr) ? -1 : 0;
+}
+
+/* Fetches only have a port of their own if the ports are separate */
+MemoryPort *Memory::getPort(Component issuer)
+{
+    if (separatePorts && issuer == Component::FETCH)
+    {
+        return &ports[MEM_FETCH_PORT];
+    }
+    else
+    {
+        return &ports[MEM_DATA_PORT];
+    }
+}
+
+bool Memory::isAvailable(Component issuer)
+{
+    MemoryPort *port = getPort(issuer);
+    uint32_t i;
+
+    if (port->inFlightCount == maxOutstanding)
+    {
+        return false;
+    }
+
+    for (i = port->requestsBase;
+         i < port->requestsBase + portRequestsSize;
+         i++)
+    {
+        if (requests[i].issuer == Component::NONE)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Whether the request is still waiting to be served */
+bool Memory::isPending(uint32_t token)
+{
+    return findRequest(token, false) != nullptr;
+}
+
+/* Whether the request lost the arbitration in the last cycle */
+bool Memory::isRejected(uint32_t token)
+{
+    return !rejectedTokens.empty() &&
+        std::find(rejectedTokens.begin(), rejectedTokens.end(), token) !=
+        rejectedTokens.end();
+}
+
+/* Whether there are no requests in flight */
+bool Memory::isIdle()
+{
+    return ports[MEM_DATA_PORT].inFlightCount == 0 &&
+        ports[MEM_FETCH_PORT].inFlightCount == 0;
+}
+
+/*
+ * Whether a request was placed in this cycle in the port used by issuer, by
+ * any component, so another one would go through the arbitration
+ */
+bool Memory::hasNewRequest(Component issuer)
+{
+    return getPort(issuer)->bidCount > 0;
+}
+
+/*
+ * Drop the response of a request that the issuer no longer needs. A request
+ * in flight still occupies the memory until it is served
+ */
+void Memory::discard(uint32_t token)
+{
+    MemoryRequest *req = findRequest(token, true);
+
+    if (req != nullptr)
+    {
+        req->issuer = Component::NONE;
+    }
+    else if ((req = findRequest(token, false)) != nullptr)
+    {
+        req->discarded = true;
+    }
+}
+
+void Memory::setArbitration(MemoryArbitration arbitrationIn)
+{
+    arbitration = arbitrationIn;
+}
+
+void Memory::setSeparatePorts(bool separatePortsIn)
+{
+    separatePorts = separatePortsIn;
+}
+
+/*
+ * Grant one of the requests placed in the port in this cycle and reject the
+ * rest, which their issuers have to place again. The priority only has to be
+ * checked if more than one request was placed
+ */
+void Memory::arbitrate(MemoryPort *port)
+{
+    MemoryRequest *winner = nullptr;
+    uint32_t i;
+
+    if (port->bidCount == 1)
+    {
+        winner = port->lastBid;
+    }
+    else if (port->bidCount > 1)
+    {
+        for (i = port->requestsBase;
+             i < port->requestsBase + portRequestsSize;
+             i++)
+        {
+            if (requests[i].issuer == Component::NONE || requests[i].granted)
+            {
+                continue;
+            }
+            else if (winner == nullptr)
+            {
+                winner = &requests[i];
+            }
+            else if (hasPriority(port, &requests[i], winner))
+            {
+                rejectRequest(winner);
+                winner = &requests[i];
+            }
+            else
+            {
+                rejectRequest(&requests[i]);
+            }
+        }
+    }
+    port->bidCount = 0;
+
+    if (winner != nullptr)
+    {
+        if (fetchAccelerator != nullptr && winner->issuer == Component::FETCH)
+        {
+            accessFetchAccelerator(winner);
+        }
+        else if (instCache != nullptr || dataCache != nullptr)
+        {
+            accessCache(winner);
+        }
+
+        winner->granted = true;
+        port->inFlight[(port->inFlightHead + port->inFlightCount) %
+                       maxOutstanding] =
+            static_cast<uint32_t>(winner - requests);
+        port->inFlightCount++;
+        port->lastGranted = winner->issuer;
+    }
+}
+
+bool Memory::hasPriority(MemoryPort *port,
+                         MemoryRequest *req,
+                         MemoryRequest *other)
+{
+    switch (arbitration)
+    {
+        case MemoryArbitration::FETCH_FIRST:
+            return req->issuer == Component::FETCH;
+
+        case MemoryArbitration::ROUND_ROBIN:
+            /* The component that was not granted last goes first */
+            return other->issuer == port->lastGranted;
+
+        default:
+            return req->issuer == Component::EXECUTE;
+    }
+}
+
+void Memory::rejectRequest(MemoryRequest *req)
+{
+    if (stats != nullptr && req->issuer == Component::FETCH)
+    {
+        stats->addFetchArbitrationLoss();
+    }
+    else if (stats != nullptr && req->issuer == Component::EXECUTE)
+    {
+        stats->addExecuteArbitrationLoss();
+    }
+
+    DEBUG_CMD(DEBUG_MEMORY,
+              printf("Memory: rejected request from %s\n",
+                     componentToStr(req->issuer).c_str()));
+
+    rejectedTokens.push_back(req->token);
+    req->issuer = Component::NONE;
+}
+
+Cache *Memory::createCache(const CacheConfig &config)
+{
+    if (config.lineBytes < WORD_TO_BYTE_SIZE(memAccessWidthWords))
+    {
+        fprintf(stderr,
+                "Cache line of %" PRIu32 " bytes is narrower than the "
+                "memory access width of %" PRIu32 " words\n",
+                config.lineBytes,
+                memAccessWidthWords);
+        exit(1);
+    }
+
+    return new Cache(config);
+}
+
+void Memory::setInstCache(const CacheConfig &config)
+{
+    delete instCache;
+    instCache = createCache(config);
+}
+
+void Memory::setDataCache(const CacheConfig &config)
+{
+    delete dataCache;
+    dataCache = createCache(config);
+}
+
+void Memory::setFetchAccelerator(const FetchAcceleratorConfig &config)
+{
+    delete fetchAccelerator;
+    fetchAccelerator = new FetchAccelerator(
+        config, WORD_TO_BYTE_SIZE(memAccessWidthWords), stats);
 }
 
-bool Memory::isAvailable()
+/*
+ * Look up a granted request in the cache of its issuer and replace its timing
+ * with the one of the cache. Misses fill the whole line, after writing back
+ * the dirty line that they replace. Stores to write-through caches keep the
+ * timing of the memory, as they are written to it anyway
+ */
+void Memory::accessCache(MemoryRequest *req)
 {
-    return pipeline[nextReqIndex].issuer == Component::NONE;
+    Cache *cache = (req->issuer == Component::FETCH) ? instCache : dataCache;
+    bool write = req->type == MemoryAccessType::STORE;
+    uint32_t lineBytes;
+    uint32_t evictedByteAddr;
+    CacheAccessResult result;
+
+    if (cache == nullptr)
+    {
+        return;
+    }
+
+    result = cache->access(req->byteAddr, write, evictedByteAddr);
+    lineBytes = cache->getConfig().lineBytes;
+
+    if (stats != nullptr && cache == instCache)
+    {
+        stats->addInstCacheAccess(result);
+    }
+    else if (stats != nullptr)
+    {
+        stats->addDataCacheAccess(result);
+    }
+
+    DEBUG_CMD(DEBUG_MEMORY,
+              printf("Memory: %s cache %s for 0x%08" PRIX32 "\n",
+                     (cache == instCache) ? "instruction" : "data",
+                     (result == CacheAccessResult::HIT) ? "hit" : "miss",
+                     req->byteAddr));
+
+    if (write && !cache->getConfig().writeBack)
+    {
+        return;
+    }
+    else if (result == CacheAccessResult::HIT)
+    {
+        req->waitCycles = 0;
+        req->latencyCycles = CACHE_HIT_CYCLES;
+        return;
+    }
+
+    req->waitCycles =
+        getLineTransferCycles(cache->getLineBaseByteAddr(req->byteAddr),
+                              MemoryAccessType::LOAD,
+                              lineBytes) -
+        1;
+    if (result == CacheAccessResult::WRITE_BACK)
+    {
+        req->waitCycles += getLineTransferCycles(
+            evictedByteAddr, MemoryAccessType::STORE, lineBytes);
+    }
 }
 
+/*
+ * Fetches that find their line in the accelerator only wait until the line
+ * is read, while the ones that miss read it from memory as usual once the
+ * accelerator finishes the read in progress. Only memory with wait states,
+ * such as flash, goes through the accelerator
+ */
+void Memory::accessFetchAccelerator(MemoryRequest *req)
+{
+    uint32_t lineByteAddr = getMemAccessWidthBaseByteAddr(req->byteAddr);
+    uint32_t nextLineByteAddr =
+        lineByteAddr + WORD_TO_BYTE_SIZE(memAccessWidthWords);
+    uint32_t readWaitCycles = getWaitCycles(
+        lineByteAddr, MemoryAccessType::LOAD, memAccessWidthWords);
+    uint32_t waitCycles;
+    bool hit;
+
+    if (readWaitCycles == 0)
+    {
+        /* Memory without wait states is not behind the accelerator */
+        return;
+    }
+
+    hit = fetchAccelerator->access(
+        lineByteAddr,
+        cycle,
+        readWaitCycles + 1,
+        getWaitCycles(
+            nextLineByteAddr, MemoryAccessType::LOAD, memAccessWidthWords) +
+            1,
+        waitCycles);
+
+    DEBUG_CMD(DEBUG_MEMORY,
+              printf("Memory: fetch accelerator %s for 0x%08" PRIX32
+                     ", ready in %" PRIu32 " cycles\n",
+                     hit ? "hit" : "miss",
+                     lineByteAddr,
+                     waitCycles));
+
+    if (hit)
+    {
+        req->waitCycles = waitCycles;
+        req->latencyCycles = CACHE_HIT_CYCLES;
+    }
+    else
+    {
+        /* A miss with the accelerator idle takes as long as without it */
+        req->waitCycles = waitCycles - 1;
+    }
+}
+
+/*
+ * Only the byte lanes in byteEnable are written, so sub-word stores do not
+ * need to read the rest of the word first
+ */
 int Memory::requestStore(Component issuer,
                          uint32_t byteAddr,
                          uint32_t data,
+                         uint32_t byteEnable,
                          uint32_t &token)
 {
-    if (pipeline[nextReqIndex].issuer != Component::NONE)
+    uint32_t wordIndex = getMemAccessWidthWordIndex(byteAddr);
+    MemoryRequest *req = allocateRequest(
+        issuer,
+        MemoryAccessType::STORE,
+        byteAddr,
+        getWaitCycles(byteAddr, MemoryAccessType::STORE, 1),
+        token);
+
+    if (req == nullptr)
     {
-        /* Cannot place more than one requests in the same cycle */
         return -1;
     }
 
-    pipeline[nextReqIndex].issuer = issuer;
-    pipeline[nextReqIndex].type = MemoryAccessType::STORE;
-    pipeline[nextReqIndex].token = nextToken;
-    pipeline[nextReqIndex].byteAddr = byteAddr;
-    pipeline[nextReqIndex].reqData[0] = data;
-
-    token = nextToken++;
+    memset(req->reqEnable, 0, memAccessWidthWords * sizeof(uint8_t));
+    req->reqData[wordIndex] = data;
+    req->reqEnable[wordIndex] = static_cast<uint8_t>(byteEnable);
 
     return 0;
 }
 
-int Memory::retrieveLoad(uint32_t token, uint32_t &data)
+/*
+ * Write words consecutive full words starting at byteAddr in one request. All
+ * the words must fall in the same access width line
+ */
+int Memory::requestBurstStore(Component issuer,
+                              uint32_t byteAddr,
+                              const uint32_t *data,
+                              uint32_t words,
+                              uint32_t &token)
 {
-    uint32_t prevRespIndex =
-        (nextReqIndex == 0) ? pipelineSize - 1 : nextReqIndex - 1;
-    uint32_t wordIndex;
+    uint32_t wordIndex = getMemAccessWidthWordIndex(byteAddr);
+    uint32_t i;
+    MemoryRequest *req;
 
-    if (pipeline[prevRespIndex].token == token)
+    if (words == 0 || wordIndex + words > memAccessWidthWords)
     {
-        wordIndex =
-            getMemAccessWidthWordIndex(pipeline[prevRespIndex].byteAddr);
-        data = pipeline[prevRespIndex].respData[wordIndex];
-        return 0;
+        fprintf(stderr,
+                "%s:%s:%d: Burst store of %" PRIu32 " words at byteAddr "
+                "0x%08" PRIX32 " crosses the access width\n",
+                __FILE__,
+                __func__,
+                __LINE__,
+                words,
+                byteAddr);
+        exit(1);
     }
-    else
+
+    req = allocateRequest(
+        issuer,
+        MemoryAccessType::STORE,
+        byteAddr,
+        getWaitCycles(byteAddr, MemoryAccessType::STORE, words),
+        token);
+    if (req == nullptr)
     {
         return -1;
     }
+
+    memset(req->reqEnable, 0, memAccessWidthWords * sizeof(uint8_t));
+    for (i = 0; i < words; i++)
+    {
+        req->reqData[wordIndex + i] = data[i];
+        req->reqEnable[wordIndex + i] = MEM_BYTE_ENABLE_WORD;
+    }
+
+    return 0;
 }
 
-int Memory::retrieveStore(uint32_t token)
+/*
+ * The retrieve functions hand over a completed response and release its
+ * entry, so each response can only be retrieved once
+ */
+int Memory::retrieveLoad(uint32_t token, uint32_t &data)
 {
-    uint32_t prevRespIndex =
-        (nextReqIndex == 0) ? pipelineSize - 1 : nextReqIndex - 1;
+    MemoryRequest *req = findRequest(token, true);
 
-    if (pipeline[prevRespIndex].token == token)
+    if (req == nullptr)
     {
-        return 0;
+        return -1;
     }
-    else
+
+    data = req->respData[getMemAccessWidthWordIndex(req->byteAddr)];
+    req->issuer = Component::NONE;
+
+    return 0;
+}
+
+int Memory::retrieveStore(uint32_t token)
+{
+    MemoryRequest *req = findRequest(token, true);
+
+    if (req == nullptr)
     {
         return -1;
     }
+
+    req->issuer = Component::NONE;
+
+    return 0;
 }
 
 int Memory::retrieveWideLoad(uint32_t token, uint32_t *data)
 {
-    uint32_t prevRespIndex =
-        (nextReqIndex == 0) ? pipelineSize - 1 : nextReqIndex - 1;
+    MemoryRequest *req = findRequest(token, true);
 
-    if (pipeline[prevRespIndex].token == token)
+    if (req == nullptr)
     {
-        if (data != nullptr)
-        {
-            memcpy(data,
-                   pipeline[prevRespIndex].respData,
-                   memAccessWidthWords * sizeof(uint32_t));
-        }
-        return 0;
+        return -1;
     }
-    else
+
+    if (data != nullptr)
+    {
+        memcpy(data, req->respData, memAccessWidthWords * sizeof(uint32_t));
+    }
+    req->issuer = Component::NONE;
+
+    return 0;
+}
+
+/*
+ * Copy words consecutive words of the response starting at the requested
+ * address, which must all fall in the same access width line
+ */
+int Memory::retrieveBurstLoad(uint32_t token, uint32_t *data, uint32_t words)
+{
+    MemoryRequest *req = findRequest(token, true);
+    uint32_t wordIndex;
+
+    if (req == nullptr)
     {
         return -1;
     }
+
+    wordIndex = getMemAccessWidthWordIndex(req->byteAddr);
+    if (wordIndex + words > memAccessWidthWords)
+    {
+        fprintf(stderr,
+                "%s:%s:%d: Burst load of %" PRIu32 " words crosses the "
+                "access width\n",
+                __FILE__,
+                __func__,
+                __LINE__,
+                words);
+        exit(1);
+    }
+    memcpy(data, &req->respData[wordIndex], words * sizeof(uint32_t));
+    req->issuer = Component::NONE;
+
+    return 0;
 }
 
+/* The ports work independently, but share the same backing store */
 int Memory::run()
 {
-    uint32_t wordBaseAddr;
-    uint32_t nextRespIndex = nextReqIndex;
-    nextReqIndex = (nextReqIndex + 1) % pipelineSize;
+    if (fetchAccelerator != nullptr)
+    {
+        cycle++;
+    }
+    if (!rejectedTokens.empty())
+    {
+        rejectedTokens.clear();
+    }
 
-    pipeline[nextReqIndex].issuer = Component::NONE;
-    pipeline[nextReqIndex].type = MemoryAccessType::NONE;
-    pipeline[nextReqIndex].token = 0;
-    pipeline[nextReqIndex].byteAddr = 0;
+    arbitrate(&ports[MEM_DATA_PORT]);
+    runPort(&ports[MEM_DATA_PORT]);
 
-    DEBUG_CMD(DEBUG_MEMORY, printf("Memory: "));
+    if (separatePorts)
+    {
+        arbitrate(&ports[MEM_FETCH_PORT]);
+        runPort(&ports[MEM_FETCH_PORT]);
+    }
 
-    if (pipeline[nextRespIndex].issuer == Component::NONE)
+    return 0;
+}
+
+/*
+ * Requests advance together once granted, but they are served in order, so
+ * the wait states of the oldest request hold back every request behind it
+ */
+void Memory::runPort(MemoryPort *port)
+{
+    uint32_t i;
+    MemoryRequest *req;
+
+    if (port->inFlightCount == 0)
     {
         /* There are no requests to serve */
-        DEBUG_CMD(DEBUG_MEMORY, printf("No requests pending\n"));
-        return 0;
+        DEBUG_CMD(DEBUG_MEMORY, printf("Memory: No requests pending\n"));
+        return;
     }
-    else if (GET_WORD_INDEX(pipeline[nextRespIndex].byteAddr) >= memSizeWords)
+
+    req = &requests[port->inFlight[port->inFlightHead]];
+    if (req->waitCycles > 0)
+    {
+        /* Hold the request, and any new ones, until its wait states end */
+        req->waitCycles--;
+        if (stats != nullptr)
+        {
+            stats->addMemWaitCycle();
+        }
+
+        DEBUG_CMD(DEBUG_MEMORY,
+                  printf("Memory: waiting %" PRIu32 " more cycles\n",
+                         req->waitCycles));
+        return;
+    }
+
+    for (i = 0; i < port->inFlightCount; i++)
+    {
+        req = &requests[port->inFlight[(port->inFlightHead + i) %
+                                       maxOutstanding]];
+        if (req->latencyCycles > 0)
+        {
+            req->latencyCycles--;
+        }
+    }
+
+    while (port->inFlightCount > 0)
+    {
+        req = &requests[port->inFlight[port->inFlightHead]];
+        if (req->waitCycles > 0 || req->latencyCycles > 0)
+        {
+            break;
+        }
+
+        serveRequest(req);
+
+        port->inFlightHead = (port->inFlightHead + 1) % maxOutstanding;
+        port->inFlightCount--;
+    }
+
+    DEBUG_CMD(DEBUG_MEMORY, print());
+}
+
+void Memory::serveRequest(MemoryRequest *req)
+{
+    uint32_t i;
+    uint32_t *line;
+    uint32_t wordBaseAddr;
+    uint32_t wordByteAddr;
+    uint32_t respWordIndex;
+
+    DEBUG_CMD(DEBUG_MEMORY, printf("Memory: "));
+
+    if (GET_WORD_INDEX(req->byteAddr) >= memSizeWords)
     {
         fprintf(stderr,
                 "%s:%s:%d: Out-of-bounds memory access to byteAddr "
@@ -265,28 +1103,48 @@ int Memory::run()
                 __FILE__,
                 __func__,
                 __LINE__,
-                pipeline[nextRespIndex].byteAddr,
-                GET_WORD_INDEX(pipeline[nextRespIndex].byteAddr),
+                req->byteAddr,
+                GET_WORD_INDEX(req->byteAddr),
                 memSizeWords);
         exit(1);
     }
 
     /* Serve the pending request */
-    switch (pipeline[nextRespIndex].type)
+    switch (req->type)
     {
         case MemoryAccessType::LOAD:
-            wordBaseAddr = getMemAccessWidthBaseByteAddr(
-                pipeline[nextRespIndex].byteAddr);
+            wordBaseAddr = getMemAccessWidthBaseByteAddr(req->byteAddr);
             wordBaseAddr = GET_WORD_INDEX(wordBaseAddr);
-            memcpy(pipeline[nextRespIndex].respData,
-                   mem + wordBaseAddr,
+            memcpy(req->respData,
+                   getWordPtr(wordBaseAddr),
                    memAccessWidthWords * sizeof(uint32_t));
             DEBUG_CMD(DEBUG_MEMORY, printf("Serving LOAD\n"));
             break;
 
         case MemoryAccessType::STORE:
-            mem[GET_WORD_INDEX(pipeline[nextRespIndex].byteAddr)] =
-                pipeline[nextRespIndex].reqData[0];
+            if (req->byteAddr >= watchBaseByteAddr &&
+                req->byteAddr < watchEndByteAddr)
+            {
+                watchedStore = true;
+            }
+            checkWritable(req->byteAddr);
+            wordBaseAddr = getMemAccessWidthBaseByteAddr(req->byteAddr);
+            line = getWordPtr(GET_WORD_INDEX(wordBaseAddr));
+            respWordIndex = getMemAccessWidthWordIndex(req->byteAddr);
+            for (i = 0; i < memAccessWidthWords; i++)
+            {
+                /* The other words of a wide store may hit the watch too */
+                wordByteAddr = wordBaseAddr + WORD_TO_BYTE_SIZE(i);
+                if (req->reqEnable[i] != 0 && i != respWordIndex &&
+                    wordByteAddr < watchEndByteAddr &&
+                    wordByteAddr + BYTES_PER_WORD > watchBaseByteAddr)
+                {
+                    watchedStore = true;
+                }
+                line[i] = mergeByteLanes(line[i],
+                                         req->reqData[i],
+                                         req->reqEnable[i]);
+            }
             DEBUG_CMD(DEBUG_MEMORY, printf("Serving STORE\n"));
             break;
 
@@ -295,70 +1153,145 @@ int Memory::run()
             exit(1);
     }
 
-    DEBUG_CMD(DEBUG_MEMORY, print());
-
-    return 0;
+    if (req->discarded)
+    {
+        /* Nobody is going to retrieve the response */
+        req->issuer = Component::NONE;
+    }
+    else
+    {
+        req->completed = true;
+    }
 }
 
 void Memory::print()
 {
     uint32_t i, j;
-    uint32_t nextRespIndex =
-        (nextReqIndex == 0) ? pipelineSize - 1 : nextReqIndex - 1;
 
-    for (i = 0; i < pipelineSize; i++)
+    for (i = 0; i < requestsSize; i++)
     {
         printf("    i: %" PRIu32 " token: %08" PRIX32 " type:%s "
                "byteAddr:%08" PRIX32 " issuer:%s",
                i,
-               pipeline[i].token,
-               memAccessTypeToStr(pipeline[i].type).c_str(),
-               pipeline[i].byteAddr,
-               componentToStr(pipeline[i].issuer).c_str());
-        if (nextReqIndex == i)
+               requests[i].token,
+               memAccessTypeToStr(requests[i].type).c_str(),
+               requests[i].byteAddr,
+               componentToStr(requests[i].issuer).c_str());
+        if (requests[i].issuer != Component::NONE && requests[i].completed)
         {
-            printf(" <- nextReqIndex");
+            printf(" <- completed");
         }
-        if (nextRespIndex == i)
+        else if (requests[i].issuer != Component::NONE && requests[i].granted)
         {
-            printf(" <- nextRespIndex");
+            printf(" <- in flight");
         }
         printf("\n");
-        if (pipeline[i].issuer != Component::NONE &&
-            pipeline[i].type == MemoryAccessType::LOAD)
+        if (requests[i].issuer != Component::NONE &&
+            requests[i].type == MemoryAccessType::LOAD)
         {
             for (j = 0; j < memAccessWidthWords; j++)
             {
                 printf("        data:0x%08" PRIX32 "\n",
-                       pipeline[i].respData[j]);
+                       requests[i].respData[j]);
             }
         }
-        else if (pipeline[i].issuer != Component::NONE &&
-                 pipeline[i].type == MemoryAccessType::STORE)
+        else if (requests[i].issuer != Component::NONE &&
+                 requests[i].type == MemoryAccessType::STORE)
         {
-            printf("        data:0x%08" PRIX32 "\n", pipeline[i].reqData[0]);
+            for (j = 0; j < memAccessWidthWords; j++)
+            {
+                printf("        data:0x%08" PRIX32 " enable:0x%" PRIX8 "\n",
+                       requests[i].reqData[j],
+                       requests[i].reqEnable[j]);
+            }
         }
     }
 }
 
+/* Only the chunks that were touched are printed, the rest are zero */
+/*
+ * Only the words that are not zero are printed. Pages that were never touched
+ * are zero and are skipped without reading them, so that the dump does not
+ * fault in the whole of each chunk
+ */
 void Memory::dump()
 {
-    uint32_t i;
+    uint32_t i, j;
+    uint32_t wordIndex;
     uint32_t byteAddr;
+    uint32_t pageWords =
+        static_cast<uint32_t>(BYTE_TO_WORD_SIZE(sysconf(_SC_PAGESIZE)));
+    int pagemapFd = open("/proc/self/pagemap", O_RDONLY);
 
-    printf("Memory: size:%" PRIu32 " words\n", memSizeWords);
-    for (i = 0; i < memSizeWords; i++)
+    printf("Memory: size:%" PRIu32 " words, zero words not shown\n",
+           memSizeWords);
+    for (i = 0; i < MEM_CHUNK_COUNT; i++)
     {
-        byteAddr = i * 4;
-        printf("addr:0x%08" PRIX32 " (0d%08" PRIu32 ", byte:0x%08" PRIX32
-               ") data:0x%08" PRIX32 "\n",
-               i,
-               i,
-               byteAddr,
-               mem[i]);
+        if (chunks[i] == nullptr)
+        {
+            continue;
+        }
+        for (j = 0; j < MEM_CHUNK_WORDS; j++)
+        {
+            wordIndex = (i << MEM_CHUNK_WORDS_SHIFT) | j;
+            if (wordIndex >= memSizeWords)
+            {
+                break;
+            }
+            else if (j % pageWords == 0 &&
+                     !isPageTouched(pagemapFd, wordIndex))
+            {
+                j += pageWords - 1;
+                continue;
+            }
+            else if (chunks[i][j] == 0)
+            {
+                continue;
+            }
+            byteAddr = wordIndex * 4;
+            printf("addr:0x%08" PRIX32 " (0d%08" PRIu32 ", byte:0x%08" PRIX32
+                   ") data:0x%08" PRIX32 "\n",
+                   wordIndex,
+                   wordIndex,
+                   byteAddr,
+                   chunks[i][j]);
+        }
+    }
+
+    if (pagemapFd >= 0)
+    {
+        close(pagemapFd);
     }
 }
 
+/*
+ * Whether the host page of a mapped word was ever touched, going by the page
+ * map of the process. Untouched anonymous pages read as zero, but untouched
+ * pages of the program binary still hold its contents. If the page map cannot
+ * be read the page is assumed to be touched
+ */
+bool Memory::isPageTouched(int pagemapFd, uint32_t wordIndex)
+{
+    uint64_t entry;
+    uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t hostAddr = reinterpret_cast<uintptr_t>(
+        &chunks[wordIndex >> MEM_CHUNK_WORDS_SHIFT]
+               [wordIndex & (MEM_CHUNK_WORDS - 1)]);
+    off_t offset = static_cast<off_t>(hostAddr / pageSize * sizeof(entry));
+
+    if (WORD_TO_BYTE_SIZE(static_cast<uint64_t>(wordIndex)) <
+            programMapBytes ||
+        pagemapFd < 0 ||
+        pread(pagemapFd, &entry, sizeof(entry), offset) !=
+            static_cast<ssize_t>(sizeof(entry)))
+    {
+        return true;
+    }
+
+    /* Present in memory or swapped out */
+    return (entry & (UINT64_C(3) << 62)) != 0;
+}
+
 std::string Memory::componentToStr(Component component)
 {
     switch (component)
@@ -418,5 +1351,91 @@ void Memory::loadWord(uint32_t byteAddr, uint32_t &data)
         exit(1);
     }
 
-    data = mem[GET_WORD_INDEX(byteAddr)];
+    data = *getWordPtr(GET_WORD_INDEX(byteAddr));
+}
+
+void Memory::storeWord(uint32_t byteAddr, uint32_t data, uint32_t byteEnable)
+{
+    uint32_t *word;
+
+    if (GET_WORD_INDEX(byteAddr) >= memSizeWords)
+    {
+        fprintf(stderr,
+                "%s:%s:%d: Out-of-bounds memory access to byteAddr "
+                "0x%08" PRIX32 " (%" PRIu32 " words) of memSizeWords %" PRIu32
+                "\n",
+                __FILE__,
+                __func__,
+                __LINE__,
+                byteAddr,
+                GET_WORD_INDEX(byteAddr),
+                memSizeWords);
+        exit(1);
+    }
+
+    checkWritable(byteAddr);
+
+    if (byteAddr >= watchBaseByteAddr && byteAddr < watchEndByteAddr)
+    {
+        watchedStore = true;
+    }
+
+    word = getWordPtr(GET_WORD_INDEX(byteAddr));
+    *word = mergeByteLanes(*word, data, byteEnable);
+}
+
+/* Replace the bytes of prevData selected by byteEnable with those of data */
+uint32_t Memory::mergeByteLanes(uint32_t prevData,
+                                uint32_t data,
+                                uint32_t byteEnable)
+{
+    uint32_t mask = 0;
+    uint32_t i;
+
+    if (byteEnable == MEM_BYTE_ENABLE_WORD)
+    {
+        return data;
+    }
+
+    for (i = 0; i < BYTES_PER_WORD; i++)
+    {
+        if (GET_BIT_AT_POS(byteEnable, i) != 0)
+        {
+            mask |= 0xFFU << (i * BITS_PER_BYTE);
+        }
+    }
+
+    return (prevData & ~mask) | (data & mask);
+}
+
+/* Extend the watched range to also cover [baseByteAddr, endByteAddr) */
+void Memory::watchStores(uint32_t baseByteAddr, uint32_t endByteAddr)
+{
+    if (watchBaseByteAddr >= watchEndByteAddr)
+    {
+        watchBaseByteAddr = baseByteAddr;
+        watchEndByteAddr = endByteAddr;
+    }
+    else
+    {
+        watchBaseByteAddr = std::min(watchBaseByteAddr, baseByteAddr);
+        watchEndByteAddr = std::max(watchEndByteAddr, endByteAddr);
+    }
+}
+
+void Memory::unwatchStores()
+{
+    watchBaseByteAddr = 0;
+    watchEndByteAddr = 0;
+    watchedStore = false;
+}
+
+/* Whether a watched address was written since the last call */
+bool Memory::checkWatchedStore()
+{
+    bool ret = watchedStore;
+
+    watchedStore = false;
+
+    return ret;
 }
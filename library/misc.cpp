@@ -32,7 +32,7 @@
 
 int Execute::bkpt(uint32_t im)
 {
-    delete decodedInst;
+    decode->releaseInst(decodedInst);
     decodedInst = NULL;
 
     DEBUG_CMD(DEBUG_MEMORY, mem->dump());
@@ -55,7 +55,7 @@ int Execute::nop()
 
 int Execute::svc(uint32_t im)
 {
-    delete decodedInst;
+    decode->releaseInst(decodedInst);
     decodedInst = NULL;
 
     fprintf(stderr, "Reached SVC (im %" PRIu32 ") instruction\n", im);
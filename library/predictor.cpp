@@ -0,0 +1,234 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "simulator/predictor.h"
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/* Counters start weakly not taken and predict taken from this value */
+#define COUNTER_INIT 1
+#define COUNTER_TAKEN 2
+#define COUNTER_MAX 3
+
+static bool isPowerOfTwo(uint32_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+BranchPredictor::BranchPredictor(const BranchPredictorConfig &configIn) :
+    config(configIn)
+{
+    uint32_t i;
+
+    tags = new uint32_t[config.btbEntries];
+    targets = new uint32_t[config.btbEntries];
+    valid = new bool[config.btbEntries];
+    conditional = new bool[config.btbEntries];
+    counters = new uint8_t[config.counters];
+
+    for (i = 0; i < config.btbEntries; i++)
+    {
+        tags[i] = 0;
+        targets[i] = 0;
+        valid[i] = false;
+        conditional[i] = false;
+    }
+    for (i = 0; i < config.counters; i++)
+    {
+        counters[i] = COUNTER_INIT;
+    }
+}
+
+BranchPredictor::~BranchPredictor()
+{
+    delete[] tags;
+    delete[] targets;
+    delete[] valid;
+    delete[] conditional;
+    delete[] counters;
+}
+
+uint32_t BranchPredictor::getCounterIndex(uint32_t branchAddr)
+{
+    uint32_t index = branchAddr >> 1;
+
+    if (config.type == BranchPredictorType::GSHARE)
+    {
+        index = index ^ history;
+    }
+
+    return index & (config.counters - 1);
+}
+
+/*
+ * Return whether the branch ending at branchAddr is predicted taken and, in
+ * that case, its target
+ */
+bool BranchPredictor::predict(uint32_t branchAddr, uint32_t &target)
+{
+    uint32_t index = getBtbIndex(branchAddr);
+    bool taken;
+
+    if (!valid[index] || tags[index] != branchAddr)
+    {
+        return false;
+    }
+    else if (!conditional[index])
+    {
+        taken = true;
+    }
+    else if (config.type == BranchPredictorType::STATIC)
+    {
+        taken = targets[index] < branchAddr;
+    }
+    else
+    {
+        taken = counters[getCounterIndex(branchAddr)] >= COUNTER_TAKEN;
+    }
+
+    if (taken)
+    {
+        target = targets[index];
+    }
+
+    return taken;
+}
+
+/* Train the predictor with a branch that executed */
+void BranchPredictor::update(uint32_t branchAddr,
+                             bool conditionalIn,
+                             bool taken,
+                             uint32_t target)
+{
+    uint32_t index;
+    uint8_t *counter;
+
+    if (conditionalIn && config.type != BranchPredictorType::STATIC)
+    {
+        counter = &counters[getCounterIndex(branchAddr)];
+        if (taken && *counter < COUNTER_MAX)
+        {
+            (*counter)++;
+        }
+        else if (!taken && *counter > 0)
+        {
+            (*counter)--;
+        }
+
+        history = ((history << 1) | (taken ? 1 : 0)) & (config.counters - 1);
+    }
+
+    if (taken)
+    {
+        /* Branches that are not taken do not need their target */
+        index = getBtbIndex(branchAddr);
+        tags[index] = branchAddr;
+        targets[index] = target;
+        valid[index] = true;
+        conditional[index] = conditionalIn;
+    }
+}
+
+/* Forget a branch, for example because the code that held it changed */
+void BranchPredictor::invalidate(uint32_t branchAddr)
+{
+    uint32_t index = getBtbIndex(branchAddr);
+
+    if (tags[index] == branchAddr)
+    {
+        valid[index] = false;
+    }
+}
+
+int BranchPredictor::parseConfig(const char *str,
+                                 BranchPredictorConfig &config)
+{
+    unsigned int btbEntries = BRANCH_TARGET_BUFFER_ENTRIES;
+    unsigned int counters = BRANCH_PREDICTOR_COUNTERS;
+    char type[8];
+    int fields;
+
+    fields = sscanf(str, "%7[a-z],%u,%u", type, &btbEntries, &counters);
+    if (fields < 1)
+    {
+        return -1;
+    }
+
+    if (strcmp(type, "static") == 0)
+    {
+        config.type = BranchPredictorType::STATIC;
+    }
+    else if (strcmp(type, "bimodal") == 0)
+    {
+        config.type = BranchPredictorType::BIMODAL;
+    }
+    else if (strcmp(type, "gshare") == 0)
+    {
+        config.type = BranchPredictorType::GSHARE;
+    }
+    else
+    {
+        return -1;
+    }
+
+    /* Both tables are indexed with the low bits of the address */
+    if (!isPowerOfTwo(btbEntries) || !isPowerOfTwo(counters))
+    {
+        return -1;
+    }
+
+    config.btbEntries = btbEntries;
+    config.counters = counters;
+
+    return 0;
+}
+
+std::string BranchPredictor::configToStr(const BranchPredictorConfig &config)
+{
+    static const char *typeStr[] = { "static", "bimodal", "gshare" };
+    char str[128];
+
+    if (config.type == BranchPredictorType::STATIC)
+    {
+        snprintf(str,
+                 sizeof(str),
+                 "%s (%" PRIu32 " BTB entries)",
+                 typeStr[static_cast<int>(config.type)],
+                 config.btbEntries);
+    }
+    else
+    {
+        snprintf(str,
+                 sizeof(str),
+                 "%s (%" PRIu32 " BTB entries, %" PRIu32 " counters)",
+                 typeStr[static_cast<int>(config.type)],
+                 config.btbEntries,
+                 config.counters);
+    }
+
+    return std::string(str);
+}
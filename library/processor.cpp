@@ -23,11 +23,15 @@
  */
 #include "simulator/processor.h"
 
+#include "simulator/blockcache.h"
 #include "simulator/debug.h"
 #include "simulator/decode.h"
 #include "simulator/execute.h"
 #include "simulator/fetch.h"
+#include "simulator/loopbuffer.h"
+#include "simulator/memo.h"
 #include "simulator/memory.h"
+#include "simulator/predictor.h"
 #include "simulator/regfile.h"
 #include "simulator/stats.h"
 #include "simulator/utils.h"
@@ -36,18 +40,29 @@
 #include <cstdint>
 #include <cstdio>
 
-Processor::Processor(uint32_t memSizeWordsIn, uint32_t memAccessWidthWordsIn)
+Processor::Processor(uint32_t memSizeWordsIn,
+                     uint32_t memAccessWidthWordsIn,
+                     uint32_t memLatencyCyclesIn,
+                     uint32_t memMaxOutstandingIn,
+                     uint32_t fetchQueueDepthIn)
 {
     stats = new Statistics();
     regFile = new RegFile();
-    mem = new Memory(memSizeWordsIn, memAccessWidthWordsIn, 2);
-    fetch = new Fetch(mem, regFile, stats);
-    decode = new Decode(fetch, regFile);
+    mem = new Memory(memSizeWordsIn,
+                     memAccessWidthWordsIn,
+                     memLatencyCyclesIn,
+                     memMaxOutstandingIn,
+                     stats);
+    fetch = new Fetch(mem, regFile, stats, fetchQueueDepthIn);
+    decode = new Decode(fetch, regFile, stats);
     execute = new Execute(fetch, decode, regFile, mem, stats);
 
     /* Add system configuration statistics */
     stats->setMemSizeWords(mem->getMemSizeWords());
     stats->setMemAccessWidthWords(mem->getMemAccessWidthWords());
+    stats->setMemLatencyCycles(mem->getLatencyCycles());
+    stats->setMemMaxOutstanding(mem->getMaxOutstanding());
+    stats->setFetchQueueDepth(fetch->getQueueDepth());
 }
 
 Processor::~Processor()
@@ -58,23 +73,483 @@ Processor::~Processor()
     delete fetch;
     delete decode;
     delete execute;
+    delete predictor;
+    delete loopBuffer;
+    delete writeBuffer;
+    delete timingMemo;
 }
 
 int Processor::simulateCycle()
 {
+    bool flushed;
+    bool memIdle;
+
     stats->addCycle();
 
+    if (writeBuffer != nullptr)
+    {
+        writeBuffer->retire();
+    }
     execute->run();
+    /* A flush is pending in fetch when execute has just branched */
+    flushed = timingMemo != nullptr && fetch->isFlushPending();
     decode->run();
     fetch->run();
+    if (writeBuffer != nullptr)
+    {
+        /* Drain buffered stores only when execute left the memory idle */
+        writeBuffer->run();
+    }
+    /* The requests placed in this cycle are not in flight until granted */
+    memIdle = flushed && mem->isIdle();
 
     mem->run();
 
     DEBUG_CMD(DEBUG_REGFILE, regFile->print());
 
+    if (flushed)
+    {
+        runMemoizedBlocks(memIdle);
+    }
+
     return 0;
 }
 
+/*
+ * Called at the end of a cycle that flushed the pipeline, so the next block
+ * starts from an empty pipeline. Blocks with memoized timing are run in the
+ * functional model until one of them has to be simulated in full
+ */
+void Processor::runMemoizedBlocks(bool memIdle)
+{
+    uint32_t pc;
+    MemoizedBlock *entry;
+
+    if (mem->checkWatchedStore())
+    {
+        /* The program modified code that was memoized */
+        timingMemo->invalidate();
+        mem->unwatchStores();
+        recordedBlock = nullptr;
+    }
+    /*
+     * If the memory was still busy the fetch after the flush was not issued,
+     * or it is queued behind older requests, so the next block does not start
+     * from the usual pipeline state
+     */
+    memIdle = memIdle && fetch->hasIssuedMemAccess();
+    finishRecordedBlock(memIdle);
+    if (!memIdle)
+    {
+        return;
+    }
+
+    do
+    {
+        regFile->read(Reg::PC, pc);
+        entry = timingMemo->lookup(pc);
+        if (entry == nullptr)
+        {
+            entry = timingMemo->allocate(pc);
+            entry->block.startAddr = pc;
+            predecodeBlock(&entry->block, FAST_FORWARD_NO_ADDR);
+            entry->memoizable = TimingMemo::isMemoizable(entry->block);
+        }
+    } while (timingMemo->replayVisit(entry) && replayMemoizedBlock(entry));
+
+    if (entry->memoizable)
+    {
+        /* Time the block as it runs through the pipeline */
+        recordedBlock = entry;
+        stats->getPipelineCounters(recordStart);
+        recordBranchesNotTaken = stats->getBranchesNotTaken();
+    }
+}
+
+/*
+ * Run a block in the functional model and charge its memoized counters. If
+ * the branch at the end is not taken the pipeline would not be flushed, so
+ * the program is rolled back and false is returned
+ */
+bool Processor::replayMemoizedBlock(MemoizedBlock *entry)
+{
+    PredecodedBlock *block = &entry->block;
+    uint64_t branchesNotTaken = stats->getBranchesNotTaken();
+    bool conditional = block->insts[block->instCount - 1].getOperation() ==
+        DecodedOperation::B1;
+    PipelineCounters counters;
+    DecodedInst *decodedInst;
+    uint32_t i;
+
+    if (conditional)
+    {
+        regFileCheckpoint = *regFile;
+        statsCheckpoint = *stats;
+    }
+
+    stats->getPipelineCounters(counters);
+
+    for (i = 0; i < block->instCount; i++)
+    {
+        decodedInst = decode->loadPredecodedInst(
+            block->insts[i],
+            NEXT_THUMB_INST(NEXT_THUMB_INST(block->instAddr[i])));
+
+        regFile->write(Reg::PC, block->nextAddr[i]);
+        execute->executeFunctional(decodedInst);
+    }
+
+    if (conditional && stats->getBranchesNotTaken() != branchesNotTaken)
+    {
+        *regFile = regFileCheckpoint;
+        *stats = statsCheckpoint;
+        return false;
+    }
+
+    /* Let the memory serve the fetch issued before the block started */
+    while (!mem->isIdle())
+    {
+        mem->run();
+    }
+
+    /* Leave the pipeline as at the end of the cycle that took the branch */
+    decode->flush();
+    fetch->flush();
+    decode->run();
+    fetch->run();
+    mem->run();
+
+    TimingMemo::charge(entry, counters);
+    stats->setPipelineCounters(counters);
+    stats->addMemoizedBlock();
+
+    return true;
+}
+
+/*
+ * Memoize the counters of the block that was simulated in full. Blocks that
+ * leave the memory busy when they branch cannot be replayed, as the replay
+ * always leaves the memory serving the fetch of the branch target
+ */
+void Processor::finishRecordedBlock(bool memIdle)
+{
+    PipelineCounters counters;
+
+    if (recordedBlock == nullptr)
+    {
+        return;
+    }
+
+    /* The branch was not taken, so the block did not end here */
+    if (stats->getBranchesNotTaken() != recordBranchesNotTaken)
+    {
+        recordedBlock = nullptr;
+        return;
+    }
+
+    if (!memIdle)
+    {
+        recordedBlock->memoizable = false;
+    }
+    else
+    {
+        stats->getPipelineCounters(counters);
+        if (!timingMemo->record(recordedBlock, recordStart, counters))
+        {
+            stats->addMemoizedBlockMismatch();
+
+            DEBUG_CMD(DEBUG_ALL,
+                      printf("Memoized timing of block 0x%08" PRIX32
+                             " does not match\n",
+                             recordedBlock->startAddr));
+        }
+    }
+
+    recordedBlock = nullptr;
+}
+
+/*
+ * Run instructions in the functional model until maxInsts have completed or
+ * the pc reaches stopAddr. The pipeline is left empty, so the timing model
+ * continues from the architectural state as it would after a reset
+ */
+int Processor::fastForward(uint64_t maxInsts, uint32_t stopAddr)
+{
+    uint64_t count = 0;
+    uint32_t instAddr;
+    uint32_t nextInstAddr;
+    bool blockStart = true;
+    DecodedInst *decodedInst;
+    PredecodedBlock *block;
+    BlockCache blockCache;
+
+    while (count < maxInsts)
+    {
+        regFile->read(Reg::PC, instAddr);
+        if (instAddr == stopAddr)
+        {
+            break;
+        }
+
+        /* Hot blocks are run from their predecoded instructions */
+        if (blockStart)
+        {
+            block = blockCache.lookup(instAddr);
+            if (block == nullptr)
+            {
+                block = blockCache.recordBranchTarget(instAddr);
+                if (block != nullptr)
+                {
+                    predecodeBlock(block, stopAddr);
+                }
+            }
+
+            if (block != nullptr && count + block->instCount <= maxInsts)
+            {
+                count += runPredecodedBlock(block, blockCache);
+                continue;
+            }
+        }
+
+        nextInstAddr = instAddr;
+        decodedInst = decodeNextFunctional(nextInstAddr);
+
+        regFile->write(Reg::PC, nextInstAddr);
+        execute->executeFunctional(decodedInst);
+
+        stats->addFastForwardedInst();
+        count++;
+
+        if (mem->checkWatchedStore())
+        {
+            /* The program modified code that was predecoded */
+            blockCache.invalidate();
+            mem->unwatchStores();
+        }
+
+        /* A new block starts wherever a branch was taken */
+        regFile->read(Reg::PC, instAddr);
+        blockStart = instAddr != nextInstAddr;
+    }
+
+    mem->unwatchStores();
+
+    DEBUG_CMD(DEBUG_ALL,
+              printf("Fast-forwarded %" PRIu64 " instructions\n", count));
+
+    /* Only the timed part of the program is reported */
+    stats->resetExecution();
+
+    return 0;
+}
+
+/*
+ * Decode the instruction at instAddr for the functional model and advance
+ * instAddr to the following instruction
+ */
+DecodedInst *Processor::decodeNextFunctional(uint32_t &instAddr)
+{
+    uint32_t word;
+    uint16_t inst;
+    DecodedInst *decodedInst;
+
+    /* Read halfwords until there is a complete instruction */
+    do
+    {
+        mem->loadWord(instAddr, word);
+        inst = static_cast<uint16_t>(
+            word >> (GET_BYTE_INDEX(instAddr) * BITS_PER_BYTE));
+        decodedInst = decode->decodeFunctional(inst, instAddr);
+        instAddr = NEXT_THUMB_INST(instAddr);
+    } while (decodedInst == nullptr);
+
+    return decodedInst;
+}
+
+/*
+ * Predecode the straight-line code starting at the block address. The block
+ * ends at the first branch, before stopAddr or when it is full. Stores to the
+ * predecoded addresses are watched to detect self-modifying code
+ */
+void Processor::predecodeBlock(PredecodedBlock *block, uint32_t stopAddr)
+{
+    uint32_t instAddr = block->startAddr;
+    uint64_t memSizeBytes =
+        WORD_TO_BYTE_SIZE(static_cast<uint64_t>(mem->getMemSizeWords()));
+    DecodedInst *decodedInst;
+    DecodedOperation op;
+
+    block->instCount = 0;
+    block->threaded = false;
+    while (block->instCount < PREDECODED_BLOCK_MAX_INSTS)
+    {
+        /* Leave room for both halves of a 32-bit instruction */
+        if (instAddr == stopAddr ||
+            static_cast<uint64_t>(instAddr) + 4 > memSizeBytes)
+        {
+            break;
+        }
+
+        block->instAddr[block->instCount] = instAddr;
+        decodedInst = decodeNextFunctional(instAddr);
+        block->insts[block->instCount] = *decodedInst;
+        block->nextAddr[block->instCount] = instAddr;
+        block->instCount++;
+        op = decodedInst->getOperation();
+        decode->releaseInst(decodedInst);
+
+        if (BlockCache::endsBlock(op))
+        {
+            break;
+        }
+    }
+
+    block->endAddr = instAddr;
+    block->valid = block->instCount > 0;
+    mem->watchStores(block->startAddr, block->endAddr);
+
+    DEBUG_CMD(DEBUG_ALL,
+              printf("Predecoded block 0x%08" PRIX32 " - 0x%08" PRIX32
+                     " (%" PRIu32 " instructions)\n",
+                     block->startAddr,
+                     block->endAddr,
+                     block->instCount));
+}
+
+/*
+ * Run the instructions of a predecoded block until one of them branches or
+ * writes to predecoded code. Returns the number of instructions completed
+ */
+uint64_t Processor::runPredecodedBlock(PredecodedBlock *block,
+                                       BlockCache &blockCache)
+{
+    uint32_t i;
+    uint32_t pc;
+    bool modifiedCode;
+    DecodedInst *decodedInst;
+
+    if (threadedDispatch)
+    {
+        i = execute->runThreadedBlock(block, modifiedCode);
+        stats->addFastForwardedInsts(i);
+        if (modifiedCode)
+        {
+            /* The block may no longer exist */
+            blockCache.invalidate();
+            mem->unwatchStores();
+        }
+        return i;
+    }
+
+    for (i = 0; i < block->instCount; i++)
+    {
+        decodedInst = decode->loadPredecodedInst(
+            block->insts[i],
+            NEXT_THUMB_INST(NEXT_THUMB_INST(block->instAddr[i])));
+
+        regFile->write(Reg::PC, block->nextAddr[i]);
+        execute->executeFunctional(decodedInst);
+
+        stats->addFastForwardedInst();
+
+        if (mem->checkWatchedStore())
+        {
+            /* The block may no longer exist, so stop straight away */
+            blockCache.invalidate();
+            mem->unwatchStores();
+            return i + 1;
+        }
+
+        regFile->read(Reg::PC, pc);
+        if (pc != block->nextAddr[i])
+        {
+            return i + 1;
+        }
+    }
+
+    return block->instCount;
+}
+
+void Processor::setThreadedDispatch(bool threadedDispatchIn)
+{
+    threadedDispatch = threadedDispatchIn;
+}
+
+void Processor::setBurstTransfers(bool burstTransfersIn)
+{
+    execute->setBurstTransfers(burstTransfersIn);
+}
+
+void Processor::setMemArbitration(MemoryArbitration memArbitrationIn)
+{
+    mem->setArbitration(memArbitrationIn);
+}
+
+void Processor::setSeparateMemPorts(bool separateMemPortsIn)
+{
+    mem->setSeparatePorts(separateMemPortsIn);
+    stats->setMemSeparatePorts(separateMemPortsIn);
+}
+
+void Processor::setInstCache(const CacheConfig &config)
+{
+    mem->setInstCache(config);
+    stats->setInstCacheConfig(Cache::configToStr(config));
+}
+
+void Processor::setDataCache(const CacheConfig &config)
+{
+    mem->setDataCache(config);
+    stats->setDataCacheConfig(Cache::configToStr(config));
+}
+
+void Processor::setFetchAccelerator(const FetchAcceleratorConfig &config)
+{
+    mem->setFetchAccelerator(config);
+    stats->setFetchAccelConfig(FetchAccelerator::configToStr(config));
+}
+
+void Processor::setBranchPredictor(const BranchPredictorConfig &config)
+{
+    delete predictor;
+    predictor = new BranchPredictor(config);
+    fetch->setBranchPredictor(predictor);
+    execute->setBranchPredictor(predictor);
+    stats->setBranchPredictorConfig(BranchPredictor::configToStr(config));
+}
+
+void Processor::setLoopBuffer(uint32_t entries)
+{
+    delete loopBuffer;
+    loopBuffer = new LoopBuffer(entries);
+    fetch->setLoopBuffer(loopBuffer);
+    execute->setLoopBuffer(loopBuffer);
+    stats->setLoopBufferEntries(entries);
+}
+
+void Processor::setWriteBuffer(uint32_t entries)
+{
+    delete writeBuffer;
+    writeBuffer = new WriteBuffer(mem, stats, entries);
+    execute->setWriteBuffer(writeBuffer);
+    stats->setWriteBufferEntries(entries);
+}
+
+void Processor::setTimingMemo(uint32_t verifyInterval)
+{
+    timingMemo = new TimingMemo(verifyInterval);
+}
+
+int Processor::loadRegionMap(char *regionMapFile)
+{
+    return mem->loadRegionMap(regionMapFile);
+}
+
+int Processor::checkDecoder()
+{
+    return decode->checkDecodeTable();
+}
+
 int Processor::reset(char *programBinFile)
 {
     int ret;
@@ -34,22 +34,94 @@
 
 uint32_t RegFile::readData(Reg reg)
 {
-    return regs[static_cast<uint32_t>(reg)];
+    return readData(static_cast<uint32_t>(reg));
 }
 
 uint32_t RegFile::readData(uint32_t reg)
 {
+    if (reg == static_cast<uint32_t>(Reg::XPSR) &&
+        xpsrFlagsOp != XpsrFlagsOp::NONE)
+    {
+        materializeXpsrFlags();
+    }
+
     return regs[reg];
 }
 
 void RegFile::write(Reg reg, uint32_t data)
 {
+    if (reg == Reg::XPSR)
+    {
+        /* The new value overrides any flags that were pending */
+        xpsrFlagsOp = XpsrFlagsOp::NONE;
+    }
+
     regs[static_cast<uint32_t>(reg)] = data;
 }
 
 void RegFile::read(Reg reg, uint32_t &data)
 {
-    data = regs[static_cast<uint32_t>(reg)];
+    data = readData(reg);
+}
+
+void RegFile::setXpsrFlagsLazy(XpsrFlagsOp op,
+                               uint32_t res,
+                               uint32_t op0,
+                               uint32_t op1,
+                               uint32_t cflag)
+{
+    /*
+     * Each operation updates a superset of the flags of the ones before it in
+     * XpsrFlagsOp. Flags that the new operation does not update must keep the
+     * value left by the previous one, so work those out now
+     */
+    if (op < xpsrFlagsOp)
+    {
+        materializeXpsrFlags();
+    }
+
+    xpsrFlagsOp = op;
+    xpsrFlagsRes = res;
+    xpsrFlagsOp0 = op0;
+    xpsrFlagsOp1 = op1;
+    xpsrFlagsCarry = cflag;
+}
+
+/*
+ * Compute the flags of the last ALU operation. The carry and overflow are
+ * those of the addition op0 + op1 + carry, subtractions are passed in as an
+ * addition of the inverted operand
+ */
+void RegFile::materializeXpsrFlags()
+{
+    uint32_t r = static_cast<uint32_t>(Reg::XPSR);
+    uint32_t msb = BITS_PER_WORD - 1;
+    uint32_t mask_msb = ~(0x1U << msb);
+    uint32_t xpsr = regs[r];
+    uint32_t op0 = xpsrFlagsOp0;
+    uint32_t op1 = xpsrFlagsOp1;
+    uint32_t tmp0, tmp1;
+
+    xpsr = setXpsrZ(xpsr, (xpsrFlagsRes == 0) ? 0x1 : 0x0);
+    xpsr = setXpsrN(xpsr, xpsrFlagsRes >> msb);
+
+    if (xpsrFlagsOp == XpsrFlagsOp::NZC || xpsrFlagsOp == XpsrFlagsOp::NZCV)
+    {
+        /* Compute the carry out of the first (bits-1) bits */
+        tmp0 = ((op0 & mask_msb) + (op1 & mask_msb) + xpsrFlagsCarry) >> msb;
+        /* Compute the carry out of the full addition */
+        tmp1 = (tmp0 + (op0 >> msb) + (op1 >> msb)) >> 1;
+        xpsr = setXpsrC(xpsr, tmp1);
+
+        if (xpsrFlagsOp == XpsrFlagsOp::NZCV)
+        {
+            xpsr = setXpsrV(xpsr, tmp0 ^ tmp1);
+            xpsr = setXpsrQ(xpsr, 0x0);
+        }
+    }
+
+    regs[r] = xpsr;
+    xpsrFlagsOp = XpsrFlagsOp::NONE;
 }
 
 Reg RegFile::uint32ToReg(uint32_t reg)
@@ -37,33 +37,76 @@ class CmdLineArgs
 {
 public:
     char *bin{ nullptr };
-    uint32_t memSizeWords{ MEM_SIZE_WORDS };
-    uint32_t memAccessWidthWords{ MEM_ACCESS_WIDTH_WORDS };
+    bool checkDecoder{ false };
+    SimulatorConfig config;
 
     static constexpr const char *HELP_MSG =
         "Thumb timing simulator.\n"
         "\n"
-        "USAGE: %s -b <file> [-m <val> | -w <val> | -h]\n"
+        "USAGE: %s -b <file> [-m <val> | -w <val> | -a <val> | -o <val> |\n"
+        "       -q <val> | -p <val> | -d | -I <cfg> | -D <cfg> | -F <cfg> |\n"
+        "       -B <cfg> | -L <val> | -W <val> | -r <file> | -l |\n"
+        "       -f <val> | -u <addr> | -s <val> | -t | -c | -h]\n"
         "\n"
         "  -m    Memory size (words). Default: %" PRIu32 "\n"
         "  -w    Memory access width (words). Default: %" PRIu32 "\n"
+        "  -a    Memory latency (cycles). Default: %" PRIu32 "\n"
+        "  -o    Memory requests in flight at the same time. Default: %" PRIu32
+        "\n"
+        "  -q    Lines that fetch requests ahead of the next instruction.\n"
+        "        Default: %" PRIu32 "\n"
+        "  -p    Memory arbitration between fetch and execute requests, one\n"
+        "        of execute, fetch or round-robin. Default: execute\n"
+        "  -d    Give fetches a memory port of their own, separate from the\n"
+        "        one used by loads and stores\n"
+        "  -I    Instruction cache as <size>,<line>,<ways>,<policy>[,<wr>]\n"
+        "        with sizes in bytes, policy lru, fifo or random and write\n"
+        "        policy wr as wb or wt. Default: wb\n"
+        "  -D    Data cache, configured as for -I\n"
+        "  -F    Fetch accelerator as <lines>,<targets>[,noprefetch] with\n"
+        "        the number of line buffers and of branch target buffers\n"
+        "  -B    Branch predictor as <type>[,<btb>[,<counters>]] with type\n"
+        "        static, bimodal or gshare and the number of entries of the\n"
+        "        branch target buffer and of the table of counters.\n"
+        "        Defaults: %" PRIu32 " and %" PRIu32 "\n"
+        "  -L    Loop buffer that replays backward loops of up to this\n"
+        "        many halfwords without fetching them. Typical value:\n"
+        "        %" PRIu32 "\n"
+        "  -W    Write buffer that holds this many stores, letting them\n"
+        "        retire before the memory takes them. Typical value:\n"
+        "        %" PRIu32 "\n"
+        "  -r    Memory region map file, one region per line as\n"
+        "        <base> <size> <read wait> <write wait> <width> [ro]\n"
+        "  -l    Transfer the registers of multiple loads and stores that\n"
+        "        fall in the same access width line in one request\n"
         "  -b    Program binary file\n"
+        "  -f    Run this many instructions without timing before\n"
+        "        simulating the pipeline\n"
+        "  -u    Run without timing until the pc reaches this address\n"
+        "  -s    Reuse the timing of blocks without memory accesses, fully\n"
+        "        simulating one in this many visits (0 for never)\n"
+        "  -t    Run the instructions without timing (-f and -u) with a\n"
+        "        direct-threaded interpreter\n"
+        "  -c    Check the decode table against the reference decoder\n"
         "  -h    Prints this help message\n";
 };
 
 int Simulator::run(char *programBinFile)
 {
-    return run(programBinFile, MEM_SIZE_WORDS, MEM_ACCESS_WIDTH_WORDS);
+    return run(programBinFile, SimulatorConfig());
 }
 
-int Simulator::run(char *programBinFile,
-                   uint32_t memSizeWordsIn,
-                   uint32_t memAccessWidthWordsIn)
+int Simulator::run(char *programBinFile, const SimulatorConfig &config)
 {
     int ret;
     uint32_t cycle = 0;
+    uint64_t fastForwardInsts = config.fastForwardInsts;
 
-    proc = new Processor(memSizeWordsIn, memAccessWidthWordsIn);
+    proc = new Processor(config.memSizeWords,
+                         config.memAccessWidthWords,
+                         config.memLatencyCycles,
+                         config.memMaxOutstanding,
+                         config.fetchQueueDepth);
 
     /* Avoid compiler warnings when not debugging */
     (void)cycle;
@@ -74,6 +117,56 @@ int Simulator::run(char *programBinFile,
         return ret;
     }
 
+    if (config.regionMapFile != nullptr &&
+        (ret = proc->loadRegionMap(config.regionMapFile)) != 0)
+    {
+        fprintf(stderr, "Failed to load memory region map (%d)\n", ret);
+        return ret;
+    }
+
+    proc->setThreadedDispatch(config.threadedDispatch);
+    proc->setBurstTransfers(config.burstTransfers);
+    proc->setMemArbitration(config.memArbitration);
+    proc->setSeparateMemPorts(config.separateMemPorts);
+    if (config.hasInstCache)
+    {
+        proc->setInstCache(config.instCache);
+    }
+    if (config.hasDataCache)
+    {
+        proc->setDataCache(config.dataCache);
+    }
+    if (config.hasFetchAccel)
+    {
+        proc->setFetchAccelerator(config.fetchAccel);
+    }
+    if (config.hasPredictor)
+    {
+        proc->setBranchPredictor(config.predictor);
+    }
+    if (config.loopBufferEntries > 0)
+    {
+        proc->setLoopBuffer(config.loopBufferEntries);
+    }
+    if (config.writeBufferEntries > 0)
+    {
+        proc->setWriteBuffer(config.writeBufferEntries);
+    }
+    if (config.timingMemo)
+    {
+        proc->setTimingMemo(config.timingMemoVerify);
+    }
+
+    if (fastForwardInsts > 0 || config.fastForwardAddr != FAST_FORWARD_NO_ADDR)
+    {
+        if (fastForwardInsts == 0)
+        {
+            /* Only stop when reaching the address */
+            fastForwardInsts = UINT64_MAX;
+        }
+        proc->fastForward(fastForwardInsts, config.fastForwardAddr);
+    }
+
     do
     {
         DEBUG_CMD(DEBUG_ALL, printf("== cycle %" PRIu32 " ==\n", cycle++));
@@ -84,12 +177,24 @@ int Simulator::run(char *programBinFile,
     return 0;
 }
 
+int Simulator::checkDecoder()
+{
+    int ret;
+
+    proc = new Processor(MEM_SIZE_WORDS, MEM_ACCESS_WIDTH_WORDS);
+    ret = proc->checkDecoder();
+    delete proc;
+
+    return ret;
+}
+
 int main(int argc, char **argv)
 {
     Simulator sim;
     CmdLineArgs args;
     int i;
     int converted;
+    char *end;
 
     /* Parse command line arguments */
     for (i = 1; i < argc; i++)
@@ -99,7 +204,14 @@ int main(int argc, char **argv)
             printf(CmdLineArgs::HELP_MSG,
                    argv[0],
                    MEM_SIZE_WORDS,
-                   MEM_ACCESS_WIDTH_WORDS);
+                   MEM_ACCESS_WIDTH_WORDS,
+                   MEM_LATENCY_CYCLES,
+                   MEM_MAX_OUTSTANDING,
+                   FETCH_QUEUE_DEPTH,
+                   BRANCH_TARGET_BUFFER_ENTRIES,
+                   BRANCH_PREDICTOR_COUNTERS,
+                   LOOP_BUFFER_ENTRIES,
+                   WRITE_BUFFER_ENTRIES);
             return EXIT_SUCCESS;
         }
         else if (strcmp(argv[i], "-m") == 0)
@@ -120,7 +232,7 @@ int main(int argc, char **argv)
             }
             else
             {
-                args.memSizeWords = static_cast<uint32_t>(converted);
+                args.config.memSizeWords = static_cast<uint32_t>(converted);
             }
         }
         else if (strcmp(argv[i], "-w") == 0)
@@ -141,7 +253,218 @@ int main(int argc, char **argv)
             }
             else
             {
-                args.memAccessWidthWords = static_cast<uint32_t>(converted);
+                args.config.memAccessWidthWords =
+                    static_cast<uint32_t>(converted);
+            }
+        }
+        else if (strcmp(argv[i], "-a") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -a requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            converted = atoi(argv[i]);
+            if (converted <= 0)
+            {
+                fprintf(stderr, "Invalid value %s for -a\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            else
+            {
+                args.config.memLatencyCycles = static_cast<uint32_t>(converted);
+            }
+        }
+        else if (strcmp(argv[i], "-o") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -o requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            converted = atoi(argv[i]);
+            if (converted <= 0)
+            {
+                fprintf(stderr, "Invalid value %s for -o\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            else
+            {
+                args.config.memMaxOutstanding =
+                    static_cast<uint32_t>(converted);
+            }
+        }
+        else if (strcmp(argv[i], "-q") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -q requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            converted = atoi(argv[i]);
+            if (converted <= 0)
+            {
+                fprintf(stderr, "Invalid value %s for -q\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            else
+            {
+                args.config.fetchQueueDepth = static_cast<uint32_t>(converted);
+            }
+        }
+        else if (strcmp(argv[i], "-p") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -p requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            if (strcmp(argv[i], "execute") == 0)
+            {
+                args.config.memArbitration = MemoryArbitration::EXECUTE_FIRST;
+            }
+            else if (strcmp(argv[i], "fetch") == 0)
+            {
+                args.config.memArbitration = MemoryArbitration::FETCH_FIRST;
+            }
+            else if (strcmp(argv[i], "round-robin") == 0)
+            {
+                args.config.memArbitration = MemoryArbitration::ROUND_ROBIN;
+            }
+            else
+            {
+                fprintf(stderr, "Invalid value %s for -p\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "-d") == 0)
+        {
+            args.config.separateMemPorts = true;
+        }
+        else if (strcmp(argv[i], "-I") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -I requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            if (Cache::parseConfig(argv[i], args.config.instCache) != 0)
+            {
+                fprintf(stderr, "Invalid value %s for -I\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            args.config.hasInstCache = true;
+        }
+        else if (strcmp(argv[i], "-D") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -D requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            if (Cache::parseConfig(argv[i], args.config.dataCache) != 0)
+            {
+                fprintf(stderr, "Invalid value %s for -D\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            args.config.hasDataCache = true;
+        }
+        else if (strcmp(argv[i], "-F") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -F requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            if (FetchAccelerator::parseConfig(argv[i],
+                                              args.config.fetchAccel) != 0)
+            {
+                fprintf(stderr, "Invalid value %s for -F\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            args.config.hasFetchAccel = true;
+        }
+        else if (strcmp(argv[i], "-B") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -B requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            if (BranchPredictor::parseConfig(argv[i],
+                                             args.config.predictor) != 0)
+            {
+                fprintf(stderr, "Invalid value %s for -B\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            args.config.hasPredictor = true;
+        }
+        else if (strcmp(argv[i], "-L") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -L requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            converted = atoi(argv[i]);
+            if (converted <= 0)
+            {
+                fprintf(stderr, "Invalid value %s for -L\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            else
+            {
+                args.config.loopBufferEntries =
+                    static_cast<uint32_t>(converted);
+            }
+        }
+        else if (strcmp(argv[i], "-W") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -W requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            converted = atoi(argv[i]);
+            if (converted <= 0)
+            {
+                fprintf(stderr, "Invalid value %s for -W\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            else
+            {
+                args.config.writeBufferEntries =
+                    static_cast<uint32_t>(converted);
             }
         }
         else if (strcmp(argv[i], "-b") == 0)
@@ -155,6 +478,84 @@ int main(int argc, char **argv)
             }
             args.bin = argv[i];
         }
+        else if (strcmp(argv[i], "-r") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -r requires an argument\n");
+                return EXIT_FAILURE;
+            }
+            args.config.regionMapFile = argv[i];
+        }
+        else if (strcmp(argv[i], "-l") == 0)
+        {
+            args.config.burstTransfers = true;
+        }
+        else if (strcmp(argv[i], "-f") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -f requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            args.config.fastForwardInsts = strtoull(argv[i], &end, 0);
+            if (*end != '\0' || args.config.fastForwardInsts == 0)
+            {
+                fprintf(stderr, "Invalid value %s for -f\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "-u") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -u requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            /* Ignore the Thumb bit if the address comes from a pointer */
+            args.config.fastForwardAddr =
+                static_cast<uint32_t>(strtoul(argv[i], &end, 0)) & ~0x1;
+            if (*end != '\0')
+            {
+                fprintf(stderr, "Invalid value %s for -u\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "-s") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -s requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            args.config.timingMemo = true;
+            args.config.timingMemoVerify =
+                static_cast<uint32_t>(strtoul(argv[i], &end, 0));
+            if (*end != '\0')
+            {
+                fprintf(stderr, "Invalid value %s for -s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "-t") == 0)
+        {
+            args.config.threadedDispatch = true;
+        }
+        else if (strcmp(argv[i], "-c") == 0)
+        {
+            args.checkDecoder = true;
+        }
         else
         {
             fprintf(stderr, "Unrecognized option '%s'\n", argv[i]);
@@ -168,13 +569,52 @@ int main(int argc, char **argv)
         printf("%s%c", argv[i], (i + 1 == argc) ? '\n' : ' ');
     }
 
-    if (args.bin == nullptr)
+    if (args.checkDecoder)
+    {
+        return (sim.checkDecoder() == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    else if (args.bin == nullptr)
     {
         fprintf(stderr, "A program binary is needed to run the simulator\n");
         return EXIT_FAILURE;
     }
+    else if (args.config.timingMemo && args.config.hasInstCache)
+    {
+        /* Replayed blocks do not fetch, so the cache would miss their lines */
+        fprintf(stderr, "Option -s cannot be used with -I\n");
+        return EXIT_FAILURE;
+    }
+    else if (args.config.timingMemo && args.config.hasFetchAccel)
+    {
+        fprintf(stderr, "Option -s cannot be used with -F\n");
+        return EXIT_FAILURE;
+    }
+    else if (args.config.timingMemo && args.config.hasPredictor)
+    {
+        /* Replayed blocks do not go through the predictor to train it */
+        fprintf(stderr, "Option -s cannot be used with -B\n");
+        return EXIT_FAILURE;
+    }
+    else if (args.config.timingMemo && args.config.loopBufferEntries > 0)
+    {
+        /* Replayed blocks do not go through fetch to fill the loop buffer */
+        fprintf(stderr, "Option -s cannot be used with -L\n");
+        return EXIT_FAILURE;
+    }
+    else if (args.config.timingMemo && args.config.writeBufferEntries > 0)
+    {
+        /* Replayed blocks do not drain the stores left in the buffer */
+        fprintf(stderr, "Option -s cannot be used with -W\n");
+        return EXIT_FAILURE;
+    }
+    else if (args.config.hasInstCache && args.config.hasFetchAccel)
+    {
+        /* Both sit in front of the memory on the fetch path */
+        fprintf(stderr, "Option -I cannot be used with -F\n");
+        return EXIT_FAILURE;
+    }
 
-    if (sim.run(args.bin, args.memSizeWords, args.memAccessWidthWords) != 0)
+    if (sim.run(args.bin, args.config) != 0)
     {
         return EXIT_FAILURE;
     }
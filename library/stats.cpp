@@ -30,7 +30,6 @@
 #include <cstdio>
 #include <cstdlib>
 #include <string>
-#include <unordered_map>
 
 #define MAKE_INC_FUNCTION(func_name, member) \
     void Statistics::add##func_name()        \
@@ -43,9 +42,51 @@ MAKE_INC_FUNCTION(FetchCycle, fetchMemCycles)
 MAKE_INC_FUNCTION(ExecuteCycle, executeMemCycles)
 
 MAKE_INC_FUNCTION(StallForDecodeCycle, stalledForDecodeCycles)
+MAKE_INC_FUNCTION(FetchStallForMemCycle, fetchStalledForMemCycles)
+MAKE_INC_FUNCTION(ExecuteStallForMemCycle, executeStalledForMemCycles)
+MAKE_INC_FUNCTION(MemWaitCycle, memWaitCycles)
+MAKE_INC_FUNCTION(FetchQueueFlushedEntry, fetchQueueFlushedEntries)
+MAKE_INC_FUNCTION(FetchArbitrationLoss, fetchArbitrationLosses)
+MAKE_INC_FUNCTION(ExecuteArbitrationLoss, executeArbitrationLosses)
+
+MAKE_INC_FUNCTION(MultipleMemRequest, multipleMemRequests)
+
+MAKE_INC_FUNCTION(FetchAccelMiss, fetchAccelMisses)
+MAKE_INC_FUNCTION(FetchAccelPrefetch, fetchAccelPrefetches)
+MAKE_INC_FUNCTION(FetchAccelWastedPrefetch, fetchAccelWastedPrefetches)
 
 MAKE_INC_FUNCTION(BranchTaken, branchTaken)
 MAKE_INC_FUNCTION(BranchNotTaken, branchNotTaken)
+MAKE_INC_FUNCTION(LoopBufferSavedRequest, loopBufferSavedRequests)
+
+MAKE_INC_FUNCTION(WriteBufferStore, writeBufferStores)
+MAKE_INC_FUNCTION(WriteBufferFullStall, writeBufferFullStalls)
+MAKE_INC_FUNCTION(WriteBufferForward, writeBufferForwards)
+MAKE_INC_FUNCTION(WriteBufferDrainStall, writeBufferDrainStalls)
+
+MAKE_INC_FUNCTION(DecodeCacheHit, decodeCacheHits)
+MAKE_INC_FUNCTION(DecodeCacheMiss, decodeCacheMisses)
+
+MAKE_INC_FUNCTION(DecodedInstAllocation, decodedInstAllocations)
+
+MAKE_INC_FUNCTION(FastForwardedInst, fastForwardedInsts)
+
+MAKE_INC_FUNCTION(MemoizedBlock, memoizedBlocks)
+MAKE_INC_FUNCTION(MemoizedBlockMismatch, memoizedBlockMismatches)
+
+#define MAKE_ADD_FUNCTION(func_name, member)          \
+    void Statistics::add##func_name(uint64_t count) \
+    {                                                 \
+        member += count;                              \
+    }
+
+MAKE_ADD_FUNCTION(Cycles, cycles)
+MAKE_ADD_FUNCTION(BranchesTaken, branchTaken)
+MAKE_ADD_FUNCTION(BranchesNotTaken, branchNotTaken)
+MAKE_ADD_FUNCTION(BranchPredictorSavedCycles, branchPredictorSavedCycles)
+MAKE_ADD_FUNCTION(MultipleMemWords, multipleMemWords)
+MAKE_ADD_FUNCTION(FetchQueueEntries, fetchQueueEntries)
+MAKE_ADD_FUNCTION(FastForwardedInsts, fastForwardedInsts)
 
 #define MAKE_SET_FUNCTION(func_name, member, type) \
     void Statistics::set##func_name(type size)     \
@@ -56,24 +97,173 @@ MAKE_INC_FUNCTION(BranchNotTaken, branchNotTaken)
 MAKE_SET_FUNCTION(ProgramSizeBytes, programSizeBytes, uint32_t)
 MAKE_SET_FUNCTION(MemSizeWords, memSizeWords, uint32_t)
 MAKE_SET_FUNCTION(MemAccessWidthWords, memAccessWidthWords, uint32_t)
+MAKE_SET_FUNCTION(MemLatencyCycles, memLatencyCycles, uint32_t)
+MAKE_SET_FUNCTION(MemMaxOutstanding, memMaxOutstanding, uint32_t)
+MAKE_SET_FUNCTION(MemSeparatePorts, memSeparatePorts, bool)
+MAKE_SET_FUNCTION(FetchQueueDepth, fetchQueueDepth, uint32_t)
+MAKE_SET_FUNCTION(InstCacheConfig, instCacheConfig, std::string)
+MAKE_SET_FUNCTION(DataCacheConfig, dataCacheConfig, std::string)
+MAKE_SET_FUNCTION(FetchAccelConfig, fetchAccelConfig, std::string)
+MAKE_SET_FUNCTION(BranchPredictorConfig, branchPredictorConfig, std::string)
+MAKE_SET_FUNCTION(LoopBufferEntries, loopBufferEntries, uint32_t)
+MAKE_SET_FUNCTION(WriteBufferEntries, writeBufferEntries, uint32_t)
+
+/*
+ * Discard everything recorded so far except the system configuration and the
+ * number of instructions that were not timed
+ */
+void Statistics::resetExecution()
+{
+    Statistics config;
+
+    config.programSizeBytes = programSizeBytes;
+    config.memSizeWords = memSizeWords;
+    config.memAccessWidthWords = memAccessWidthWords;
+    config.memLatencyCycles = memLatencyCycles;
+    config.memMaxOutstanding = memMaxOutstanding;
+    config.memSeparatePorts = memSeparatePorts;
+    config.fetchQueueDepth = fetchQueueDepth;
+    config.instCacheConfig = instCacheConfig;
+    config.dataCacheConfig = dataCacheConfig;
+    config.fetchAccelConfig = fetchAccelConfig;
+    config.branchPredictorConfig = branchPredictorConfig;
+    config.loopBufferEntries = loopBufferEntries;
+    config.writeBufferEntries = writeBufferEntries;
+    config.fastForwardedInsts = fastForwardedInsts;
+
+    *this = config;
+}
 
-#define MAKE_ADD_TO_UMAP_FUNCTION(func_name, member, type) \
-    void Statistics::add##func_name(type key)              \
-    {                                                      \
-        const auto &iter = member.find(key);               \
-                                                           \
-        if (iter == member.end())                          \
-        {                                                  \
-            /* Object size not found */                    \
-            member.insert({ key, 1 });                     \
-        }                                                  \
-        else                                               \
-        {                                                  \
-            /* Object size already in the map */           \
-            iter->second = iter->second + 1;               \
-        }                                                  \
+void Statistics::getPipelineCounters(PipelineCounters &counters)
+{
+    counters.cycles = cycles;
+    counters.fetchMemCycles = fetchMemCycles;
+    counters.executeMemCycles = executeMemCycles;
+    counters.stalledForDecodeCycles = stalledForDecodeCycles;
+    counters.fetchStalledForMemCycles = fetchStalledForMemCycles;
+    counters.executeStalledForMemCycles = executeStalledForMemCycles;
+    counters.memWaitCycles = memWaitCycles;
+    counters.fetchQueueEntries = fetchQueueEntries;
+    counters.fetchQueueFlushedEntries = fetchQueueFlushedEntries;
+}
+
+void Statistics::setPipelineCounters(PipelineCounters &counters)
+{
+    cycles = counters.cycles;
+    fetchMemCycles = counters.fetchMemCycles;
+    executeMemCycles = counters.executeMemCycles;
+    stalledForDecodeCycles = counters.stalledForDecodeCycles;
+    fetchStalledForMemCycles = counters.fetchStalledForMemCycles;
+    executeStalledForMemCycles = counters.executeStalledForMemCycles;
+    memWaitCycles = counters.memWaitCycles;
+    fetchQueueEntries = counters.fetchQueueEntries;
+    fetchQueueFlushedEntries = counters.fetchQueueFlushedEntries;
+}
+
+uint64_t Statistics::getBranchesNotTaken()
+{
+    return branchNotTaken;
+}
+
+#define MAKE_ADD_TO_ARRAY_FUNCTION(func_name, member, type) \
+    void Statistics::add##func_name(type key)               \
+    {                                                       \
+        member[static_cast<std::size_t>(key)]++;            \
     }
-MAKE_ADD_TO_UMAP_FUNCTION(Instruction, instCount, Instruction)
+MAKE_ADD_TO_ARRAY_FUNCTION(Instruction, instCount, Instruction)
+MAKE_ADD_TO_ARRAY_FUNCTION(DecodedOperation, decodedOpCount, DecodedOperation)
+
+#define MAKE_ADD_COUNT_TO_ARRAY_FUNCTION(func_name, member, type) \
+    void Statistics::add##func_name(type key, uint64_t count)     \
+    {                                                             \
+        member[static_cast<std::size_t>(key)] += count;           \
+    }
+MAKE_ADD_COUNT_TO_ARRAY_FUNCTION(Instructions, instCount, Instruction)
+MAKE_ADD_COUNT_TO_ARRAY_FUNCTION(DecodedOperations,
+                                 decodedOpCount,
+                                 DecodedOperation)
+
+void Statistics::addCacheAccess(CacheCounters &counters,
+                                CacheAccessResult result)
+{
+    if (result == CacheAccessResult::HIT)
+    {
+        counters.hits++;
+        return;
+    }
+
+    counters.misses++;
+    if (result == CacheAccessResult::EVICTION ||
+        result == CacheAccessResult::WRITE_BACK)
+    {
+        counters.evictions++;
+    }
+    if (result == CacheAccessResult::WRITE_BACK)
+    {
+        counters.writeBacks++;
+    }
+}
+
+void Statistics::addInstCacheAccess(CacheAccessResult result)
+{
+    addCacheAccess(instCacheCounters, result);
+}
+
+void Statistics::addDataCacheAccess(CacheAccessResult result)
+{
+    addCacheAccess(dataCacheCounters, result);
+}
+
+void Statistics::addFetchAccelHit(bool branchTarget)
+{
+    fetchAccelHits++;
+    if (branchTarget)
+    {
+        fetchAccelTargetHits++;
+    }
+}
+
+void Statistics::addBranchPrediction(bool correct)
+{
+    branchPredictions++;
+    if (correct)
+    {
+        branchPredictionsCorrect++;
+    }
+}
+
+void Statistics::addLoopBufferIteration(uint64_t cycles,
+                                        uint64_t fetchedCycles)
+{
+    loopBufferIterations++;
+    loopBufferCycles += cycles;
+    loopBufferFetchedCycles += fetchedCycles;
+}
+
+void Statistics::printCacheCounters(std::string &prefix,
+                                    const char *name,
+                                    CacheCounters &counters)
+{
+    uint64_t accesses = counters.hits + counters.misses;
+
+    printf("%s%s cache hits: %" PRIu64 " %%%f\n",
+           prefix.c_str(),
+           name,
+           counters.hits,
+           (accesses == 0) ?
+               0.0f :
+               100.0f * ((float)counters.hits / (float)accesses));
+    printf("%s%s cache misses: %" PRIu64 "\n",
+           prefix.c_str(),
+           name,
+           counters.misses);
+    printf("%s%s cache evictions: %" PRIu64 " (%" PRIu64
+           " write-backs)\n",
+           prefix.c_str(),
+           name,
+           counters.evictions,
+           counters.writeBacks);
+}
 
 std::string Statistics::getInstructionStr(Instruction inst)
 {
@@ -227,14 +417,55 @@ void Statistics::print()
     printf("== Simulation statistics ==\n");
 
     printf("System configuration:\n");
-    printf("%sMemory size: %" PRIu32 " bytes (%" PRIu32 " words)\n",
+    printf("%sMemory size: %" PRIu64 " bytes (%" PRIu32 " words)\n",
            prefix.c_str(),
-           WORD_TO_BYTE_SIZE(memSizeWords),
+           WORD_TO_BYTE_SIZE(static_cast<uint64_t>(memSizeWords)),
            memSizeWords);
     printf("%sMemory access width: %" PRIu32 " bytes (%" PRIu32 " words)\n",
            prefix.c_str(),
            WORD_TO_BYTE_SIZE(memAccessWidthWords),
            memAccessWidthWords);
+    printf("%sMemory latency: %" PRIu32 " cycles (%" PRIu32
+           " outstanding requests)\n",
+           prefix.c_str(),
+           memLatencyCycles,
+           memMaxOutstanding);
+    printf("%sMemory ports: %s\n",
+           prefix.c_str(),
+           memSeparatePorts ? "separate fetch and data" : "shared");
+    printf("%sFetch queue depth: %" PRIu32 " lines\n",
+           prefix.c_str(),
+           fetchQueueDepth);
+    printf("%sInstruction cache: %s\n",
+           prefix.c_str(),
+           instCacheConfig.c_str());
+    printf("%sData cache: %s\n", prefix.c_str(), dataCacheConfig.c_str());
+    printf("%sFetch accelerator: %s\n",
+           prefix.c_str(),
+           fetchAccelConfig.c_str());
+    printf("%sBranch predictor: %s\n",
+           prefix.c_str(),
+           branchPredictorConfig.c_str());
+    if (loopBufferEntries == 0)
+    {
+        printf("%sLoop buffer: none\n", prefix.c_str());
+    }
+    else
+    {
+        printf("%sLoop buffer: %" PRIu32 " halfwords\n",
+               prefix.c_str(),
+               loopBufferEntries);
+    }
+    if (writeBufferEntries == 0)
+    {
+        printf("%sWrite buffer: none\n", prefix.c_str());
+    }
+    else
+    {
+        printf("%sWrite buffer: %" PRIu32 " entries\n",
+               prefix.c_str(),
+               writeBufferEntries);
+    }
 
     printf("\n");
 
@@ -252,6 +483,13 @@ void Statistics::print()
            prefix.c_str(),
            unusedMemCycles,
            100.0f * ((float)unusedMemCycles / (float)cycles));
+    printf("%sMultiple transfer requests: %" PRIu64 " (%f words per "
+           "request)\n",
+           prefix.c_str(),
+           multipleMemRequests,
+           (multipleMemRequests == 0) ?
+               0.0f :
+               (float)multipleMemWords / (float)multipleMemRequests);
 
     printf("\n");
 
@@ -260,6 +498,110 @@ void Statistics::print()
            prefix.c_str(),
            stalledForDecodeCycles,
            100.0f * ((float)stalledForDecodeCycles / (float)cycles));
+    printf("%sFetch stalled for memory cycles: %" PRIu64 " %%%f\n",
+           prefix.c_str(),
+           fetchStalledForMemCycles,
+           100.0f * ((float)fetchStalledForMemCycles / (float)cycles));
+    printf("%sExecute stalled for memory cycles: %" PRIu64 " %%%f\n",
+           prefix.c_str(),
+           executeStalledForMemCycles,
+           100.0f * ((float)executeStalledForMemCycles / (float)cycles));
+    printf("%sWrite buffer stores: %" PRIu64 " (%" PRIu64
+           " loads forwarded)\n",
+           prefix.c_str(),
+           writeBufferStores,
+           writeBufferForwards);
+    printf("%sWrite buffer full stall cycles: %" PRIu64 " %%%f\n",
+           prefix.c_str(),
+           writeBufferFullStalls,
+           100.0f * ((float)writeBufferFullStalls / (float)cycles));
+    printf("%sWrite buffer drain stall cycles: %" PRIu64 " %%%f\n",
+           prefix.c_str(),
+           writeBufferDrainStalls,
+           100.0f * ((float)writeBufferDrainStalls / (float)cycles));
+    printf("%sMemory wait cycles: %" PRIu64 " %%%f\n",
+           prefix.c_str(),
+           memWaitCycles,
+           100.0f * ((float)memWaitCycles / (float)cycles));
+    printf("%sFetch queue occupancy: %f lines per cycle\n",
+           prefix.c_str(),
+           (float)fetchQueueEntries / (float)cycles);
+    printf("%sFetch queue flushed lines: %" PRIu64 "\n",
+           prefix.c_str(),
+           fetchQueueFlushedEntries);
+    printf("%sBranch predictions: %" PRIu64 " %%%f correct\n",
+           prefix.c_str(),
+           branchPredictions,
+           (branchPredictions == 0) ?
+               0.0f :
+               100.0f * ((float)branchPredictionsCorrect /
+                         (float)branchPredictions));
+    printf("%sBranch predictor saved cycles: %" PRIu64 "\n",
+           prefix.c_str(),
+           branchPredictorSavedCycles);
+    printf("%sLoop buffer saved memory requests: %" PRIu64 "\n",
+           prefix.c_str(),
+           loopBufferSavedRequests);
+    printf("%sLoop buffer saved cycles: %" PRId64 " (%" PRIu64
+           " iterations replayed)\n",
+           prefix.c_str(),
+           static_cast<int64_t>(loopBufferFetchedCycles - loopBufferCycles),
+           loopBufferIterations);
+    printf("%sFetch arbitration losses: %" PRIu64 " %%%f\n",
+           prefix.c_str(),
+           fetchArbitrationLosses,
+           100.0f * ((float)fetchArbitrationLosses / (float)cycles));
+    printf("%sExecute arbitration losses: %" PRIu64 " %%%f\n",
+           prefix.c_str(),
+           executeArbitrationLosses,
+           100.0f * ((float)executeArbitrationLosses / (float)cycles));
+
+    printf("\n");
+
+    printf("Cache information:\n");
+    printCacheCounters(prefix, "Instruction", instCacheCounters);
+    printCacheCounters(prefix, "Data", dataCacheCounters);
+    printf("%sFetch accelerator hits: %" PRIu64 " %%%f (%" PRIu64
+           " branch targets)\n",
+           prefix.c_str(),
+           fetchAccelHits,
+           (fetchAccelHits + fetchAccelMisses == 0) ?
+               0.0f :
+               100.0f * ((float)fetchAccelHits /
+                         (float)(fetchAccelHits + fetchAccelMisses)),
+           fetchAccelTargetHits);
+    printf("%sFetch accelerator misses: %" PRIu64 "\n",
+           prefix.c_str(),
+           fetchAccelMisses);
+    printf("%sFetch accelerator prefetches: %" PRIu64 " (%" PRIu64
+           " wasted)\n",
+           prefix.c_str(),
+           fetchAccelPrefetches,
+           fetchAccelWastedPrefetches);
+
+    printf("\n");
+
+    printf("Simulator information:\n");
+    printf("%sDecode cache hits: %" PRIu64 " %%%f\n",
+           prefix.c_str(),
+           decodeCacheHits,
+           (decodeCacheHits + decodeCacheMisses == 0) ?
+               0.0f :
+               100.0f * ((float)decodeCacheHits /
+                         (float)(decodeCacheHits + decodeCacheMisses)));
+    printf("%sDecode cache misses: %" PRIu64 "\n",
+           prefix.c_str(),
+           decodeCacheMisses);
+    printf("%sDecoded instruction heap allocations: %" PRIu64 "\n",
+           prefix.c_str(),
+           decodedInstAllocations);
+    printf("%sFast-forwarded instructions: %" PRIu64 "\n",
+           prefix.c_str(),
+           fastForwardedInsts);
+    printf("%sMemoized blocks: %" PRIu64 "\n", prefix.c_str(), memoizedBlocks);
+    printf("%sMemoized block mismatches: %" PRIu64 "\n",
+           prefix.c_str(),
+           memoizedBlockMismatches);
 
     printf("\n");
 
@@ -277,23 +619,33 @@ void Statistics::print()
     uint64_t stores = 0;
     uint64_t loads = 0;
     uint64_t other = 0;
-    for (auto iter = instCount.begin(); iter != instCount.end(); ++iter)
+    uint64_t count;
+    std::size_t i;
+    Instruction inst;
+    for (i = 0; i < instCount.size(); i++)
     {
+        count = instCount[i];
+        if (count == 0)
+        {
+            continue;
+        }
+
+        inst = static_cast<Instruction>(i);
         printf("%s%-6s %" PRIu64 "\n",
                prefix.c_str(),
-               Statistics::getInstructionStr(iter->first).c_str(),
-               iter->second);
+               Statistics::getInstructionStr(inst).c_str(),
+               count);
 
-        totalInst = totalInst + iter->second;
+        totalInst = totalInst + count;
 
         /* Classify instructions by type */
-        switch (iter->first)
+        switch (inst)
         {
             case Instruction::B:
             case Instruction::BL:
             case Instruction::BLX:
             case Instruction::BX:
-                branches = branches + iter->second;
+                branches = branches + count;
                 break;
 
             case Instruction::LDMIA:
@@ -302,7 +654,7 @@ void Statistics::print()
             case Instruction::LDRH:
             case Instruction::LDRSB:
             case Instruction::LDRSH:
-                loads = loads + iter->second;
+                loads = loads + count;
                 break;
 
             case Instruction::PUSH:
@@ -310,11 +662,11 @@ void Statistics::print()
             case Instruction::STR:
             case Instruction::STRB:
             case Instruction::STRH:
-                stores = stores + iter->second;
+                stores = stores + count;
                 break;
 
             default:
-                other = other + iter->second;
+                other = other + count;
                 break;
         }
     }
@@ -370,4 +722,23 @@ void Statistics::print()
            other,
            100.0f * ((float)other / (float)totalInst));
     printf("%s%-7s %" PRIu64 "\n", prefix.c_str(), "Total", totalInst);
+
+    printf("\n");
+
+    printf("Encoding execution:\n");
+    for (i = 0; i < decodedOpCount.size(); i++)
+    {
+        count = decodedOpCount[i];
+        if (count == 0)
+        {
+            continue;
+        }
+
+        printf("%s%-6s %" PRIu64 "\n",
+               prefix.c_str(),
+               DecodedInst::getOperationString(
+                   static_cast<DecodedOperation>(i))
+                   .c_str(),
+               count);
+    }
 }
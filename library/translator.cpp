@@ -0,0 +1,1089 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "simulator/translator.h"
+
+#include "simulator/aot.h"
+#include "simulator/config.h"
+#include "simulator/decode.h"
+#include "simulator/memory.h"
+#include "simulator/regfile.h"
+#include "simulator/stats.h"
+#include "simulator/utils.h"
+
+#include <cctype>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+/* Shorthands for the operands of the decoded instruction being emitted */
+#define READ(index) readReg(inst, DecodedInstRegIndex::index).c_str()
+#define WRITE(index) writeReg(inst, DecodedInstRegIndex::index).c_str()
+
+class CmdLineArgs
+{
+public:
+    char *bin{ nullptr };
+    char *out{ nullptr };
+    uint32_t memSizeWords{ MEM_SIZE_WORDS };
+
+    static constexpr const char *HELP_MSG =
+        "Translate a Thumb program binary into C++ ahead of time.\n"
+        "\n"
+        "USAGE: %s -b <file> -o <file> [-m <val> | -h]\n"
+        "\n"
+        "  -m    Memory size (words). Default: %" PRIu32 "\n"
+        "  -b    Program binary file\n"
+        "  -o    Output C++ file, build it with 'make <name>.aot'\n"
+        "  -h    Prints this help message\n";
+};
+
+/* Name of an enum value in the generated code from its printable string */
+static std::string toEnumName(std::string str)
+{
+    std::size_t i;
+
+    for (i = 0; i < str.size(); i++)
+    {
+        str[i] = static_cast<char>(toupper(str[i]));
+    }
+
+    return str;
+}
+
+Translator::Translator(uint32_t memSizeWordsIn)
+{
+    stats = new Statistics();
+    regFile = new RegFile();
+    mem = new Memory(memSizeWordsIn, 1);
+    decode = new Decode(nullptr, regFile, stats);
+}
+
+Translator::~Translator()
+{
+    delete stats;
+    delete regFile;
+    delete mem;
+    delete decode;
+}
+
+/*
+ * Decode the instruction at instAddr with the same decoder as the simulator
+ * and advance instAddr to the following instruction. Returns false if the
+ * instruction is not fully inside the program
+ */
+bool Translator::decodeNext(uint32_t &instAddr, DecodedInst &inst)
+{
+    uint32_t word;
+    uint16_t halfword;
+    DecodedInst *decodedInst;
+
+    do
+    {
+        if (instAddr >= programByteSize)
+        {
+            return false;
+        }
+
+        mem->loadWord(instAddr, word);
+        halfword = static_cast<uint16_t>(
+            word >> (GET_BYTE_INDEX(instAddr) * BITS_PER_BYTE));
+        decodedInst = decode->decodeFunctional(halfword, instAddr);
+        instAddr = NEXT_THUMB_INST(instAddr);
+    } while (decodedInst == nullptr);
+
+    inst = *decodedInst;
+    decode->releaseInst(decodedInst);
+
+    return true;
+}
+
+void Translator::addLeader(uint32_t addr)
+{
+    if (addr < programByteSize && leaders.insert(addr).second)
+    {
+        pendingLeaders.push_back(addr);
+    }
+}
+
+/*
+ * Work out the address of the first instruction of every basic block that
+ * is reachable through direct branches. Words of the binary are never taken
+ * to be pointers to code, as data could then be translated as instructions
+ */
+void Translator::findBlocks()
+{
+    uint32_t addr;
+    uint32_t instAddr;
+    uint32_t im;
+    DecodedInst inst;
+
+    addLeader(entryAddr);
+
+    while (!pendingLeaders.empty())
+    {
+        addr = pendingLeaders.back();
+        pendingLeaders.pop_back();
+
+        do
+        {
+            instAddr = addr;
+            if (!decodeNext(addr, inst))
+            {
+                break;
+            }
+
+            im = inst.getImmediate();
+            switch (inst.getOperation())
+            {
+                case DecodedOperation::B1:
+                    addLeader(addr);
+                    addLeader(instAddr + 4 + (aotSignExtend(im, 8) << 1));
+                    break;
+
+                case DecodedOperation::B2:
+                    addLeader(instAddr + 4 + (aotSignExtend(im, 11) << 1));
+                    break;
+
+                case DecodedOperation::BL:
+                    addLeader(addr);
+                    addLeader(addr + aotSignExtend(im, 25));
+                    break;
+
+                case DecodedOperation::BLX:
+                    addLeader(addr);
+                    break;
+
+                default:
+                    break;
+            }
+        } while (!aotEndsBlock(inst));
+    }
+}
+
+std::string Translator::readReg(DecodedInst &inst, DecodedInstRegIndex index)
+{
+    Reg reg = inst.getRegisterNumber(index);
+    char buf[32];
+
+    switch (reg)
+    {
+        case Reg::PC:
+            /* The decoder already worked out the value of the pc */
+            snprintf(buf,
+                     sizeof(buf),
+                     "0x%08" PRIX32 "u",
+                     inst.getRegisterData(index));
+            return buf;
+
+        case Reg::XPSR:
+            return "s.xpsr";
+
+        case Reg::RNONE:
+            return "0u";
+
+        default:
+            return writeReg(inst, index);
+    }
+}
+
+std::string Translator::writeReg(DecodedInst &inst, DecodedInstRegIndex index)
+{
+    Reg reg = inst.getRegisterNumber(index);
+    char buf[32];
+
+    /* Only one stack pointer is used as there are no exceptions */
+    if (reg == Reg::PSP)
+    {
+        reg = Reg::MSP;
+    }
+    else if (reg == Reg::PC || reg == Reg::XPSR || reg == Reg::RNONE)
+    {
+        fprintf(stderr,
+                "Unsupported destination register %s\n",
+                RegFile::regToStr(reg).c_str());
+        exit(1);
+    }
+
+    snprintf(buf, sizeof(buf), "s.regs[%u]", static_cast<uint32_t>(reg));
+
+    return buf;
+}
+
+/*
+ * Load multiple registers in ascending order. The base register is written
+ * back before the loads, as in the simulator
+ */
+void Translator::emitMultipleLoad(FILE *out, DecodedInst &inst)
+{
+    uint32_t regList = inst.getRegisterList() &
+        ((0x1 << REGFILE_CORE_REGS_COUNT) - 1);
+    uint32_t offset = 0;
+    uint32_t reg;
+
+    if (regList == 0)
+    {
+        fprintf(out,
+                "    aotFail(\"Multiple memory access instruction has "
+                "empty register list\");\n");
+        return;
+    }
+
+    fprintf(out, "    {\n");
+    fprintf(out, "        uint32_t base = %s;\n", READ(RN));
+    fprintf(out,
+            "        %s = base + %" PRIu32 "u;\n",
+            WRITE(RN),
+            WORD_TO_BYTE_SIZE(COUNT_SET_BITS(regList)));
+
+    while (regList != 0)
+    {
+        reg = GET_LOWEST_SET_BIT_POS(regList);
+        regList = CLEAR_LOWEST_SET_BIT(regList);
+
+        if (reg == static_cast<uint32_t>(Reg::PC))
+        {
+            fprintf(out,
+                    "        return aotBranchReturn(s, aotLoadWord(s, base + "
+                    "%" PRIu32 "u) & ~0x1u);\n",
+                    offset);
+        }
+        else
+        {
+            fprintf(out,
+                    "        s.regs[%" PRIu32 "] = aotLoadWord(s, base + "
+                    "%" PRIu32 "u);\n",
+                    reg,
+                    offset);
+        }
+        offset += BYTES_PER_WORD;
+    }
+
+    fprintf(out, "    }\n");
+}
+
+/*
+ * Store multiple registers in ascending order. The base register is written
+ * back before the registers are read, as in the simulator
+ */
+void Translator::emitMultipleStore(FILE *out, DecodedInst &inst)
+{
+    uint32_t regList = inst.getRegisterList() &
+        ((0x1 << REGFILE_CORE_REGS_COUNT) - 1);
+    uint32_t size = WORD_TO_BYTE_SIZE(COUNT_SET_BITS(regList));
+    uint32_t offset = 0;
+    uint32_t reg;
+
+    if (regList == 0)
+    {
+        fprintf(out,
+                "    aotFail(\"Multiple memory access instruction has "
+                "empty register list\");\n");
+        return;
+    }
+
+    fprintf(out, "    {\n");
+    if (inst.getOperation() == DecodedOperation::PUSH)
+    {
+        fprintf(out,
+                "        uint32_t base = %s - %" PRIu32 "u;\n",
+                READ(RN),
+                size);
+        fprintf(out, "        %s = base;\n", WRITE(RN));
+    }
+    else
+    {
+        fprintf(out, "        uint32_t base = %s;\n", READ(RN));
+        fprintf(out, "        %s = base + %" PRIu32 "u;\n", WRITE(RN), size);
+    }
+
+    while (regList != 0)
+    {
+        reg = GET_LOWEST_SET_BIT_POS(regList);
+        regList = CLEAR_LOWEST_SET_BIT(regList);
+
+        fprintf(out,
+                "        aotStoreWord(s, base + %" PRIu32 "u, s.regs[%" PRIu32
+                "]);\n",
+                offset,
+                reg);
+        offset += BYTES_PER_WORD;
+    }
+
+    fprintf(out, "    }\n");
+}
+
+/*
+ * Emit the C++ statements of an instruction. Instructions that end a block
+ * return the address of the next block to run
+ */
+void Translator::emitInst(FILE *out, DecodedInst &inst, uint32_t nextAddr)
+{
+    uint32_t im = inst.getImmediate();
+    uint32_t pc;
+
+    switch (inst.getOperation())
+    {
+        case DecodedOperation::NOP:
+            break;
+
+        case DecodedOperation::ADC:
+            fprintf(out,
+                    "    %s = aotAdd(s, %s, %s, aotGetC(s));\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::ADD1:
+            fprintf(out,
+                    "    %s = aotAdd(s, %s, %" PRIu32 "u, 0);\n",
+                    WRITE(RD),
+                    READ(RN),
+                    im);
+            break;
+
+        case DecodedOperation::ADD2:
+            fprintf(out,
+                    "    %s = aotAdd(s, %s, %" PRIu32 "u, 0);\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    im);
+            break;
+
+        case DecodedOperation::ADD3:
+            fprintf(out,
+                    "    %s = aotAdd(s, %s, %s, 0);\n",
+                    WRITE(RD),
+                    READ(RN),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::ADD4:
+            if (aotEndsBlock(inst))
+            {
+                fprintf(out,
+                        "    return aotBranchAligned(s, %s + %s);\n",
+                        READ(RDN),
+                        READ(RM));
+            }
+            else
+            {
+                fprintf(out,
+                        "    %s = %s + %s;\n",
+                        WRITE(RDN),
+                        READ(RDN),
+                        READ(RM));
+            }
+            break;
+
+        case DecodedOperation::ADD5:
+            fprintf(out,
+                    "    %s = ALIGN(%s, BYTES_PER_WORD) + %" PRIu32 "u;\n",
+                    WRITE(RD),
+                    READ(RM),
+                    im << 2);
+            break;
+
+        case DecodedOperation::ADD6:
+        case DecodedOperation::ADD7:
+            fprintf(out,
+                    "    %s = %s + %" PRIu32 "u;\n",
+                    WRITE(RD),
+                    READ(RM),
+                    im << 2);
+            break;
+
+        case DecodedOperation::AND:
+            fprintf(out,
+                    "    %s = aotNZ(s, %s & %s);\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::ASR1:
+            fprintf(out,
+                    "    %s = aotAsr(s, %s, %" PRIu32 "u);\n",
+                    WRITE(RD),
+                    READ(RM),
+                    im);
+            break;
+
+        case DecodedOperation::ASR2:
+            fprintf(out,
+                    "    %s = aotAsr(s, %s, %s);\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::B1:
+            pc = inst.getRegisterData(DecodedInstRegIndex::RM);
+            fprintf(out,
+                    "    return aotBranchCond(s, DecodedCondition::%s, "
+                    "0x%08" PRIX32 "u, 0x%08" PRIX32 "u);\n",
+                    toEnumName(
+                        DecodedInst::getConditionString(inst.getCondition()))
+                        .c_str(),
+                    pc + (aotSignExtend(im, 8) << 1),
+                    nextAddr);
+            break;
+
+        case DecodedOperation::B2:
+            pc = inst.getRegisterData(DecodedInstRegIndex::RM);
+            fprintf(out,
+                    "    return aotBranch(s, 0x%08" PRIX32 "u);\n",
+                    pc + (aotSignExtend(im, 11) << 1));
+            break;
+
+        case DecodedOperation::BIC:
+            fprintf(out,
+                    "    %s = aotNZ(s, %s & ~%s);\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::BKPT:
+            fprintf(out, "    return aotBkpt(s, %" PRIu32 "u);\n", im);
+            break;
+
+        case DecodedOperation::BL:
+            pc = inst.getRegisterData(DecodedInstRegIndex::RDN);
+            fprintf(out,
+                    "    s.regs[%u] = 0x%08" PRIX32 "u;\n",
+                    static_cast<uint32_t>(Reg::LR),
+                    pc | 0x1);
+            fprintf(out,
+                    "    return aotBranchLink(s, 0x%08" PRIX32 "u);\n",
+                    pc + aotSignExtend(im, 25));
+            break;
+
+        case DecodedOperation::BLX:
+            pc = inst.getRegisterData(DecodedInstRegIndex::RDN);
+            fprintf(out, "    {\n");
+            fprintf(out, "        uint32_t target = %s;\n", READ(RM));
+            fprintf(out,
+                    "        s.regs[%u] = 0x%08" PRIX32 "u;\n",
+                    static_cast<uint32_t>(Reg::LR),
+                    PREV_THUMB_INST(pc) | 0x1);
+            fprintf(out, "        return aotBranchExchange(s, target);\n");
+            fprintf(out, "    }\n");
+            break;
+
+        case DecodedOperation::BX:
+            fprintf(out, "    return aotBranchExchange(s, %s);\n", READ(RM));
+            break;
+
+        case DecodedOperation::CMN:
+            fprintf(out, "    aotAdd(s, %s, %s, 0);\n", READ(RN), READ(RM));
+            break;
+
+        case DecodedOperation::CMP1:
+            fprintf(out, "    aotSub(s, %s, %" PRIu32 "u);\n", READ(RN), im);
+            break;
+
+        case DecodedOperation::CMP2:
+        case DecodedOperation::CMP3:
+            fprintf(out, "    aotSub(s, %s, %s);\n", READ(RN), READ(RM));
+            break;
+
+        case DecodedOperation::CPS:
+            fprintf(out, "    aotCps(s, %s);\n", READ(RM));
+            break;
+
+        case DecodedOperation::CPY:
+            if (aotEndsBlock(inst))
+            {
+                fprintf(out,
+                        "    return aotBranchExchange(s, %s);\n",
+                        READ(RM));
+            }
+            else
+            {
+                fprintf(out, "    %s = %s;\n", WRITE(RD), READ(RM));
+            }
+            break;
+
+        case DecodedOperation::EOR:
+            fprintf(out,
+                    "    %s = aotNZ(s, %s ^ %s);\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::LDMIA:
+        case DecodedOperation::POP:
+            emitMultipleLoad(out, inst);
+            break;
+
+        case DecodedOperation::LDR1:
+        case DecodedOperation::LDR2:
+        case DecodedOperation::LDR3:
+        case DecodedOperation::LDR4:
+        case DecodedOperation::LDRB1:
+        case DecodedOperation::LDRB2:
+        case DecodedOperation::LDRH1:
+        case DecodedOperation::LDRH2:
+        case DecodedOperation::LDRSB:
+        case DecodedOperation::LDRSH:
+            if (inst.getRegisterNumber(DecodedInstRegIndex::RT) == Reg::PC)
+            {
+                fprintf(out, "    aotFail(\"Cannot load into pc\");\n");
+                break;
+            }
+
+            fprintf(out, "    %s = ", WRITE(RT));
+            switch (inst.getOperation())
+            {
+                case DecodedOperation::LDR1:
+                case DecodedOperation::LDR4:
+                    fprintf(out,
+                            "aotLoadWord(s, %s + %" PRIu32 "u);\n",
+                            READ(RN),
+                            im << 2);
+                    break;
+
+                case DecodedOperation::LDR2:
+                    fprintf(out,
+                            "aotLoadWord(s, %s + %s);\n",
+                            READ(RN),
+                            READ(RM));
+                    break;
+
+                case DecodedOperation::LDR3:
+                    fprintf(out,
+                            "aotLoadWord(s, ALIGN(%s, BYTES_PER_WORD) + "
+                            "%" PRIu32 "u);\n",
+                            READ(RN),
+                            im << 2);
+                    break;
+
+                case DecodedOperation::LDRB1:
+                    fprintf(out,
+                            "aotLoadByte(s, %s + %" PRIu32 "u);\n",
+                            READ(RN),
+                            im);
+                    break;
+
+                case DecodedOperation::LDRB2:
+                    fprintf(out,
+                            "aotLoadByte(s, %s + %s);\n",
+                            READ(RN),
+                            READ(RM));
+                    break;
+
+                case DecodedOperation::LDRH1:
+                    fprintf(out,
+                            "aotLoadHalfword(s, %s + %" PRIu32 "u);\n",
+                            READ(RN),
+                            im << 1);
+                    break;
+
+                case DecodedOperation::LDRH2:
+                    fprintf(out,
+                            "aotLoadHalfword(s, %s + %s);\n",
+                            READ(RN),
+                            READ(RM));
+                    break;
+
+                case DecodedOperation::LDRSB:
+                    fprintf(out,
+                            "aotSignExtend(aotLoadByte(s, %s + %s), 8);\n",
+                            READ(RN),
+                            READ(RM));
+                    break;
+
+                default:
+                    fprintf(out,
+                            "aotSignExtend(aotLoadHalfword(s, %s + %s), "
+                            "16);\n",
+                            READ(RN),
+                            READ(RM));
+                    break;
+            }
+            break;
+
+        case DecodedOperation::LSL1:
+            fprintf(out,
+                    "    %s = aotLslImm(s, %s, %" PRIu32 "u);\n",
+                    WRITE(RD),
+                    READ(RM),
+                    im);
+            break;
+
+        case DecodedOperation::LSL2:
+            fprintf(out,
+                    "    %s = aotLslReg(s, %s, %s);\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::LSR1:
+            fprintf(out,
+                    "    %s = aotLsrImm(s, %s, %" PRIu32 "u);\n",
+                    WRITE(RD),
+                    READ(RM),
+                    im);
+            break;
+
+        case DecodedOperation::LSR2:
+            fprintf(out,
+                    "    %s = aotLsrReg(s, %s, %s);\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::MOV1:
+            fprintf(out,
+                    "    %s = aotNZ(s, %" PRIu32 "u);\n",
+                    WRITE(RD),
+                    im);
+            break;
+
+        case DecodedOperation::MOV2:
+            fprintf(out, "    %s = aotNZ(s, %s);\n", WRITE(RD), READ(RM));
+            break;
+
+        case DecodedOperation::MUL:
+            fprintf(out,
+                    "    %s = aotNZ(s, %s * %s);\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    READ(RN));
+            break;
+
+        case DecodedOperation::MVN:
+            fprintf(out, "    %s = aotNZ(s, ~%s);\n", WRITE(RD), READ(RM));
+            break;
+
+        case DecodedOperation::NEG:
+            fprintf(out,
+                    "    %s = aotNZ(s, %" PRIu32 "u - %s);\n",
+                    WRITE(RD),
+                    im,
+                    READ(RN));
+            break;
+
+        case DecodedOperation::ORR:
+            fprintf(out,
+                    "    %s = aotNZ(s, %s | %s);\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::PUSH:
+        case DecodedOperation::STMIA:
+            emitMultipleStore(out, inst);
+            break;
+
+        case DecodedOperation::REV:
+            fprintf(out, "    %s = aotRev(%s);\n", WRITE(RD), READ(RM));
+            break;
+
+        case DecodedOperation::REV16:
+            fprintf(out, "    %s = aotRev16(%s);\n", WRITE(RD), READ(RM));
+            break;
+
+        case DecodedOperation::REVSH:
+            fprintf(out, "    %s = aotRevsh(%s);\n", WRITE(RD), READ(RM));
+            break;
+
+        case DecodedOperation::ROR:
+            fprintf(out,
+                    "    %s = aotRor(s, %s, %s);\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::SBC:
+            fprintf(out,
+                    "    %s = aotSbc(s, %s, %s);\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::STR1:
+        case DecodedOperation::STR3:
+            fprintf(out,
+                    "    aotStoreWord(s, %s + %" PRIu32 "u, %s);\n",
+                    READ(RN),
+                    im << 2,
+                    READ(RT));
+            break;
+
+        case DecodedOperation::STR2:
+            fprintf(out,
+                    "    aotStoreWord(s, %s + %s, %s);\n",
+                    READ(RN),
+                    READ(RM),
+                    READ(RT));
+            break;
+
+        case DecodedOperation::STRB1:
+            fprintf(out,
+                    "    aotStoreByte(s, %s + %" PRIu32 "u, %s);\n",
+                    READ(RN),
+                    im,
+                    READ(RT));
+            break;
+
+        case DecodedOperation::STRB2:
+            fprintf(out,
+                    "    aotStoreByte(s, %s + %s, %s);\n",
+                    READ(RN),
+                    READ(RM),
+                    READ(RT));
+            break;
+
+        case DecodedOperation::STRH1:
+            fprintf(out,
+                    "    aotStoreHalfword(s, %s + %" PRIu32 "u, %s);\n",
+                    READ(RN),
+                    im << 1,
+                    READ(RT));
+            break;
+
+        case DecodedOperation::STRH2:
+            fprintf(out,
+                    "    aotStoreHalfword(s, %s + %s, %s);\n",
+                    READ(RN),
+                    READ(RM),
+                    READ(RT));
+            break;
+
+        case DecodedOperation::SUB1:
+            fprintf(out,
+                    "    %s = aotSub(s, %s, %" PRIu32 "u);\n",
+                    WRITE(RD),
+                    READ(RN),
+                    im);
+            break;
+
+        case DecodedOperation::SUB2:
+            fprintf(out,
+                    "    %s = aotSub(s, %s, %" PRIu32 "u);\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    im);
+            break;
+
+        case DecodedOperation::SUB3:
+            fprintf(out,
+                    "    %s = aotSub(s, %s, %s);\n",
+                    WRITE(RD),
+                    READ(RN),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::SUB4:
+            fprintf(out,
+                    "    %s = %s - %" PRIu32 "u;\n",
+                    WRITE(RDN),
+                    READ(RDN),
+                    im << 2);
+            break;
+
+        case DecodedOperation::SVC:
+            fprintf(out, "    return aotSvc(s, %" PRIu32 "u);\n", im);
+            break;
+
+        case DecodedOperation::SXTB:
+            fprintf(out,
+                    "    %s = aotSignExtend(%s & 0xFF, 8);\n",
+                    WRITE(RD),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::SXTH:
+            fprintf(out,
+                    "    %s = aotSignExtend(%s & 0xFFFF, 16);\n",
+                    WRITE(RD),
+                    READ(RM));
+            break;
+
+        case DecodedOperation::TST:
+            fprintf(out, "    aotNZ(s, %s & %s);\n", READ(RM), READ(RN));
+            break;
+
+        case DecodedOperation::UXTB:
+            fprintf(out, "    %s = %s & 0xFF;\n", WRITE(RD), READ(RM));
+            break;
+
+        case DecodedOperation::UXTH:
+            fprintf(out, "    %s = %s & 0xFFFF;\n", WRITE(RD), READ(RM));
+            break;
+
+        default:
+            fprintf(stderr, "Invalid decoded operation\n");
+            exit(1);
+    }
+}
+
+/*
+ * Emit the function of the block starting at startAddr. The counters for the
+ * statistics are updated up front, so that they are complete if the program
+ * stops in the middle of the block
+ */
+void Translator::emitBlock(FILE *out, uint32_t startAddr)
+{
+    uint32_t addr = startAddr;
+    uint32_t cycles = 0;
+    std::vector<DecodedInst> insts;
+    std::vector<uint32_t> nextAddrs;
+    std::array<uint64_t, static_cast<std::size_t>(Instruction::COUNT)>
+        instCount{};
+    std::array<uint64_t, static_cast<std::size_t>(DecodedOperation::COUNT)>
+        decodedOpCount{};
+    DecodedInst inst;
+    Instruction instType;
+    std::size_t i;
+
+    do
+    {
+        if (!decodeNext(addr, inst))
+        {
+            break;
+        }
+
+        insts.push_back(inst);
+        nextAddrs.push_back(addr);
+
+        cycles += aotGetCycles(inst);
+        instType = aotGetInstruction(inst);
+        if (instType != Instruction::COUNT)
+        {
+            instCount[static_cast<std::size_t>(instType)]++;
+        }
+        decodedOpCount[static_cast<std::size_t>(inst.getOperation())]++;
+    } while (!aotEndsBlock(inst) && leaders.count(addr) == 0);
+
+    codeEndAddr = (addr > codeEndAddr) ? addr : codeEndAddr;
+
+    fprintf(out,
+            "/* 0x%08" PRIX32 " - 0x%08" PRIX32 " */\n",
+            startAddr,
+            addr);
+    fprintf(out,
+            "static uint32_t block%08" PRIX32 "(AotState &s)\n{\n",
+            startAddr);
+    if (cycles != 0)
+    {
+        fprintf(out, "    s.cycles += %" PRIu32 ";\n", cycles);
+    }
+    for (i = 0; i < instCount.size(); i++)
+    {
+        if (instCount[i] != 0)
+        {
+            fprintf(out,
+                    "    aotCountInst(s, Instruction::%s, %" PRIu64 ");\n",
+                    toEnumName(Statistics::getInstructionStr(
+                                   static_cast<Instruction>(i)))
+                        .c_str(),
+                    instCount[i]);
+        }
+    }
+    for (i = 0; i < decodedOpCount.size(); i++)
+    {
+        if (decodedOpCount[i] != 0)
+        {
+            fprintf(out,
+                    "    aotCountOp(s, DecodedOperation::%s, %" PRIu64 ");\n",
+                    toEnumName(DecodedInst::getOperationString(
+                                   static_cast<DecodedOperation>(i)))
+                        .c_str(),
+                    decodedOpCount[i]);
+        }
+    }
+    fprintf(out, "\n");
+
+    for (i = 0; i < insts.size(); i++)
+    {
+        emitInst(out, insts[i], nextAddrs[i]);
+    }
+
+    /* Fall through to the following block */
+    if (insts.empty() || !aotEndsBlock(insts.back()))
+    {
+        fprintf(out, "    return 0x%08" PRIX32 "u;\n", addr);
+    }
+
+    fprintf(out, "}\n\n");
+}
+
+void Translator::emitDispatcher(FILE *out)
+{
+    std::set<uint32_t>::iterator it;
+
+    fprintf(out, "uint32_t aotRunBlock(AotState &s, uint32_t pc)\n{\n");
+    fprintf(out, "    switch (pc)\n    {\n");
+    for (it = leaders.begin(); it != leaders.end(); it++)
+    {
+        fprintf(out,
+                "        case 0x%08" PRIX32 "u:\n"
+                "            return block%08" PRIX32 "(s);\n",
+                *it,
+                *it);
+    }
+    fprintf(out,
+            "        default:\n"
+            "            return aotMissingBlock(s, pc);\n");
+    fprintf(out, "    }\n}\n");
+}
+
+int Translator::translate(char *programBinFile, char *outFile)
+{
+    FILE *out;
+    std::set<uint32_t>::iterator it;
+
+    if (mem->loadProgram(programBinFile, entryAddr, programByteSize) != 0)
+    {
+        fprintf(stderr, "Failed to load program binary in memory\n");
+        return -1;
+    }
+    else if ((entryAddr & 1) == 0)
+    {
+        fprintf(stderr,
+                "Reset vector contains an ARM address 0x%08" PRIX32 "\n",
+                entryAddr);
+        return -1;
+    }
+    entryAddr = entryAddr & ~1;
+
+    findBlocks();
+
+    out = fopen(outFile, "w");
+    if (out == nullptr)
+    {
+        fprintf(stderr, "Could not open '%s'\n", outFile);
+        return -1;
+    }
+
+    fprintf(out,
+            "/* Translated ahead of time from %s, do not edit */\n"
+            "#include \"simulator/aot.h\"\n\n",
+            programBinFile);
+
+    for (it = leaders.begin(); it != leaders.end(); it++)
+    {
+        emitBlock(out, *it);
+    }
+
+    emitDispatcher(out);
+
+    fprintf(out,
+            "\nconst uint32_t aotCodeEndAddr = 0x%08" PRIX32 "u;\n",
+            codeEndAddr);
+
+    fclose(out);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    CmdLineArgs args;
+    Translator *translator;
+    int converted;
+    int ret;
+    int i;
+
+    /* Parse command line arguments */
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-h") == 0)
+        {
+            printf(CmdLineArgs::HELP_MSG, argv[0], MEM_SIZE_WORDS);
+            return EXIT_SUCCESS;
+        }
+        else if (strcmp(argv[i], "-m") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -m requires an argument\n");
+                return EXIT_FAILURE;
+            }
+
+            converted = atoi(argv[i]);
+            if (converted <= 0)
+            {
+                fprintf(stderr, "Invalid value %s for -m\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            args.memSizeWords = static_cast<uint32_t>(converted);
+        }
+        else if (strcmp(argv[i], "-b") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -b requires an argument\n");
+                return EXIT_FAILURE;
+            }
+            args.bin = argv[i];
+        }
+        else if (strcmp(argv[i], "-o") == 0)
+        {
+            i++;
+            if (i >= argc)
+            {
+                /* Ran out of arguments, fail */
+                fprintf(stderr, "Option -o requires an argument\n");
+                return EXIT_FAILURE;
+            }
+            args.out = argv[i];
+        }
+        else
+        {
+            fprintf(stderr, "Unrecognized option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (args.bin == nullptr || args.out == nullptr)
+    {
+        fprintf(stderr, "Options -b and -o are required\n");
+        return EXIT_FAILURE;
+    }
+
+    translator = new Translator(args.memSizeWords);
+    ret = translator->translate(args.bin, args.out);
+    delete translator;
+
+    return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
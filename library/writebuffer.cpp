@@ -0,0 +1,205 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2018 Andres Amaya Garcia
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+#include "simulator/writebuffer.h"
+
+#include "simulator/debug.h"
+#include "simulator/memory.h"
+#include "simulator/stats.h"
+#include "simulator/utils.h"
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+WriteBuffer::WriteBuffer(Memory *memIn,
+                         Statistics *statsIn,
+                         uint32_t entriesIn) :
+    mem(memIn),
+    stats(statsIn),
+    entries(entriesIn)
+{
+    uint32_t i;
+
+    buffer = new WriteBufferEntry[entries];
+
+    for (i = 0; i < entries; i++)
+    {
+        buffer[i].byteAddr = 0;
+        buffer[i].data = 0;
+        buffer[i].byteEnable = 0;
+        buffer[i].memToken = 0xFFFFFFFF;
+        buffer[i].issued = false;
+    }
+}
+
+WriteBuffer::~WriteBuffer()
+{
+    delete[] buffer;
+}
+
+/* Add a store with its data already in the byte lanes of byteEnable */
+void WriteBuffer::push(uint32_t byteAddr, uint32_t data, uint32_t byteEnable)
+{
+    WriteBufferEntry *entry;
+
+    if (isFull())
+    {
+        fprintf(stderr, "Store pushed to a full write buffer\n");
+        exit(1);
+    }
+
+    entry = getEntry(count);
+    entry->byteAddr = byteAddr;
+    entry->data = data;
+    entry->byteEnable = byteEnable;
+    entry->issued = false;
+    count++;
+
+    stats->addWriteBufferStore();
+}
+
+/*
+ * Merge the stores to the word of byteAddr, from the oldest to the newest, to
+ * find out whether they hold the byte lanes in byteEnable. On a hit data is
+ * the word with those lanes as the memory will have them
+ */
+WriteBufferLookup WriteBuffer::lookup(uint32_t byteAddr,
+                                      uint32_t byteEnable,
+                                      uint32_t &data)
+{
+    uint32_t wordAddr = GET_WORD_ADDRESS(byteAddr);
+    uint32_t held = 0;
+    uint32_t i;
+    WriteBufferEntry *entry;
+
+    data = 0;
+    for (i = 0; i < count; i++)
+    {
+        entry = getEntry(i);
+        if (GET_WORD_ADDRESS(entry->byteAddr) == wordAddr)
+        {
+            data = Memory::mergeByteLanes(data, entry->data, entry->byteEnable);
+            held = held | entry->byteEnable;
+        }
+    }
+
+    if ((held & byteEnable) == 0)
+    {
+        return WriteBufferLookup::MISS;
+    }
+    else if ((held & byteEnable) == byteEnable)
+    {
+        return WriteBufferLookup::HIT;
+    }
+
+    return WriteBufferLookup::PARTIAL;
+}
+
+/* Whether any store falls in [baseByteAddr, endByteAddr) */
+bool WriteBuffer::overlaps(uint32_t baseByteAddr, uint32_t endByteAddr)
+{
+    uint32_t wordAddr;
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        wordAddr = GET_WORD_ADDRESS(getEntry(i)->byteAddr);
+        if (wordAddr < endByteAddr &&
+            wordAddr + BYTES_PER_WORD > baseByteAddr)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Free the entries of the stores that the memory served. This runs before
+ * execute so that a store can take an entry in the cycle it becomes free
+ */
+void WriteBuffer::retire()
+{
+    WriteBufferEntry *entry;
+
+    while (count > 0)
+    {
+        entry = getEntry(0);
+        if (!entry->issued || mem->isPending(entry->memToken))
+        {
+            break;
+        }
+        else if (mem->retrieveStore(entry->memToken) != 0)
+        {
+            fprintf(stderr, "Failed memory response when expected\n");
+            exit(1);
+        }
+
+        head = (head + 1) % entries;
+        count--;
+    }
+}
+
+/*
+ * Place the oldest store that is not in flight. The buffer only uses the data
+ * port in cycles that nobody else placed a request, so its requests are never
+ * rejected
+ */
+int WriteBuffer::run()
+{
+    uint32_t i;
+    WriteBufferEntry *entry;
+
+    /* Find the oldest store that is not in flight */
+    i = 0;
+    while (i < count && getEntry(i)->issued)
+    {
+        i++;
+    }
+
+    if (i == count || mem->hasNewRequest(Component::EXECUTE) ||
+        !mem->isAvailable(Component::EXECUTE))
+    {
+        return 0;
+    }
+
+    entry = getEntry(i);
+    if (mem->requestStore(Component::EXECUTE,
+                          entry->byteAddr,
+                          entry->data,
+                          entry->byteEnable,
+                          entry->memToken) != 0)
+    {
+        fprintf(stderr, "Memory request failed when available\n");
+        exit(1);
+    }
+    entry->issued = true;
+
+    DEBUG_CMD(DEBUG_MEMORY,
+              printf("Write buffer: placed store to 0x%08" PRIX32 "\n",
+                     entry->byteAddr));
+
+    return 0;
+}